@@ -0,0 +1,136 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#pragma once
+#include "PatternSearch.hpp"
+
+// Only patterns with a run long enough for `MaskedPatternSearch` to use the Horspool table carry one.
+template<bool Skippable>
+struct BytePatternSkipTable {
+    constexpr const PatternSkipTable *get() const { return nullptr; }
+};
+
+template<>
+struct BytePatternSkipTable<true> {
+    PatternSkipTable table {};
+
+    constexpr const PatternSkipTable *get() const { return &this->table; }
+};
+
+// Byte pattern parsed at compile time from an IDA-style string such as `"48 8D 35 ?? ?? ?? ?? BA"`.
+// `??` matches any byte, `4?` and `?4` only compare one nibble.
+// Use through `BYTE_PATTERN`, which sizes the pattern from the string and decides whether it gets a skip table.
+template<size_t N, bool Skippable = false>
+struct BytePattern {
+    UInt8 pattern[N] {};
+    UInt8 mask[N] {};
+    bool masked {false};
+    BytePatternSkipTable<Skippable> skipTable {};
+
+    // Fully specified patterns don't need a mask at all.
+    constexpr const UInt8 *getMask() const { return this->masked ? this->mask : nullptr; }
+    constexpr const PatternSkipTable *getSkipTable() const { return this->skipTable.get(); }
+    static constexpr size_t size() { return N; }
+};
+
+namespace BytePatternDetail {
+    // Not constexpr on purpose, reaching it while parsing a pattern stops the compilation.
+    inline void invalidPatternCharacter() { PANIC("BytePattern", "Invalid pattern character"); }
+
+    constexpr bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n'; }
+
+    constexpr UInt8 parseNibble(char c) {
+        if (c >= '0' && c <= '9') { return static_cast<UInt8>(c - '0'); }
+        if (c >= 'A' && c <= 'F') { return static_cast<UInt8>(c - 'A' + 10); }
+        if (c >= 'a' && c <= 'f') { return static_cast<UInt8>(c - 'a' + 10); }
+        invalidPatternCharacter();
+        return 0;
+    }
+
+    constexpr size_t countBytes(const char *str) {
+        size_t count = 0;
+        for (size_t i = 0; str[i];) {
+            if (isSpace(str[i])) {
+                i += 1;
+                continue;
+            }
+            count += 1;
+            while (str[i] && !isSpace(str[i])) { i += 1; }
+        }
+        return count;
+    }
+
+    // Bytes in the longest run without a wildcard nibble.
+    constexpr size_t countLongestRun(const char *str) {
+        size_t longest = 0, run = 0;
+        for (size_t i = 0; str[i];) {
+            if (isSpace(str[i])) {
+                i += 1;
+                continue;
+            }
+            bool wildcard = false;
+            for (; str[i] && !isSpace(str[i]); i++) { wildcard |= str[i] == '?'; }
+            run = wildcard ? 0 : run + 1;
+            if (run > longest) { longest = run; }
+        }
+        return longest;
+    }
+}    // namespace BytePatternDetail
+
+template<size_t N, bool Skippable, size_t M>
+constexpr BytePattern<N, Skippable> parseBytePattern(const char (&str)[M]) {
+    BytePattern<N, Skippable> ret {};
+    size_t count = 0;
+    for (size_t i = 0; i + 1 < M;) {
+        if (BytePatternDetail::isSpace(str[i])) {
+            i += 1;
+            continue;
+        }
+        size_t length = 0;
+        while (i + length + 1 < M && !BytePatternDetail::isSpace(str[i + length])) { length += 1; }
+        // `?` is a whole wildcard byte, anything else is written as two nibbles.
+        if (length == 2) {
+            for (size_t j = 0; j < 2; j++) {
+                ret.pattern[count] <<= 4;
+                ret.mask[count] <<= 4;
+                if (str[i + j] != '?') {
+                    ret.pattern[count] |= BytePatternDetail::parseNibble(str[i + j]);
+                    ret.mask[count] |= 0xF;
+                }
+            }
+        } else if (length != 1 || str[i] != '?') {
+            BytePatternDetail::invalidPatternCharacter();
+        }
+        if (ret.mask[count] != 0xFF) { ret.masked = true; }
+        count += 1;
+        i += length;
+    }
+
+    if constexpr (Skippable) {
+        // Horspool shifts over the longest run of fully-masked bytes, capped so every shift fits in a byte.
+        size_t runOffset = 0, runSize = 0;
+        for (size_t i = 0; i < N;) {
+            size_t j = i;
+            while (j < N && ret.mask[j] == 0xFF) { j += 1; }
+            if (j - i > runSize) {
+                runOffset = i;
+                runSize = j - i;
+            }
+            i = j + 1;
+        }
+        if (runSize > 0xFF) { runSize = 0xFF; }
+        auto &table = ret.skipTable.table;
+        table.runOffset = runOffset;
+        table.runSize = runSize;
+        for (size_t i = 0; i < 0x100; i++) { table.shifts[i] = static_cast<UInt8>(runSize); }
+        for (size_t i = 0; i + 1 < runSize; i++) {
+            table.shifts[ret.pattern[runOffset + i]] = static_cast<UInt8>(runSize - 1 - i);
+        }
+    }
+
+    return ret;
+}
+
+#define BYTE_PATTERN(str)                                                                \
+    parseBytePattern<BytePatternDetail::countBytes(str),                                 \
+        BytePatternDetail::countLongestRun(str) >= MaskedPatternSearch::MinSkipRun>(str)
@@ -7,38 +7,152 @@
 
 DYLDPatches *DYLDPatches::callback = nullptr;
 
-void DYLDPatches::init() { callback = this; }
+void DYLDPatches::init() {
+    callback = this;
+
+    PANIC_COND(!this->coreLSKDPatches.add(this->coreLSKDPatch), "DYLD", "Failed to add CoreLSKD patch");
+}
 
 void DYLDPatches::processPatcher(KernelPatcher &patcher) {
     if (!(lilu.getRunMode() & LiluAPI::RunningNormal)) { return; }
 
+    // The hook still works without them, it just classifies and searches every page again.
+    SYSLOG_COND(!this->imageCache.allocate() || !this->cacheIndices.allocate() || !this->pageMemo.allocate(), "DYLD",
+        "Failed to allocate the page caches");
+
     KernelPatcher::RouteRequest request {"_cs_validate_page", wrapCsValidatePage, this->orgCsValidatePage};
 
     PANIC_COND(!patcher.routeMultipleLong(KernelPatcher::KernelID, &request, 1), "DYLD",
         "Failed to route kernel symbols");
 }
 
-void DYLDPatches::wrapCsValidatePage(vnode *vp, memory_object_t pager, memory_object_offset_t page_offset,
-    const void *data, int *validated_p, int *tainted_p, int *nx_p) {
-    FunctionCast(wrapCsValidatePage, callback->orgCsValidatePage)(vp, pager, page_offset, data, validated_p, tainted_p,
-        nx_p);
+void DYLDPatch::applyAll(const DYLDPatch *patches, size_t count, void *data, size_t size) {
+    for (size_t base = 0; base < count; base += MultiPatternScanner::MaxPatterns) {
+        DYLDPatchSet set {};
+        for (size_t i = base; i < count && i < base + MultiPatternScanner::MaxPatterns; i++) { set.add(patches[i]); }
+        set.apply(data, size);
+    }
+}
+
+bool DYLDPatchSet::add(const DYLDPatch &patch) {
+    auto index = this->scanner.getCount();
+    if (!this->scanner.add(static_cast<const UInt8 *>(patch.find), static_cast<const UInt8 *>(patch.findMask),
+            patch.size)) {
+        return false;
+    }
+    this->patches[index] = &patch;
+    return true;
+}
+
+struct DYLDPatchSetMatch {
+    const DYLDPatchSet *set;
+    UInt8 *data;
+};
+
+void DYLDPatchSet::apply(void *data, size_t size) const {
+    DYLDPatchSetMatch match {this, static_cast<UInt8 *>(data)};
+    this->scanner.forEachMatch(match.data, size, applyMatch, &match);
+}
+
+void DYLDPatchSet::applyMatch(void *context, size_t index, size_t offset) {
+    auto *match = static_cast<DYLDPatchSetMatch *>(context);
+    match->set->patches[index]->applyAt(match->data + offset);
+}
+
+DYLDImage DYLDPatches::classifyImage(const char *path) {
+    auto image = kDYLDImageTrie.lookup(path, kDYLDImageOther);
+    if (image == kDYLDImageSharedCache && !UserPatcher::matchSharedCachePath(path)) { return kDYLDImageOther; }
+    return image;
+}
 
-    char path[PATH_MAX];
-    int pathlen = PATH_MAX;
-    if (vn_getpath(vp, path, &pathlen)) { return; }
+UInt16 DYLDPatches::findSharedCacheIndex(const UInt8 *header) {
+    for (size_t i = 0; i < sharedCacheIndexCount; i++) {
+        if (!memcmp(sharedCacheIndex[i].uuid, header + SharedCacheUUIDOffset, sizeof(sharedCacheIndex[i].uuid))) {
+            DBGLOG("DYLD", "Shared cache is in the index with %zu pages", sharedCacheIndex[i].count);
+            return static_cast<UInt16>(i);
+        }
+    }
+    return NoMatch;
+}
+
+bool DYLDPatches::isPageIndexed(const SharedCacheIndex &index, UInt64 offset) {
+    auto page = offset / PAGE_SIZE;
+    size_t lo = 0, hi = index.count;
+    while (lo < hi) {
+        auto mid = (lo + hi) / 2;
+        if (index.pages[mid] < page) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < index.count && index.pages[lo] == page;
+}
 
-    if (!UserPatcher::matchSharedCachePath(path)) {
-        if (LIKELY(strncmp(path, kCoreLSKDMSEPath, arrsize(kCoreLSKDMSEPath))) ||
-            LIKELY(strncmp(path, kCoreLSKDPath, arrsize(kCoreLSKDPath)))) {
+// Files in the shared cache index only have the pages it lists searched, the others return straight away. Files that
+// aren't in it, or whose first page hasn't been seen yet, have every page searched.
+// Pages evicted under memory pressure come back with their original contents, so the result of the first search is
+// remembered: a revisit either returns straight away or patches the known offset after checking it still matches.
+void DYLDPatches::patchSharedCachePage(vnode *vp, UInt32 vid, UInt64 offset, UInt8 *data) {
+    UInt16 index;
+    if (!offset) {
+        index = findSharedCacheIndex(data);
+        this->cacheIndices.insert(vp, vid, 0, index);
+    } else if (!this->cacheIndices.lookup(vp, vid, 0, &index)) {
+        index = NoMatch;
+    }
+    if (index != NoMatch && !isPageIndexed(sharedCacheIndex[index], offset)) { return; }
+
+    UInt16 matchOffset;
+    UInt8 *match = nullptr;
+    if (this->pageMemo.lookup(vp, vid, offset, &matchOffset)) {
+        auto hits = __atomic_add_fetch(&this->pageMemoHits, 1, __ATOMIC_RELAXED);
+        DBGLOG_COND(!(hits & 0xFFFF), "DYLD", "Page memo: %llu hits, %llu misses", hits,
+            __atomic_load_n(&this->pageMemoMisses, __ATOMIC_RELAXED));
+        if (matchOffset == NoMatch) { return; }
+        match = data + matchOffset;
+    } else {
+        __atomic_add_fetch(&this->pageMemoMisses, 1, __ATOMIC_RELAXED);
+        size_t found = 0;
+        if (!this->drmModelSearch.find(data, PAGE_SIZE, &found)) {
+            this->pageMemo.insert(vp, vid, offset, NoMatch);
             return;
         }
-        const DYLDPatch patch = {kCoreLSKDOriginal, kCoreLSKDPatched, "Patch CoreLSKD(MSE) streaming CPUID to Haswell"};
-        patch.apply(const_cast<void *>(data), PAGE_SIZE);
-        return;
+        this->pageMemo.insert(vp, vid, offset, static_cast<UInt16>(found));
+        match = data + found;
     }
 
-    if (UNLIKELY(KernelPatcher::findAndReplace(const_cast<void *>(data), PAGE_SIZE, kVideoToolboxDRMModelOriginal,
-            arrsize(kVideoToolboxDRMModelOriginal), BaseDeviceInfo::get().modelIdentifier, 20))) {
+    if (UNLIKELY(KernelPatcher::findAndReplace(match, arrsize(kVideoToolboxDRMModelOriginal),
+            kVideoToolboxDRMModelOriginal, arrsize(kVideoToolboxDRMModelOriginal),
+            BaseDeviceInfo::get().modelIdentifier, 20))) {
         DBGLOG("DYLD", "Applied 'VideoToolbox DRM model check' patch");
     }
 }
+
+void DYLDPatches::wrapCsValidatePage(vnode *vp, memory_object_t pager, memory_object_offset_t page_offset,
+    const void *data, int *validated_p, int *tainted_p, int *nx_p) {
+    FunctionCast(wrapCsValidatePage, callback->orgCsValidatePage)(vp, pager, page_offset, data, validated_p, tainted_p,
+        nx_p);
+
+    // Taken before the path, so a vnode recycled in between is cached under the old vid and never matched.
+    auto vid = vnode_vid(vp);
+    UInt8 image;
+    if (!callback->imageCache.lookup(vp, vid, 0, &image)) {
+        char path[PATH_MAX];
+        int pathlen = PATH_MAX;
+        if (vn_getpath(vp, path, &pathlen)) { return; }
+        image = classifyImage(path);
+        callback->imageCache.insert(vp, vid, 0, image);
+    }
+
+    switch (image) {
+        case kDYLDImageSharedCache:
+            callback->patchSharedCachePage(vp, vid, page_offset, static_cast<UInt8 *>(const_cast<void *>(data)));
+            break;
+        case kDYLDImageCoreLSKD:
+            callback->coreLSKDPatches.apply(const_cast<void *>(data), PAGE_SIZE);
+            break;
+        default:
+            break;
+    }
+}
@@ -2,10 +2,17 @@
 // See LICENSE for details.
 
 #pragma once
+#include "BytePattern.hpp"
+#include "PathTrie.hpp"
+#include "PatternSearch.hpp"
+#include "SharedCacheIndex.hpp"
+#include "VnodeCache.hpp"
 #include <Headers/kern_patcher.hpp>
 #include <Headers/kern_util.hpp>
 
 class DYLDPatch {
+    friend class DYLDPatchSet;
+
     const void *find {nullptr}, *findMask {nullptr};
     const void *replace {nullptr}, *replaceMask {nullptr};
     const size_t size {0};
@@ -36,6 +43,10 @@ class DYLDPatch {
     DYLDPatch(const T (&find)[N], const T (&findMask)[N], const T (&replace)[N], const char *comment)
         : DYLDPatch(find, findMask, replace, N * sizeof(T), comment) {}
 
+    template<size_t N, bool F, bool R>
+    DYLDPatch(const BytePattern<N, F> &find, const BytePattern<N, R> &replace, const char *comment)
+        : DYLDPatch(find.pattern, find.getMask(), replace.pattern, replace.getMask(), N, comment) {}
+
     inline void apply(void *data, size_t size) const {
         if (UNLIKELY(KernelPatcher::findAndReplaceWithMask(data, size, this->find, this->size, this->findMask,
                 this->findMask ? this->size : 0, this->replace, this->size, this->replaceMask,
@@ -44,16 +55,70 @@ class DYLDPatch {
         }
     }
 
-    static inline void applyAll(const DYLDPatch *patches, size_t count, void *data, size_t size) {
-        for (size_t i = 0; i < count; i++) { patches[i].apply(data, size); }
+    // Writes the replacement over a match found by `DYLDPatchSet`.
+    inline void applyAt(UInt8 *match) const {
+        const auto *replace = static_cast<const UInt8 *>(this->replace);
+        const auto *replaceMask = static_cast<const UInt8 *>(this->replaceMask);
+        for (size_t i = 0; i < this->size; i++) {
+            match[i] = replaceMask ? (match[i] & ~replaceMask[i]) | (replace[i] & replaceMask[i]) : replace[i];
+        }
+        DBGLOG("DYLD", "Applied '%s' patch", this->comment);
     }
 
+    static void applyAll(const DYLDPatch *patches, size_t count, void *data, size_t size);
+
     template<size_t N>
     static inline void applyAll(const DYLDPatch (&patches)[N], void *data, size_t size) {
         applyAll(patches, N, data, size);
     }
 };
 
+// Applies up to `MultiPatternScanner::MaxPatterns` patches with a single walk over the data instead of one search
+// per patch, so adding another patch barely changes the cost of a page.
+// Built once, after which `apply` can be called from several threads at once.
+class DYLDPatchSet {
+    public:
+    bool add(const DYLDPatch &patch);
+    void apply(void *data, size_t size) const;
+
+    private:
+    static void applyMatch(void *context, size_t index, size_t offset);
+
+    const DYLDPatch *patches[MultiPatternScanner::MaxPatterns] {};
+    MultiPatternScanner scanner {};
+};
+
+// VideoToolbox DRM model check
+static const char kVideoToolboxDRMModelOriginal[] = "MacPro5,1\0MacPro6,1\0IOService";
+
+static constexpr char kCoreLSKDMSEPath[] =
+    "/System/Library/PrivateFrameworks/CoreLSKDMSE.framework/Versions/A/CoreLSKDMSE";
+static constexpr char kCoreLSKDPath[] = "/System/Library/PrivateFrameworks/CoreLSKD.framework/Versions/A/CoreLSKD";
+
+// Makes the CPUID check of CoreLSKD(MSE), which streaming DRM goes through, see a Haswell.
+// `mov eax, 1; cpuid` -> `mov eax, 0x306C3; nop`, so EAX holds the signature of family 6, model 0x3C, stepping 3.
+static const UInt8 kCoreLSKDOriginal[] = {0xC7, 0xC0, 0x01, 0x00, 0x00, 0x00, 0x0F, 0xA2};
+static const UInt8 kCoreLSKDPatched[] = {0xC7, 0xC0, 0xC3, 0x06, 0x03, 0x00, 0x66, 0x90};
+
+// What `wrapCsValidatePage` does with the pages of a file.
+enum DYLDImage : UInt8 {
+    kDYLDImageOther = 0,
+    kDYLDImageSharedCache,
+    kDYLDImageCoreLSKD,
+};
+
+// Every file `wrapCsValidatePage` patches. The shared cache entries are prefixes, Lilu gets the final say on which
+// cache under them is the one in use, see `DYLDPatches::classifyImage`.
+static constexpr PathTrieEntry<DYLDImage> kDYLDImagePaths[] = {
+    {"/private/var/db/dyld/dyld_shared_cache_x86_64", kDYLDImageSharedCache, true},
+    {"/System/Library/dyld/dyld_shared_cache_x86_64", kDYLDImageSharedCache, true},
+    {"/System/Volumes/Preboot/Cryptexes/OS/System/Library/dyld/dyld_shared_cache_x86_64", kDYLDImageSharedCache, true},
+    {kCoreLSKDMSEPath, kDYLDImageCoreLSKD, false},
+    {kCoreLSKDPath, kDYLDImageCoreLSKD, false},
+};
+
+static constexpr PathTrie<DYLDImage, getPathTrieCapacity(kDYLDImagePaths)> kDYLDImageTrie {kDYLDImagePaths};
+
 class DYLDPatches {
     public:
     static DYLDPatches *callback;
@@ -62,16 +127,30 @@ class DYLDPatches {
     void processPatcher(KernelPatcher &patcher);
 
     private:
+    // Page memo value for a page without a match, and cache index value for a file that isn't in the index.
+    static constexpr UInt16 NoMatch = 0xFFFF;
+
     mach_vm_address_t orgCsValidatePage {0};
+    const DYLDPatch coreLSKDPatch {kCoreLSKDOriginal, kCoreLSKDPatched,
+        "Patch CoreLSKD(MSE) streaming CPUID to Haswell"};
+    // Everything applied to the CoreLSKD(MSE) pages, filled by `init`.
+    DYLDPatchSet coreLSKDPatches {};
+    const MaskedPatternSearch drmModelSearch {reinterpret_cast<const UInt8 *>(kVideoToolboxDRMModelOriginal), nullptr,
+        arrsize(kVideoToolboxDRMModelOriginal)};
+    // The caches are allocated by `processPatcher` once the hook is going to be installed, 74 KiB in all.
+    // What each file is, sized for a few hundred files paging in at once without conflict evictions.
+    VnodeCache<UInt8, 1024> imageCache {};
+    // The `sharedCacheIndex` entry of each shared cache file or `NoMatch`, read from the header in its first page.
+    // A cache is split into a dozen or so files.
+    VnodeCache<UInt16, 64> cacheIndices {};
+    // Where each shared cache page validated so far had its match, keyed by its offset in the file. 8 MiB of pages.
+    VnodeCache<UInt16, 2048> pageMemo {};
+    UInt64 pageMemoHits {0}, pageMemoMisses {0};
+
+    static DYLDImage classifyImage(const char *path);
+    static UInt16 findSharedCacheIndex(const UInt8 *header);
+    static bool isPageIndexed(const SharedCacheIndex &index, UInt64 offset);
+    void patchSharedCachePage(vnode *vp, UInt32 vid, UInt64 offset, UInt8 *data);
     static void wrapCsValidatePage(vnode *vp, memory_object_t pager, memory_object_offset_t page_offset,
         const void *data, int *validated_p, int *tainted_p, int *nx_p);
 };
-
-// VideoToolbox DRM model check
-static const char kVideoToolboxDRMModelOriginal[] = "MacPro5,1\0MacPro6,1\0IOService";
-
-static const char kCoreLSKDMSEPath[] = "/System/Library/PrivateFrameworks/CoreLSKDMSE.framework/Versions/A/CoreLSKDMSE";
-static const char kCoreLSKDPath[] = "/System/Library/PrivateFrameworks/CoreLSKD.framework/Versions/A/CoreLSKD";
-
-static const UInt8 kCoreLSKDOriginal[] = {0xC7, 0xC0, 0x01, 0x00, 0x00, 0x00, 0x0F, 0xA2};
-static const UInt8 kCoreLSKDPatched[] = {0xC7, 0xC0, 0xC3, 0x06, 0x03, 0x00, 0x66, 0x90};
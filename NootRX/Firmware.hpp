@@ -2,11 +2,82 @@
 // See LICENSE for details.
 
 #pragma once
+#include <Headers/kern_compression.hpp>
 #include <Headers/kern_util.hpp>
+#include <IOKit/IOLib.h>
+
+// Every payload starts on a boundary of this many bytes and is padded to the next one, so that copies never share a
+// cache line with another blob. Must match `alignment` in Scripts/GenerateFirmware.py, the generated file checks it.
+static constexpr size_t FWAlignment = 64;
 
 struct FWMetadata {
     const UInt8 *data;
     const UInt32 length;
+    // Size of the zlib stream in `data`, or 0 if the blob is stored as is.
+    const UInt32 compressedLength {0};
+    // Sibling ASIC blob of the same length that `data` patches, see `applyDelta`.
+    const FWMetadata *base {nullptr};
+
+    // `dest` must have room for `length` bytes; compressed blobs are inflated straight into it.
+    void copyTo(void *dest) const {
+        if (this->base) {
+            this->base->copyTo(dest);
+            this->applyDelta(static_cast<UInt8 *>(dest));
+            return;
+        }
+        if (!this->compressedLength) {
+            memcpy(dest, this->data, this->length);
+            return;
+        }
+        auto *out = Compression::decompress(Compression::ModeZLIB, this->length, this->data, this->compressedLength,
+            static_cast<UInt8 *>(dest));
+        PANIC_COND(out == nullptr, "FW", "Failed to decompress firmware");
+    }
+
+    // Runs of a LEB128 count of unchanged bytes, a LEB128 length and that many bytes to XOR into the base, ended by
+    // an empty run. Must match `encode_delta` in Scripts/GenerateFirmware.py.
+    void applyDelta(UInt8 *dest) const {
+        const auto *patch = this->data;
+        auto readLEB128 = [&patch]() {
+            size_t value = 0;
+            for (size_t shift = 0;; shift += 7) {
+                auto byte = *patch++;
+                value |= static_cast<size_t>(byte & 0x7F) << shift;
+                if (byte < 0x80) { return value; }
+            }
+        };
+        for (size_t off = 0;;) {
+            off += readLEB128();
+            auto count = readLEB128();
+            if (!count) { return; }
+            PANIC_COND(off + count > this->length, "FW", "Delta run out of range");
+            for (size_t i = 0; i < count; i++) { dest[off + i] ^= patch[i]; }
+            patch += count;
+            off += count;
+        }
+    }
+};
+
+// A blob unpacked ahead of time, so that handing it to the PSP is a plain `memcpy` that can't fail.
+struct FWBlob {
+    const UInt8 *data {nullptr};
+    UInt32 length {0};
+
+    // Stored blobs are used in place, compressed or patched ones are unpacked into memory that is kept for as long as
+    // the kext is loaded. Panics if the blob doesn't unpack, which is before anything is handed to the PSP.
+    void load(const FWMetadata &fw) {
+        this->length = fw.length;
+        if (!fw.compressedLength && !fw.base) {
+            this->data = fw.data;
+            return;
+        }
+        auto *buf = static_cast<UInt8 *>(IOMalloc(fw.length));
+        PANIC_COND(buf == nullptr, "FW", "Failed to allocate %u bytes", fw.length);
+        fw.copyTo(buf);
+        this->data = buf;
+    }
+
+    void copyTo(void *dest) const { memcpy(dest, this->data, this->length); }
 };
 
 struct FWDescriptor {
@@ -14,14 +85,56 @@ struct FWDescriptor {
     const FWMetadata metadata;
 };
 
+// Generated by Scripts/GenerateFirmware.py, ordered by the slot of each name in a minimal perfect hash.
 extern const struct FWDescriptor firmware[];
 extern const size_t firmwareCount;
+extern const UInt32 firmwareSeeds[];
+extern const size_t firmwareSeedCount;
 
-inline const FWMetadata &getFWByName(const char *name) {
-    for (size_t i = 0; i < firmwareCount; i++) {
-        if (strcmp(firmware[i].name, name)) { continue; }
-
-        return firmware[i].metadata;
+// FNV-1a, must match `fw_name_hash` in Scripts/GenerateFirmware.py.
+constexpr UInt64 getFWNameHash(const char *name) {
+    UInt64 hash = 0xCBF29CE484222325;
+    for (size_t i = 0; name[i]; i++) {
+        hash ^= static_cast<UInt8>(name[i]);
+        hash *= 0x100000001B3;
     }
-    PANIC("FW", "'%s' not found", name);
+    return hash;
 }
+
+// The upper half of the hash picks the seed, which places the name in its own slot. Must match `fw_slot`.
+inline size_t getFWSlot(UInt64 hash) {
+    auto value = static_cast<UInt32>(hash) ^ firmwareSeeds[(hash >> 32) % firmwareSeedCount];
+    value ^= value >> 16;
+    value *= 0x85EBCA6B;
+    value ^= value >> 13;
+    value *= 0xC2B2AE35;
+    value ^= value >> 16;
+    return value % firmwareCount;
+}
+
+inline const FWMetadata &getFWByName(const char *name, UInt64 hash) {
+    const auto &fw = firmware[getFWSlot(hash)];
+    PANIC_COND(strcmp(fw.name, name), "FW", "'%s' not found", name);
+    return fw.metadata;
+}
+
+inline const FWMetadata &getFWByName(const char *name) { return getFWByName(name, getFWNameHash(name)); }
+
+// A blob name hashed at compile time, for tables of names.
+struct FWName {
+    const char *name {nullptr};
+    UInt64 hash {0};
+
+    constexpr FWName() = default;
+    constexpr FWName(const char *name) : name {name}, hash {getFWNameHash(name)} {}
+};
+
+inline const FWMetadata &getFWByName(const FWName &name) { return getFWByName(name.name, name.hash); }
+
+template<UInt64 Hash>
+inline const FWMetadata &getFWByHash(const char *name) {
+    return getFWByName(name, Hash);
+}
+
+// Hashes a literal name at compile time.
+#define FW_BY_NAME(name) getFWByHash<getFWNameHash(name)>(name)
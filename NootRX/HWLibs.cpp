@@ -3,7 +3,9 @@
 
 #include "HWLibs.hpp"
 #include "Firmware.hpp"
+#include "HWLibsTables.hpp"
 #include "NootRX.hpp"
+#include "OffsetCache.hpp"
 #include "PatcherPlus.hpp"
 #include <Headers/kern_api.hpp>
 
@@ -25,7 +27,7 @@ static KernelPatcher::KextInfo kextRadeonX6000HWServices {
     KernelPatcher::KextInfo::Unloaded,
 };
 
-static KernelPatcher::KextInfo kextRadeonX6810HWLibs {
+KernelPatcher::KextInfo kextRadeonX6810HWLibs {
     "com.apple.kext.AMDRadeonX6810HWLibs",
     &pathRadeonX6810HWLibs,
     1,
@@ -34,7 +36,7 @@ static KernelPatcher::KextInfo kextRadeonX6810HWLibs {
     KernelPatcher::KextInfo::Unloaded,
 };
 
-static KernelPatcher::KextInfo kextRadeonX6800HWLibs {
+KernelPatcher::KextInfo kextRadeonX6800HWLibs {
     "com.apple.kext.AMDRadeonX6800HWLibs",
     &pathRadeonX6800HWLibs,
     1,
@@ -55,26 +57,13 @@ void HWLibs::init() {
     lilu.onKextLoadForce(&kextRadeonX6810HWLibs);
 }
 
-#define DEF_FAKECPY(ident, filename)            \
-    static void ident(void *data) {             \
-        const auto &fw = getFWByName(filename); \
-        memcpy(data, fw.data, fw.length);       \
-    }
-
-DEF_FAKECPY(fakecpyNavi21Kdb, "psp_key_database_navi21.bin");
-DEF_FAKECPY(fakecpyNavi21Sos, "psp_sos_navi21.bin");
-DEF_FAKECPY(fakecpyNavi21SysDrv, "psp_sys_drv_navi21.bin");
-DEF_FAKECPY(fakecpyNavi21TosSpl, "psp_tos_spl_navi21.bin");
+// The PSP blobs copied by the `_memcpy` calls redirected in `processKext`, unpacked there for the current Navi.
+static FWBlob pspKeyDatabase {}, pspSOS {}, pspSysDrv {}, pspTOSSPL {};
 
-DEF_FAKECPY(fakecpyNavi22Kdb, "psp_key_database_navi22.bin");
-DEF_FAKECPY(fakecpyNavi22Sos, "psp_sos_navi22.bin");
-DEF_FAKECPY(fakecpyNavi22SysDrv, "psp_sys_drv_navi22.bin");
-DEF_FAKECPY(fakecpyNavi22TosSpl, "psp_tos_spl_navi22.bin");
-
-DEF_FAKECPY(fakecpyNavi23Kdb, "psp_key_database_navi23.bin");
-DEF_FAKECPY(fakecpyNavi23Sos, "psp_sos_navi23.bin");
-DEF_FAKECPY(fakecpyNavi23SysDrv, "psp_sys_drv_navi23.bin");
-DEF_FAKECPY(fakecpyNavi23TosSpl, "psp_tos_spl_navi23.bin");
+static void fakecpyKdb(void *data) { pspKeyDatabase.copyTo(data); }
+static void fakecpySos(void *data) { pspSOS.copyTo(data); }
+static void fakecpySysDrv(void *data) { pspSysDrv.copyTo(data); }
+static void fakecpyTosSpl(void *data) { pspTOSSPL.copyTo(data); }
 
 bool HWLibs::processKext(KernelPatcher &patcher, size_t id, mach_vm_address_t slide, size_t size) {
     if (kextRadeonX6000HWServices.loadIndex == id) {
@@ -86,6 +75,7 @@ bool HWLibs::processKext(KernelPatcher &patcher, size_t id, mach_vm_address_t sl
     }
 
     if (kextRadeonX6810HWLibs.loadIndex == id || kextRadeonX6800HWLibs.loadIndex == id) {
+        OffsetCache::get().setKext("HWLibs");
         NootRXMain::callback->ensureRMMIO();
 
         if (NootRXMain::callback->attributes.isNavi21() || !NootRXMain::callback->attributes.isVenturaAndLater()) {
@@ -94,54 +84,77 @@ bool HWLibs::processKext(KernelPatcher &patcher, size_t id, mach_vm_address_t sl
             this->pspCommandDataField = 0xB48;
         }
 
+        // Everything the PSP is handed is unpacked now, so that the hooks only have to copy it.
+        const FWMetadata *resolved[kUCodeVCN1 + 1] {};
+        resolveIPFirmware(NootRXMain::callback->attributes, resolved);
+        for (size_t i = 0; i < arrsize(resolved); i++) {
+            if (!resolved[i]) { continue; }
+            // VCN0 and VCN1 share their blob.
+            size_t first = 0;
+            while (resolved[first] != resolved[i]) { first += 1; }
+            if (first < i) {
+                this->ipFirmware[i] = this->ipFirmware[first];
+            } else {
+                this->ipFirmware[i].load(*resolved[i]);
+            }
+        }
+        for (size_t i = 0; i < arrsize(pspApplicationFirmware); i++) {
+            this->pspApplications[i].load(getFWByName(pspApplicationFirmware[i].firmware));
+        }
+        this->pspASD.load(FW_BY_NAME("psp_asd.bin"));
+
         CAILAsicCapsEntry *orgCapsTable = nullptr;
         CAILDeviceTypeEntry *orgDeviceTypeTable = nullptr;
         DeviceCapabilityEntry *orgDevCapTable = nullptr;
         CAILAsicCapsInitEntry *orgCapsInitTable = nullptr;
 
         SolveRequestPlus solveRequests[] = {
-            {"__ZL15deviceTypeTable", orgDeviceTypeTable, kDeviceTypeTablePattern},
-            {"__ZL20CAIL_ASIC_CAPS_TABLE", orgCapsTable, kCailAsicCapsTableHWLibsPattern},
-            {"_DeviceCapabilityTbl", orgDevCapTable, kDeviceCapabilityTblPattern},
+            {"__ZL15deviceTypeTable", orgDeviceTypeTable, kDeviceTypeTablePattern, PatternSection::Data},
+            {"__ZL20CAIL_ASIC_CAPS_TABLE", orgCapsTable, kCailAsicCapsTableHWLibsPattern, PatternSection::Data},
+            {"_DeviceCapabilityTbl", orgDevCapTable, kDeviceCapabilityTblPattern, PatternSection::Data},
         };
         PANIC_COND(!SolveRequestPlus::solveAll(patcher, id, solveRequests, slide, size), "HWLibs",
             "Failed to resolve symbols");
-        SolveRequestPlus solveRequest {"_CAILAsicCapsInitTable", orgCapsInitTable, kCAILAsicCapsInitTablePattern};
+        SolveRequestPlus solveRequest {"_CAILAsicCapsInitTable", orgCapsInitTable, kCAILAsicCapsInitTablePattern,
+            PatternSection::Data};
         solveRequest.solve(patcher, id, slide, size);
 
+        // Everything below is checked first and then written in one go.
+        PatchSession session {};
+
         if (NootRXMain::callback->attributes.isSonoma1404AndLater()) {
             RouteRequestPlus request = {"_psp_cmd_km_submit", wrapPspCmdKmSubmit, this->orgPspCmdKmSubmit,
-                kPspCmdKmSubmitPattern14_4, kPspCmdKmSubmitMask14_4};
-            PANIC_COND(!request.route(patcher, id, slide, size), "HWLibs", "Failed to route psp_cmd_km_submit (14.4+)");
+                kPspCmdKmSubmitPattern14_4};
+            PANIC_COND(!request.stage(session, patcher, id, slide, size), "HWLibs",
+                "Failed to route psp_cmd_km_submit (14.4+)");
         } else {
             RouteRequestPlus request = {"_psp_cmd_km_submit", wrapPspCmdKmSubmit, this->orgPspCmdKmSubmit,
-                kPspCmdKmSubmitPattern, kPspCmdKmSubmitMask};
-            PANIC_COND(!request.route(patcher, id, slide, size), "HWLibs", "Failed to route psp_cmd_km_submit");
+                kPspCmdKmSubmitPattern};
+            PANIC_COND(!request.stage(session, patcher, id, slide, size), "HWLibs",
+                "Failed to route psp_cmd_km_submit");
         }
 
         if (NootRXMain::callback->attributes.isNavi22()) {
             if (NootRXMain::callback->attributes.isSonoma1404AndLater()) {
                 RouteRequestPlus request = {"_smu_11_0_7_send_message_with_parameter",
                     wrapSmu1107SendMessageWithParameter, this->orgSmu1107SendMessageWithParameter,
-                    kSmu1107SendMessageWithParameterPattern14_4, kSmu1107SendMessageWithParameterPatternMask14_4};
-                PANIC_COND(!request.route(patcher, id, slide, size), "HWLibs",
+                    kSmu1107SendMessageWithParameterPattern14_4};
+                PANIC_COND(!request.stage(session, patcher, id, slide, size), "HWLibs",
                     "Failed to route smu_11_0_7_send_message_with_parameter (14.4+)");
             } else {
                 RouteRequestPlus request = {"_smu_11_0_7_send_message_with_parameter",
                     wrapSmu1107SendMessageWithParameter, this->orgSmu1107SendMessageWithParameter,
-                    kSmu1107SendMessageWithParameterPattern, kSmu1107SendMessageWithParameterPatternMask};
-                PANIC_COND(!request.route(patcher, id, slide, size), "HWLibs",
+                    kSmu1107SendMessageWithParameterPattern};
+                PANIC_COND(!request.stage(session, patcher, id, slide, size), "HWLibs",
                     "Failed to route smu_11_0_7_send_message_with_parameter");
             }
         }
 
-        PANIC_COND(MachInfo::setKernelWriting(true, KernelPatcher::kernelWriteLock) != KERN_SUCCESS, "HWLibs",
-            "Failed to enable kernel writing");
-
-        *orgDeviceTypeTable = {
+        const CAILDeviceTypeEntry deviceType = {
             .deviceId = NootRXMain::callback->deviceId,
             .deviceType = (kextRadeonX6800HWLibs.loadIndex == id) ? 6U : 8,
         };
+        session.write(orgDeviceTypeTable, deviceType);
 
         UInt32 targetDeviceId = NootRXMain::callback->attributes.isNavi21() ? 0x73BF : 0x73FF;
         while (true) {
@@ -150,21 +163,24 @@ bool HWLibs::processKext(KernelPatcher &patcher, size_t id, mach_vm_address_t sl
                 orgCapsTable += 1;
                 continue;
             }
-            orgCapsTable->deviceId = NootRXMain::callback->deviceId;
-            orgCapsTable->revNo = NootRXMain::callback->devRevision;
-            orgCapsTable->emulatedRevNo =
+            auto capsEntry = *orgCapsTable;
+            capsEntry.deviceId = NootRXMain::callback->deviceId;
+            capsEntry.revNo = NootRXMain::callback->devRevision;
+            capsEntry.emulatedRevNo =
                 static_cast<UInt32>(NootRXMain::callback->enumRevision) + NootRXMain::callback->devRevision;
-            orgCapsTable->revId = NootRXMain::callback->pciRevision;
-            orgCapsTable->caps = ddiCapsNavi2Universal;
+            capsEntry.revId = NootRXMain::callback->pciRevision;
+            capsEntry.caps = ddiCapsNavi2Universal;
+            session.write(orgCapsTable, capsEntry);
             if (orgCapsInitTable) {
-                *orgCapsInitTable = {
+                const CAILAsicCapsInitEntry capsInit = {
                     .familyId = AMDGPU_FAMILY_NAVI,
                     .deviceId = NootRXMain::callback->deviceId,
                     .revision = NootRXMain::callback->devRevision,
-                    .extRevision = static_cast<UInt32>(orgCapsTable->emulatedRevNo),
+                    .extRevision = static_cast<UInt32>(capsEntry.emulatedRevNo),
                     .pciRevision = NootRXMain::callback->pciRevision,
-                    .caps = orgCapsTable->caps,
+                    .caps = capsEntry.caps,
                 };
+                session.write(orgCapsInitTable, capsInit);
             }
             break;
         }
@@ -175,158 +191,87 @@ bool HWLibs::processKext(KernelPatcher &patcher, size_t id, mach_vm_address_t sl
                 orgDevCapTable += 1;
                 continue;
             }
-            orgDevCapTable->deviceId = NootRXMain::callback->deviceId;
-            orgDevCapTable->extRevision =
+            auto devCap = *orgDevCapTable;
+            devCap.deviceId = NootRXMain::callback->deviceId;
+            devCap.extRevision =
                 static_cast<UInt64>(NootRXMain::callback->enumRevision) + NootRXMain::callback->devRevision;
-            orgDevCapTable->revision = DEVICE_CAP_ENTRY_REV_DONT_CARE;
-            orgDevCapTable->enumRevision = DEVICE_CAP_ENTRY_REV_DONT_CARE;
-            orgDevCapTable->asicGoldenSettings->goldenSettings =
-                NootRXMain::callback->attributes.isNavi21() ? goldenSettingsNavi21 :
-                NootRXMain::callback->attributes.isNavi22() ? goldenSettingsNavi22 :
-                                                              goldenSettingsNavi23;
+            devCap.revision = DEVICE_CAP_ENTRY_REV_DONT_CARE;
+            devCap.enumRevision = DEVICE_CAP_ENTRY_REV_DONT_CARE;
+            session.write(orgDevCapTable, devCap);
+            auto goldenSettings = *devCap.asicGoldenSettings;
+            goldenSettings.goldenSettings = NootRXMain::callback->attributes.isNavi21() ? goldenSettingsNavi21 :
+                                            NootRXMain::callback->attributes.isNavi22() ? goldenSettingsNavi22 :
+                                                                                          goldenSettingsNavi23;
+            session.write(devCap.asicGoldenSettings, goldenSettings);
             break;
         }
-        MachInfo::setKernelWriting(false, KernelPatcher::kernelWriteLock);
-        DBGLOG("HWLibs", "Applied DDI Caps patches");
-
-        auto hijackMemCpyBlock = [=](UInt32 arg1, UInt32 arg1Mask, void (*func)(void *data)) {
-            const UInt8 find[] = {0x48, 0x8D, 0x35, 0x00, 0x00, 0x00, 0x00, 0xBA, static_cast<UInt8>(arg1 & 0xFF),
-                static_cast<UInt8>((arg1 >> 8) & 0xFF), static_cast<UInt8>((arg1 >> 16) & 0xFF),
-                static_cast<UInt8>((arg1 >> 24) & 0xFF), 0x4C, 0x89, 0x00, 0xE8, 0x00, 0x00, 0x00, 0x00};
-            const UInt8 mask[] = {0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0xFF, static_cast<UInt8>(arg1Mask & 0xFF),
-                static_cast<UInt8>((arg1Mask >> 8) & 0xFF), static_cast<UInt8>((arg1Mask >> 16) & 0xFF),
-                static_cast<UInt8>((arg1Mask >> 24) & 0xFF), 0xFF, 0xFF, 0x00, 0xFF, 0x00, 0x00, 0x00, 0x00};
-            size_t dataOffset = 0;
-            if (!KernelPatcher::findPattern(find, mask, arrsize(find), reinterpret_cast<void *>(slide), size,
-                    &dataOffset)) {
-                const UInt8 find[] = {0x48, 0x8D, 0x35, 0x00, 0x00, 0x00, 0x00, 0xBA, static_cast<UInt8>(arg1 & 0xFF),
-                    static_cast<UInt8>((arg1 >> 8) & 0xFF), static_cast<UInt8>((arg1 >> 16) & 0xFF),
-                    static_cast<UInt8>((arg1 >> 24) & 0xFF), 0xE8, 0x00, 0x00, 0x00, 0x00, 0x40};
-                const UInt8 mask[] = {0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0xFF,
-                    static_cast<UInt8>(arg1Mask & 0xFF), static_cast<UInt8>((arg1Mask >> 8) & 0xFF),
-                    static_cast<UInt8>((arg1Mask >> 16) & 0xFF), static_cast<UInt8>((arg1Mask >> 24) & 0xFF), 0xFF,
-                    0x00, 0x00, 0x00, 0x00, 0xF0};
-                PANIC_COND(!KernelPatcher::findPattern(find, mask, arrsize(find), reinterpret_cast<void *>(slide), size,
-                               &dataOffset),
-                    "HWLibs", "Failed to find memcpy block 0x%04X&0x%04X", arg1, arg1Mask);
-                auto block = slide + dataOffset;
-                // 0x0 lea rsi, [rel ...]
-                // movabs rsi, 0x<FAKECPY_FUNC_ADDR>
-                *reinterpret_cast<UInt16 *>(block) = 0xBE48;
-                *reinterpret_cast<UInt64 *>(block + 2) = reinterpret_cast<UInt64>(func);
-                *reinterpret_cast<UInt16 *>(block + 10) = 0xD6FF;    // call rsi
-                // 0xC call _memcpy
-                *reinterpret_cast<UInt32 *>(block + 12) = 0x66906690;    // nop nop
-                *reinterpret_cast<UInt16 *>(block + 15) = 0x6690;        // nop
-                // 0xF lea, mov, etc.
-                return;
-            }
-            auto block = slide + dataOffset;
-            // 0x0 lea rsi, [rel ...]
-            *reinterpret_cast<UInt16 *>(block) = 0xBE48;                                // movabs rsi,
-            *reinterpret_cast<UInt64 *>(block + 2) = reinterpret_cast<UInt64>(func);    // 0x<FAKECPY_FUNC_ADDR>
-            *reinterpret_cast<UInt16 *>(block + 10) = 0x6690;                           // nop
-            // 0xC mov rdi, ...
-            // 0xF call _memcpy
-            *reinterpret_cast<UInt16 *>(block + 15) = 0xD6FF;    // call rsi
-            *reinterpret_cast<UInt16 *>(block + 17) = 0x6690;    // nop
-            *reinterpret_cast<UInt8 *>(block + 19) = 0x90;       // nop
-        };
+        DBGLOG("HWLibs", "Staged DDI Caps patches");
 
-        PANIC_COND(MachInfo::setKernelWriting(true, KernelPatcher::kernelWriteLock) != KERN_SUCCESS, "HWLibs",
-            "Failed to enable kernel writing");
+        // The size is at 0x8, the function address goes at 0x2.
+        const CallSiteShape pspMemcpyShapes[] = {
+            {kPspMemcpyCallOriginal, kPspMemcpyCallPatched, 8, 2},
+            {kPspMemcpyCallOriginal2, kPspMemcpyCallPatched2, 8, 2},
+        };
         if (NootRXMain::callback->attributes.isNavi21()) {
-            hijackMemCpyBlock(0x00001310, 0xFFFFFFFF, fakecpyNavi21Kdb);
-            hijackMemCpyBlock(0x00014350, 0xFFFFFFFF, fakecpyNavi21Sos);
-            hijackMemCpyBlock(0x00000770, 0xFFFC0FFF, fakecpyNavi21SysDrv);
-            hijackMemCpyBlock(0x000003A0, 0xFFFFFFFF, fakecpyNavi21TosSpl);
+            pspKeyDatabase.load(FW_BY_NAME("psp_key_database_navi21.bin"));
+            pspSOS.load(FW_BY_NAME("psp_sos_navi21.bin"));
+            pspSysDrv.load(FW_BY_NAME("psp_sys_drv_navi21.bin"));
+            pspTOSSPL.load(FW_BY_NAME("psp_tos_spl_navi21.bin"));
+            const CallSiteRedirect redirects[] = {
+                {0x00001310, 0xFFFFFFFF, fakecpyKdb},
+                {0x00014350, 0xFFFFFFFF, fakecpySos},
+                {0x00000770, 0xFFFC0FFF, fakecpySysDrv},
+                {0x000003A0, 0xFFFFFFFF, fakecpyTosSpl},
+            };
+            PANIC_COND(!CallSiteRedirect::stageAll(session, pspMemcpyShapes, redirects, slide, size), "HWLibs",
+                "Failed to apply PSP memcpy firmware patches");
         } else if (NootRXMain::callback->attributes.isNavi22()) {
-            hijackMemCpyBlock(0x00001070, 0xFFFFFFFF, fakecpyNavi22Kdb);
-            hijackMemCpyBlock(0x00014350, 0xFFFFFFFF, fakecpyNavi22Sos);
-            hijackMemCpyBlock(0x00010790, 0xFFFF0FFF, fakecpyNavi22SysDrv);
-            hijackMemCpyBlock(0x000003A0, 0xFFFFFFFF, fakecpyNavi22TosSpl);
-        } else {
-            hijackMemCpyBlock(0x00001070, 0xFFFFFFFF, fakecpyNavi23Kdb);
-            hijackMemCpyBlock(0x00014350, 0xFFFFFFFF, fakecpyNavi23Sos);
-            hijackMemCpyBlock(0x00010790, 0xFFFF0FFF, fakecpyNavi23SysDrv);
-            hijackMemCpyBlock(0x000003A0, 0xFFFFFFFF, fakecpyNavi23TosSpl);
-        }
-        MachInfo::setKernelWriting(false, KernelPatcher::kernelWriteLock);
-        DBGLOG("HWLibs", "Applied PSP memcpy firmware patches");
-
-        if (NootRXMain::callback->attributes.isNavi21()) {
-            if (NootRXMain::callback->attributes.isBigSur()) {
-                const LookupPatchPlus patch {&kextRadeonX6800HWLibs, kSmu1107CheckFwVersionNavi21Original,
-                    kSmu1107CheckFwVersionNavi21OriginalMask, kSmu1107CheckFwVersionNavi21Patched,
-                    kSmu1107CheckFwVersionNavi21PatchedMask, 1};
-                PANIC_COND(!patch.apply(patcher, slide, size), "HWLibs",
-                    "Failed to apply smu_11_0_7_check_fw_version patch (11.0)");
-            } else {
-                const LookupPatchPlus patch {&kextRadeonX6800HWLibs, kSmu1107CheckFwVersionNavi21Original_12,
-                    kSmu1107CheckFwVersionNavi21OriginalMask_12, kSmu1107CheckFwVersionNavi21Patched_12,
-                    kSmu1107CheckFwVersionNavi21PatchedMask_12, 1};
-                PANIC_COND(!patch.apply(patcher, slide, size), "HWLibs",
-                    "Failed to apply smu_11_0_7_check_fw_version patch (12.0+)");
-            }
+            pspKeyDatabase.load(FW_BY_NAME("psp_key_database_navi22.bin"));
+            pspSOS.load(FW_BY_NAME("psp_sos_navi22.bin"));
+            pspSysDrv.load(FW_BY_NAME("psp_sys_drv_navi22.bin"));
+            pspTOSSPL.load(FW_BY_NAME("psp_tos_spl_navi22.bin"));
+            const CallSiteRedirect redirects[] = {
+                {0x00001070, 0xFFFFFFFF, fakecpyKdb},
+                {0x00014350, 0xFFFFFFFF, fakecpySos},
+                {0x00010790, 0xFFFF0FFF, fakecpySysDrv},
+                {0x000003A0, 0xFFFFFFFF, fakecpyTosSpl},
+            };
+            PANIC_COND(!CallSiteRedirect::stageAll(session, pspMemcpyShapes, redirects, slide, size), "HWLibs",
+                "Failed to apply PSP memcpy firmware patches");
         } else {
-            const LookupPatchPlus patch {&kextRadeonX6810HWLibs, kSmu1107CheckFwVersionOriginal,
-                kSmu1107CheckFwVersionOriginalMask, kSmu1107CheckFwVersionPatched, kSmu1107CheckFwVersionPatchedMask,
-                1};
-            PANIC_COND(!patch.apply(patcher, slide, size), "HWLibs",
-                "Failed to apply smu_11_0_7_check_fw_version patch");
+            pspKeyDatabase.load(FW_BY_NAME("psp_key_database_navi23.bin"));
+            pspSOS.load(FW_BY_NAME("psp_sos_navi23.bin"));
+            pspSysDrv.load(FW_BY_NAME("psp_sys_drv_navi23.bin"));
+            pspTOSSPL.load(FW_BY_NAME("psp_tos_spl_navi23.bin"));
+            const CallSiteRedirect redirects[] = {
+                {0x00001070, 0xFFFFFFFF, fakecpyKdb},
+                {0x00014350, 0xFFFFFFFF, fakecpySos},
+                {0x00010790, 0xFFFF0FFF, fakecpySysDrv},
+                {0x000003A0, 0xFFFFFFFF, fakecpyTosSpl},
+            };
+            PANIC_COND(!CallSiteRedirect::stageAll(session, pspMemcpyShapes, redirects, slide, size), "HWLibs",
+                "Failed to apply PSP memcpy firmware patches");
         }
+        DBGLOG("HWLibs", "Staged PSP memcpy firmware patches");
 
-        if (NootRXMain::callback->attributes.isNavi22()) {
-            const LookupPatchPlus patch {&kextRadeonX6810HWLibs, kGcSwInitOriginal, kGcSwInitOriginalMask,
-                kGcSwInitPatched, kGcSwInitPatchedMask, 1};
-            PANIC_COND(!patch.apply(patcher, slide, size), "HWLibs", "Failed to apply Navi 22 gc_sw_init patch");
-            if (NootRXMain::callback->attributes.isSonoma1404AndLater()) {
-                const LookupPatchPlus patches[] = {
-                    {&kextRadeonX6810HWLibs, kGcSetFwEntryInfoOriginal14_4, kGcSetFwEntryInfoOriginalMask14_4,
-                        kGcSetFwEntryInfoPatched14_4, kGcSetFwEntryInfoPatchedMask14_4, 1},
-                    {&kextRadeonX6810HWLibs, kPspSwInit1Original14_4, kPspSwInit1OriginalMask14_4,
-                        kPspSwInit1Patched14_4, kPspSwInit1PatchedMask14_4, 1},
-                    {&kextRadeonX6810HWLibs, kPspSwInit2Original14_4, kPspSwInit2OriginalMask14_4,
-                        kPspSwInit2Patched14_4, kPspSwInit2PatchedMask14_4, 1},
-                    {&kextRadeonX6810HWLibs, kPspSwInit3Original14_4, kPspSwInit3Patched14_4, 1},
-                    {&kextRadeonX6810HWLibs, kSdmaInitFunctionPointerOriginal14_4,
-                        kSdmaInitFunctionPointerOriginalMask14_4, kSdmaInitFunctionPointerPatched14_4, 1},
-                };
-                PANIC_COND(!LookupPatchPlus::applyAll(patcher, patches, slide, size), "HWLibs",
-                    "Failed to apply Navi 22 patches (>=14.4)");
-            } else {
-                const LookupPatchPlus patches[] = {
-                    {&kextRadeonX6810HWLibs, kGcSetFwEntryInfoOriginal, kGcSetFwEntryInfoOriginalMask,
-                        kGcSetFwEntryInfoPatched, kGcSetFwEntryInfoPatchedMask, 1},
-                    {&kextRadeonX6810HWLibs, kPspSwInit1Original, kPspSwInit1OriginalMask, kPspSwInit1Patched,
-                        kPspSwInit1PatchedMask, 1},
-                    {&kextRadeonX6810HWLibs, kPspSwInit2Original, kPspSwInit2OriginalMask, kPspSwInit2Patched,
-                        kPspSwInit2PatchedMask, 1},
-                    {&kextRadeonX6810HWLibs, kPspSwInit3Original, kPspSwInit3OriginalMask, kPspSwInit3Patched,
-                        kPspSwInit3PatchedMask, 1},
-                };
-                PANIC_COND(!LookupPatchPlus::applyAll(patcher, patches, slide, size), "HWLibs",
-                    "Failed to apply Navi 22 patches (<14.4)");
-                if (NootRXMain::callback->attributes.isVenturaAndLater()) {
-                    const LookupPatchPlus patch {&kextRadeonX6810HWLibs, kSdmaInitFunctionPointerOriginal,
-                        kSdmaInitFunctionPointerOriginalMask, kSdmaInitFunctionPointerPatched, 1};
-                    PANIC_COND(!patch.apply(patcher, slide, size), "HWLibs",
-                        "Failed to apply Navi 22 Ventura SDMA patch");
-                }
-            }
-        }
+        auto *plan = hwLibsPatchPlans.find(NootRXMain::callback->attributes.getValue());
+        PANIC_COND(plan == nullptr, "HWLibs", "No patch plan for attributes 0x%X",
+            NootRXMain::callback->attributes.getValue());
+        PANIC_COND(!plan->stage(session, hwLibsPatches, slide, size), "HWLibs", "Failed to apply patch plan");
 
         if (ADDPR(debugEnabled)) {
             auto *targetKext =
                 NootRXMain::callback->attributes.isNavi21() ? &kextRadeonX6800HWLibs : &kextRadeonX6810HWLibs;
             const LookupPatchPlus patches[] = {
                 {targetKext, kAtiPowerPlayServicesConstructorOriginal, kAtiPowerPlayServicesConstructorPatched, 1},
-                {targetKext, kAmdLogPspOriginal, kAmdLogPspOriginalMask, kAmdLogPspPatched, 1},
+                {targetKext, kAmdLogPspOriginal, kAmdLogPspPatched, 1},
             };
-            PANIC_COND(!LookupPatchPlus::applyAll(patcher, patches, slide, size), "HWLibs",
+            PANIC_COND(!LookupPatchPlus::stageAll(session, patches, slide, size), "HWLibs",
                 "Failed to apply debug enablement patches");
         }
 
+        PANIC_COND(!session.commit(patcher), "HWLibs", "Failed to commit patches");
+
         return true;
     }
 
@@ -339,146 +284,40 @@ const char *HWLibs::wrapGetMatchProperty() {
 }
 
 CAILResult HWLibs::wrapPspCmdKmSubmit(void *ctx, void *cmd, void *outData, void *outResponse) {
-    char filename[128];
-    bzero(filename, sizeof(filename));
     auto &size = getMember<UInt32>(cmd, 0xC);
     auto cmdID = getMember<AMDPSPCommand>(cmd, 0x0);
     auto *data = callback->pspCommandDataField.get(ctx);
 
+    const FWBlob *fw = nullptr;
     switch (cmdID) {
         case kPSPCommandLoadTA: {
             const char *name = reinterpret_cast<char *>(data + 0x8DB);
-            if (!strncmp(name, "AMD DTM Application", 20)) {
-                strncpy(filename, "psp_dtm.bin", 12);
-                break;
-            }
-            if (!strncmp(name, "AMD RAP Application", 20)) {
-                strncpy(filename, "psp_rap.bin", 12);
-                break;
-            }
-            if (!strncmp(name, "AMD HDCP Application", 21)) {
-                strncpy(filename, "psp_hdcp.bin", 13);
-                break;
-            }
-            if (!strncmp(name, "AMD AUC Application", 20)) {
-                strncpy(filename, "psp_auc.bin", 12);
-                break;
-            }
-            if (!strncmp(name, "AMD FP Application", 19)) {
-                strncpy(filename, "psp_fp.bin", 11);
-                break;
+            for (size_t i = 0; i < arrsize(pspApplicationFirmware); i++) {
+                const auto *application = pspApplicationFirmware[i].application;
+                if (!strncmp(name, application, strlen(application) + 1)) {
+                    fw = &callback->pspApplications[i];
+                    break;
+                }
             }
-
-            return FunctionCast(wrapPspCmdKmSubmit, callback->orgPspCmdKmSubmit)(ctx, cmd, outData, outResponse);
+            break;
         }
         case kPSPCommandLoadASD:
-            strncpy(filename, "psp_asd.bin", 12);
+            fw = &callback->pspASD;
             break;
         case kPSPCommandLoadIPFW: {
-            auto *prefix = NootRXMain::callback->getGCPrefix();
             auto uCodeID = getMember<AMDUCodeID>(cmd, 0x10);
-            switch (uCodeID) {
-                case kUCodeSMU:
-                    if (NootRXMain::callback->attributes.isNavi21()) {
-                        strncpy(filename, "navi21_smc_firmware.bin", 24);
-                    } else if (NootRXMain::callback->attributes.isNavi22()) {
-                        strncpy(filename, "navi22_smc_firmware.bin", 24);
-                    } else {
-                        strncpy(filename, "navi23_smc_firmware.bin", 24);
-                    }
-                    break;
-                case kUCodeCE:
-                    snprintf(filename, sizeof(filename), "%sce_ucode.bin", prefix);
-                    break;
-                case kUCodePFP:
-                    snprintf(filename, sizeof(filename), "%spfp_ucode.bin", prefix);
-                    break;
-                case kUCodeME:
-                    snprintf(filename, sizeof(filename), "%sme_ucode.bin", prefix);
-                    break;
-                case kUCodeMEC1:
-                case kUCodeMEC2:
-                    snprintf(filename, sizeof(filename), "%smec_ucode.bin", prefix);
-                    break;
-                case kUCodeMEC1JT:
-                case kUCodeMEC2JT:
-                    snprintf(filename, sizeof(filename), "%smec_jt_ucode.bin", prefix);
-                    break;
-                // case kUCodeMES:
-                //     strncpy(filename, "mes_10_3_mes0_ucode.bin", 24);
-                //     break;
-                // case kUCodeMESStack:
-                //     strncpy(filename, "mes_10_3_mes0_data.bin", 23);
-                //     break;
-                case kUCodeRLC:
-                    snprintf(filename, sizeof(filename), "%srlc_ucode.bin", prefix);
-                    break;
-                case kUCodeSDMA0:
-                    if (NootRXMain::callback->attributes.isNavi21()) {
-                        strncpy(filename, "sdma_5_2_ucode.bin", 19);
-                    } else if (NootRXMain::callback->attributes.isNavi22()) {
-                        strncpy(filename, "sdma_5_2_2_ucode.bin", 21);
-                    } else {
-                        strncpy(filename, "sdma_5_2_4_ucode.bin", 21);
-                    }
-                    break;
-                case kUCodeVCN0:
-                case kUCodeVCN1:
-                    strncpy(filename, "ativvaxy_vcn3.dat", 18);
-                    break;
-                case kUCodeRLCP:
-                    snprintf(filename, sizeof(filename), "%srlcp_ucode.bin", prefix);
-                    break;
-                case kUCodeRLCSRListGPM:
-                    snprintf(filename, sizeof(filename), "%srlc_srlist_gpm_mem.bin", prefix);
-                    break;
-                case kUCodeRLCSRListSRM:
-                    snprintf(filename, sizeof(filename), "%srlc_srlist_srm_mem.bin", prefix);
-                    break;
-                case kUCodeRLCSRListCntl:
-                    snprintf(filename, sizeof(filename), "%srlc_srlist_cntl.bin", prefix);
-                    break;
-                case kUCodeRLCLX6Iram:
-                    snprintf(filename, sizeof(filename), "%srlc_lx6_iram_ucode.bin", prefix);
-                    break;
-                case kUCodeRLCLX6Dram:
-                    snprintf(filename, sizeof(filename), "%srlc_lx6_dram_ucode.bin", prefix);
-                    break;
-                case kUCodeGlobalTapDelays:
-                    snprintf(filename, sizeof(filename), "%sglobal_tap_delays.bin", prefix);
-                    break;
-                case kUCodeSE0TapDelays:
-                    snprintf(filename, sizeof(filename), "%sse0_tap_delays.bin", prefix);
-                    break;
-                case kUCodeSE1TapDelays:
-                    snprintf(filename, sizeof(filename), "%sse1_tap_delays.bin", prefix);
-                    break;
-                case kUCodeSE2TapDelays:
-                    snprintf(filename, sizeof(filename), "%sse2_tap_delays.bin", prefix);
-                    break;
-                case kUCodeSE3TapDelays:
-                    snprintf(filename, sizeof(filename), "%sse3_tap_delays.bin", prefix);
-                    break;
-                case kUCodeDMCUB:
-                    if (NootRXMain::callback->attributes.isNavi23()) {
-                        strncpy(filename, "atidmcub_instruction_dcn302.bin", 32);
-                    } else {
-                        strncpy(filename, "atidmcub_instruction_dcn30.bin", 31);
-                    }
-                    break;
-                default:
-                    return FunctionCast(wrapPspCmdKmSubmit, callback->orgPspCmdKmSubmit)(ctx, cmd, outData,
-                        outResponse);
+            if (uCodeID < arrsize(callback->ipFirmware) && callback->ipFirmware[uCodeID].data) {
+                fw = &callback->ipFirmware[uCodeID];
             }
             break;
         }
         default:
-            return FunctionCast(wrapPspCmdKmSubmit, callback->orgPspCmdKmSubmit)(ctx, cmd, outData, outResponse);
+            break;
     }
+    if (!fw) { return FunctionCast(wrapPspCmdKmSubmit, callback->orgPspCmdKmSubmit)(ctx, cmd, outData, outResponse); }
 
-    const auto &fw = getFWByName(filename);
-    memcpy(data, fw.data, fw.length);
-    size = fw.length;
+    fw->copyTo(data);
+    size = fw->length;
 
     return FunctionCast(wrapPspCmdKmSubmit, callback->orgPspCmdKmSubmit)(ctx, cmd, outData, outResponse);
 }
@@ -3,10 +3,15 @@
 
 #pragma once
 #include "AMDCommon.hpp"
+#include "BytePattern.hpp"
+#include "Firmware.hpp"
 #include "ObjectField.hpp"
 #include <Headers/kern_patcher.hpp>
 #include <Headers/kern_util.hpp>
 
+// Entries in `pspApplicationFirmware`.
+static constexpr size_t PSPApplicationCount = 5;
+
 class HWLibs {
     static HWLibs *callback;
 
@@ -16,6 +21,10 @@ class HWLibs {
 
     private:
     ObjectField<UInt8 *> pspCommandDataField {};
+    // Unpacked in `processKext` for the current Navi.
+    FWBlob ipFirmware[kUCodeVCN1 + 1] {};
+    FWBlob pspApplications[PSPApplicationCount] {};
+    FWBlob pspASD {};
 
     mach_vm_address_t orgPspCmdKmSubmit {0};
     mach_vm_address_t orgSmu1107SendMessageWithParameter {0};
@@ -42,129 +51,84 @@ static const UInt8 kDeviceCapabilityTblPattern[] = {0x82, 0x00, 0x00, 0x00, 0x00
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x73, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFE, 0xCA, 0xAD, 0xDE, 0x00, 0x00,
     0x00, 0x00, 0xFE, 0xCA, 0xAD, 0xDE, 0x00, 0x00, 0x00, 0x00};
 
-static const UInt8 kPspCmdKmSubmitPattern[] = {0x55, 0x48, 0x89, 0xE5, 0x41, 0x57, 0x41, 0x56, 0x41, 0x55, 0x41, 0x54,
-    0x53, 0x50, 0x49, 0x89, 0xCD, 0x49, 0x89, 0xD7, 0x49, 0x89, 0xF4, 0x48, 0x89, 0xFB, 0x48, 0x8D, 0x75, 0xD0, 0xC7,
-    0x06, 0x00, 0x00, 0x00, 0x00, 0xE8, 0x00, 0x00, 0x00, 0x00};
-static const UInt8 kPspCmdKmSubmitMask[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00};
-
-static const UInt8 kPspCmdKmSubmitPattern14_4[] = {0x55, 0x48, 0x89, 0xE5, 0x41, 0x57, 0x41, 0x56, 0x41, 0x55, 0x41,
-    0x54, 0x53, 0x48, 0x83, 0xEC, 0x18, 0x49, 0x89, 0xCD, 0x49, 0x89, 0xD7, 0x49, 0x89, 0xF4, 0x49, 0x89, 0xFE, 0x48,
-    0x8D, 0x75, 0xD0, 0xC7, 0x06, 0x00, 0x00, 0x00, 0x00, 0xE8, 0x00, 0x00, 0x00, 0x00};
-static const UInt8 kPspCmdKmSubmitMask14_4[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00};
-
-static const UInt8 kSmu1107SendMessageWithParameterPattern[] = {0x55, 0x48, 0x89, 0xE5, 0x41, 0x57, 0x41, 0x56, 0x41,
-    0x54, 0x53, 0x41, 0x89, 0xD6, 0x41, 0x89, 0xF7, 0x48, 0x89, 0xFB, 0x8B, 0x8F, 0x00, 0x00, 0x00, 0x00, 0x48, 0x8D,
-    0x35};
-static const UInt8 kSmu1107SendMessageWithParameterPatternMask[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF};
-static const UInt8 kSmu1107SendMessageWithParameterPattern14_4[] = {0x55, 0x48, 0x89, 0xE5, 0x41, 0x57, 0x41, 0x56,
-    0x41, 0x54, 0x53, 0x89, 0xD3, 0x41, 0x89, 0xF6, 0x49, 0x89, 0xFF, 0x8B, 0x8F, 0x00, 0x00, 0x00, 0x00};
-static const UInt8 kSmu1107SendMessageWithParameterPatternMask14_4[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF};
-
-static const UInt8 kCosReadConfigurationSettingPattern[] = {0x55, 0x48, 0x89, 0xE5, 0x41, 0x57, 0x41, 0x56, 0x41, 0x54,
-    0x53, 0x48, 0x85, 0xF6, 0x74, 0x00, 0x40, 0x89, 0xD0};
-static const UInt8 kCosReadConfigurationSettingPatternMask[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xF0, 0xFF, 0xF0};
+static constexpr auto kPspCmdKmSubmitPattern = BYTE_PATTERN("55 48 89 E5 41 57 41 56 41 55 41 54 53 50 49 89 CD 49 "
+    "89 D7 49 89 F4 48 89 FB 48 8D 75 D0 C7 06 00 00 00 00 E8 ?? ?? ?? ??");
+
+static constexpr auto kPspCmdKmSubmitPattern14_4 = BYTE_PATTERN("55 48 89 E5 41 57 41 56 41 55 41 54 53 48 83 EC 18 "
+    "49 89 CD 49 89 D7 49 89 F4 49 89 FE 48 8D 75 D0 C7 06 00 00 00 00 E8 ?? ?? ?? ??");
+
+static constexpr auto kSmu1107SendMessageWithParameterPattern = BYTE_PATTERN("55 48 89 E5 41 57 41 56 41 54 53 41 89 "
+    "D6 41 89 F7 48 89 FB 8B 8F ?? ?? 00 00 48 8D 35");
+static constexpr auto kSmu1107SendMessageWithParameterPattern14_4 = BYTE_PATTERN("55 48 89 E5 41 57 41 56 41 54 53 "
+    "89 D3 41 89 F6 49 89 FF 8B 8F ?? ?? 00 00");
+
+static constexpr auto kCosReadConfigurationSettingPattern =
+    BYTE_PATTERN("55 48 89 E5 41 57 41 56 41 54 53 48 85 F6 74 ?? 4? 89 D?");
 
 //------ Patches ------//
 
+// Redirect the `_memcpy` of a PSP firmware blob, told apart by its size, to a function that copies ours instead.
+// `lea rsi, [rel blob]; mov edx, size; mov rdi, ...; call _memcpy` -> `movabs rsi, func; mov rdi, ...; call rsi`.
+static constexpr auto kPspMemcpyCallOriginal =
+    BYTE_PATTERN("48 8D 35 ?? ?? ?? ?? BA ?? ?? ?? ?? 4C 89 ?? E8 ?? ?? ?? ??");
+static constexpr auto kPspMemcpyCallPatched =
+    BYTE_PATTERN("48 BE 00 00 00 00 00 00 00 00 90 66 ?? ?? ?? FF D6 90 66 90");
+// `lea rsi, [rel blob]; mov edx, size; call _memcpy` -> `movabs rsi, func; call rsi`.
+static constexpr auto kPspMemcpyCallOriginal2 = BYTE_PATTERN("48 8D 35 ?? ?? ?? ?? BA ?? ?? ?? ?? E8 ?? ?? ?? ?? 4?");
+static constexpr auto kPspMemcpyCallPatched2 = BYTE_PATTERN("48 BE 00 00 00 00 00 00 00 00 FF D6 90 66 90 90 66 ??");
+
 // Replace call in `_gc_sw_init` to `_gc_get_hw_version` with constant (0x0A0304).
-static const UInt8 kGcSwInitOriginal[] = {0x7B, 0x0C, 0xE8, 0x00, 0x00, 0x00, 0x00, 0x41, 0x89, 0xC7};
-static const UInt8 kGcSwInitOriginalMask[] = {0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF};
-static const UInt8 kGcSwInitPatched[] = {0x00, 0x00, 0xB8, 0x04, 0x03, 0x0A, 0x00, 0x00, 0x00, 0x00};
-static const UInt8 kGcSwInitPatchedMask[] = {0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00};
+static constexpr auto kGcSwInitOriginal = BYTE_PATTERN("7B 0C E8 ?? ?? ?? ?? 41 89 C7");
+static constexpr auto kGcSwInitPatched = BYTE_PATTERN("?? ?? B8 04 03 0A 00 ?? ?? ??");
 
 // Replace call in `_gc_set_fw_entry_info` to `_gc_get_hw_version` with constant (0x0A0304).
-static const UInt8 kGcSetFwEntryInfoOriginal[] = {0xE8, 0x00, 0x00, 0x00, 0x00, 0x31, 0x00, 0x41, 0x89, 0x00, 0x10,
-    0x41, 0x89, 0x00, 0x00, 0x00};
-static const UInt8 kGcSetFwEntryInfoOriginalMask[] = {0xFF, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x00, 0xFF, 0xFF, 0x00, 0xFF,
-    0xFF, 0xFF, 0x00, 0x00, 0x00};
-static const UInt8 kGcSetFwEntryInfoPatched[] = {0xB8, 0x04, 0x03, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00};
-static const UInt8 kGcSetFwEntryInfoPatchedMask[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00};
-static const UInt8 kGcSetFwEntryInfoOriginal14_4[] = {0xE8, 0x00, 0x00, 0x00, 0x00, 0x45, 0x31, 0xFF, 0x45, 0x89, 0x7E,
-    0x10};
-static const UInt8 kGcSetFwEntryInfoOriginalMask14_4[] = {0xFF, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF};
-static const UInt8 kGcSetFwEntryInfoPatched14_4[] = {0xB8, 0x04, 0x03, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00};
-static const UInt8 kGcSetFwEntryInfoPatchedMask14_4[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00};
+static constexpr auto kGcSetFwEntryInfoOriginal = BYTE_PATTERN("E8 ?? ?? ?? ?? 31 ?? 41 89 ?? 10 41 89 ?? ?? ??");
+static constexpr auto kGcSetFwEntryInfoPatched = BYTE_PATTERN("B8 04 03 0A 00 ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ??");
+static constexpr auto kGcSetFwEntryInfoOriginal14_4 = BYTE_PATTERN("E8 ?? ?? ?? ?? 45 31 FF 45 89 7E 10");
+static constexpr auto kGcSetFwEntryInfoPatched14_4 = BYTE_PATTERN("B8 04 03 0A 00 ?? ?? ?? ?? ?? ?? ??");
 
 // `_psp_sw_init`: Force `pIn->pspVerMinor == 0x5` path.
-static const UInt8 kPspSwInit1Original[] = {0x8B, 0x43, 0x10, 0x83, 0xF8, 0x05, 0x74, 0x00, 0x85, 0xC0};
-static const UInt8 kPspSwInit1OriginalMask[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0xFF};
-static const UInt8 kPspSwInit1Patched[] = {0x66, 0x90, 0x66, 0x90, 0x66, 0x90, 0xEB, 0x00, 0x00, 0x00};
-static const UInt8 kPspSwInit1PatchedMask[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00};
-static const UInt8 kPspSwInit1Original14_4[] = {0x41, 0x8B, 0x46, 0x0C, 0x83, 0xF8, 0x05, 0x74, 0x00, 0x85, 0xC0};
-static const UInt8 kPspSwInit1OriginalMask14_4[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0xFF};
-static const UInt8 kPspSwInit1Patched14_4[] = {0x66, 0x90, 0x66, 0x90, 0x66, 0x90, 0x90, 0xEB, 0x00, 0x00, 0x00};
-static const UInt8 kPspSwInit1PatchedMask14_4[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00};
+static constexpr auto kPspSwInit1Original = BYTE_PATTERN("8B 43 10 83 F8 05 74 ?? 85 C0");
+static constexpr auto kPspSwInit1Patched = BYTE_PATTERN("66 90 66 90 66 90 EB ?? ?? ??");
+static constexpr auto kPspSwInit1Original14_4 = BYTE_PATTERN("41 8B 46 0C 83 F8 05 74 ?? 85 C0");
+static constexpr auto kPspSwInit1Patched14_4 = BYTE_PATTERN("66 90 66 90 66 90 90 EB ?? ?? ??");
 
 // `_psp_sw_init`: Force `pIn->pspVerPatch == 0x0` path.
-static const UInt8 kPspSwInit2Original[] = {0x83, 0x7B, 0x14, 0x00, 0x74, 0x00, 0x41};
-static const UInt8 kPspSwInit2OriginalMask[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF};
-static const UInt8 kPspSwInit2Patched[] = {0x66, 0x90, 0x66, 0x90, 0xEB, 0x00, 0x00};
-static const UInt8 kPspSwInit2PatchedMask[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00};
-static const UInt8 kPspSwInit2Original14_4[] = {0x41, 0x83, 0x7E, 0x10, 0x00, 0x74, 0x00, 0xC7, 0x83};
-static const UInt8 kPspSwInit2OriginalMask14_4[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0xFF};
-static const UInt8 kPspSwInit2Patched14_4[] = {0x66, 0x90, 0x66, 0x90, 0x90, 0xEB, 0x00, 0x00, 0x00};
-static const UInt8 kPspSwInit2PatchedMask14_4[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00};
+static constexpr auto kPspSwInit2Original = BYTE_PATTERN("83 7B 14 00 74 ?? 41");
+static constexpr auto kPspSwInit2Patched = BYTE_PATTERN("66 90 66 90 EB ?? ??");
+static constexpr auto kPspSwInit2Original14_4 = BYTE_PATTERN("41 83 7E 10 00 74 ?? C7 83");
+static constexpr auto kPspSwInit2Patched14_4 = BYTE_PATTERN("66 90 66 90 90 EB ?? ?? ??");
 
 // `_psp_sw_init`: Set field `0x7???` to `0xE`.
-static const UInt8 kPspSwInit3Original[] = {0x41, 0xC7, 0x84, 0x24, 0x00, 0x70, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00};
-static const UInt8 kPspSwInit3OriginalMask[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xF0, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
-static const UInt8 kPspSwInit3Patched[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x00, 0x00, 0x00};
-static const UInt8 kPspSwInit3PatchedMask[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00};
-static const UInt8 kPspSwInit3Original14_4[] = {0xC7, 0x83, 0x94, 0x7D, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0xE9};
-static const UInt8 kPspSwInit3Patched14_4[] = {0xC7, 0x83, 0x94, 0x7D, 0x00, 0x00, 0x0E, 0x00, 0x00, 0x00, 0xE9};
+static constexpr auto kPspSwInit3Original = BYTE_PATTERN("41 C7 84 24 ?? 7? 00 00 10 00 00 00");
+static constexpr auto kPspSwInit3Patched = BYTE_PATTERN("?? ?? ?? ?? ?? ?? ?? ?? 0E ?? ?? ??");
+static constexpr auto kPspSwInit3Original14_4 = BYTE_PATTERN("C7 83 94 7D 00 00 10 00 00 00 E9");
+static constexpr auto kPspSwInit3Patched14_4 = BYTE_PATTERN("C7 83 94 7D 00 00 0E 00 00 00 E9");
 
 // Skip check for firmware version in `_smu_11_0_7_check_fw_version`.
-static const UInt8 kSmu1107CheckFwVersionOriginal[] = {0x83, 0xFE, 0x40, 0x75, 0x00, 0xEB, 0x00};
-static const UInt8 kSmu1107CheckFwVersionOriginalMask[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0x00};
-static const UInt8 kSmu1107CheckFwVersionPatched[] = {0x66, 0x90, 0x66, 0x90, 0x90, 0x00, 0x00};
-static const UInt8 kSmu1107CheckFwVersionPatchedMask[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00};
+static constexpr auto kSmu1107CheckFwVersionOriginal = BYTE_PATTERN("83 FE 40 75 ?? EB ??");
+static constexpr auto kSmu1107CheckFwVersionPatched = BYTE_PATTERN("66 90 66 90 90 ?? ??");
 
 // Ditto for 11.0, X6800.
-static const UInt8 kSmu1107CheckFwVersionNavi21Original[] = {0x83, 0xF9, 0x3E, 0x74, 0x00, 0xEB, 0x00};
-static const UInt8 kSmu1107CheckFwVersionNavi21OriginalMask[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0x00};
-static const UInt8 kSmu1107CheckFwVersionNavi21Patched[] = {0x90, 0x90, 0x90, 0xEB, 0x00, 0x00, 0x00};
-static const UInt8 kSmu1107CheckFwVersionNavi21PatchedMask[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00};
+static constexpr auto kSmu1107CheckFwVersionNavi21Original = BYTE_PATTERN("83 F9 3E 74 ?? EB ??");
+static constexpr auto kSmu1107CheckFwVersionNavi21Patched = BYTE_PATTERN("90 90 90 EB ?? ?? ??");
 
 // Ditto for 12.0+, X6800.
-static const UInt8 kSmu1107CheckFwVersionNavi21Original_12[] = {0x83, 0xF9, 0x40, 0x74, 0x00, 0xEB, 0x00};
-static const UInt8 kSmu1107CheckFwVersionNavi21OriginalMask_12[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0x00};
-static const UInt8 kSmu1107CheckFwVersionNavi21Patched_12[] = {0x90, 0x90, 0x90, 0xEB, 0x00, 0x00, 0x00};
-static const UInt8 kSmu1107CheckFwVersionNavi21PatchedMask_12[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00};
+static constexpr auto kSmu1107CheckFwVersionNavi21Original_12 = BYTE_PATTERN("83 F9 40 74 ?? EB ??");
+static constexpr auto kSmu1107CheckFwVersionNavi21Patched_12 = BYTE_PATTERN("90 90 90 EB ?? ?? ??");
 
 // Ventura cleaned up some code and removed support for SDMA 5.2.2, force 5.2.4 route.
-static const UInt8 kSdmaInitFunctionPointerOriginal[] = {0x00, 0x00, 0x00, 0x41, 0x83, 0xFE, 0x04, 0x75, 0x00};
-static const UInt8 kSdmaInitFunctionPointerOriginalMask[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
-static const UInt8 kSdmaInitFunctionPointerPatched[] = {0x00, 0x00, 0x00, 0x66, 0x90, 0x66, 0x90, 0x66, 0x90};
-static const UInt8 kSdmaInitFunctionPointerOriginal14_4[] = {0xB8, 0x02, 0x00, 0x00, 0x00, 0x83, 0xF9, 0x04, 0x75,
-    0x00};
-static const UInt8 kSdmaInitFunctionPointerOriginalMask14_4[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0x00};
-static const UInt8 kSdmaInitFunctionPointerPatched14_4[] = {0xB8, 0x02, 0x00, 0x00, 0x00, 0x66, 0x90, 0x66, 0x90, 0x90};
+static constexpr auto kSdmaInitFunctionPointerOriginal = BYTE_PATTERN("00 00 00 41 83 FE 04 75 ??");
+static constexpr auto kSdmaInitFunctionPointerPatched = BYTE_PATTERN("00 00 00 66 90 66 90 66 90");
+static constexpr auto kSdmaInitFunctionPointerOriginal14_4 = BYTE_PATTERN("B8 02 00 00 00 83 F9 04 75 ??");
+static constexpr auto kSdmaInitFunctionPointerPatched14_4 = BYTE_PATTERN("B8 02 00 00 00 66 90 66 90 90");
 
 // Enable all MCIL debug prints (debugLevel = 0xFFFFFFFF, mostly for PP_Log).
 static const UInt8 kAtiPowerPlayServicesConstructorOriginal[] = {0x8B, 0x40, 0x60, 0x48, 0x8D};
 static const UInt8 kAtiPowerPlayServicesConstructorPatched[] = {0x83, 0xC8, 0xFF, 0x48, 0x8D};
 
 // Enable printing of all PSP event logs
-static const UInt8 kAmdLogPspOriginal[] = {0x83, 0x00, 0x02, 0x0F, 0x85, 0x00, 0x00, 0x00, 0x00, 0x41, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x83, 0x00, 0x02, 0x72, 0x00, 0x41, 0x00, 0x00, 0x09, 0x02, 0x18, 0x00, 0x74, 0x00, 0x41, 0x00,
-    0x00, 0x01, 0x06, 0x10, 0x00, 0x0f, 0x85, 0x00, 0x00, 0x00, 0x00};
-static const UInt8 kAmdLogPspOriginalMask[] = {0xFF, 0x00, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0xFF, 0x00, 0xFF, 0xFF, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF,
-    0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00};
-static const UInt8 kAmdLogPspPatched[] = {0x66, 0x90, 0x66, 0x90, 0x66, 0x90, 0x66, 0x90, 0x66, 0x90, 0x66, 0x90, 0x66,
-    0x90, 0x66, 0x90, 0x66, 0x90, 0x66, 0x90, 0x66, 0x90, 0x66, 0x90, 0x66, 0x90, 0x66, 0x90, 0x66, 0x90, 0x66, 0x90,
-    0x66, 0x90, 0x66, 0x90, 0x66, 0x90, 0x66, 0x90, 0x66, 0x90, 0x90};
+static constexpr auto kAmdLogPspOriginal = BYTE_PATTERN("83 ?? 02 0F 85 ?? ?? ?? ?? 41 ?? ?? ?? ?? ?? ?? 83 ?? 02 72 "
+    "?? 41 ?? ?? 09 02 18 00 74 ?? 41 ?? ?? 01 06 10 00 0F 85 ?? ?? ?? ??");
+static constexpr auto kAmdLogPspPatched = BYTE_PATTERN("66 90 66 90 66 90 66 90 66 90 66 90 66 90 66 90 66 90 66 90 66 "
+    "90 66 90 66 90 66 90 66 90 66 90 66 90 66 90 66 90 66 90 66 90 90");
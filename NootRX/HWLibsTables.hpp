@@ -0,0 +1,132 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#pragma once
+#include "HWLibs.hpp"
+#include "NootRXAttributes.hpp"
+#include "PatcherPlus.hpp"
+
+// Kept apart from HWLibs.cpp so that the host tests can check them without the rest of the kext.
+
+extern KernelPatcher::KextInfo kextRadeonX6810HWLibs;
+extern KernelPatcher::KextInfo kextRadeonX6800HWLibs;
+
+// The lookup patches and the attribute combinations they apply to, chain predecessors are manifest indices.
+static constexpr LookupPatchEntry hwLibsPatches[] = {
+    {NootRXAttributes::Navi21 | NootRXAttributes::BigSur, NootRXAttributes::Navi21 | NootRXAttributes::BigSur,
+        {&kextRadeonX6800HWLibs, kSmu1107CheckFwVersionNavi21Original, kSmu1107CheckFwVersionNavi21Patched, 1}},
+    {NootRXAttributes::Navi21 | NootRXAttributes::BigSur, NootRXAttributes::Navi21,
+        {&kextRadeonX6800HWLibs, kSmu1107CheckFwVersionNavi21Original_12, kSmu1107CheckFwVersionNavi21Patched_12, 1}},
+    {NootRXAttributes::Navi21, 0,
+        {&kextRadeonX6810HWLibs, kSmu1107CheckFwVersionOriginal, kSmu1107CheckFwVersionPatched, 1}},
+    {NootRXAttributes::Navi22, NootRXAttributes::Navi22,
+        {&kextRadeonX6810HWLibs, kGcSwInitOriginal, kGcSwInitPatched, 1}},
+    {NootRXAttributes::Navi22 | NootRXAttributes::Sonoma1404AndLater,
+        NootRXAttributes::Navi22 | NootRXAttributes::Sonoma1404AndLater,
+        {&kextRadeonX6810HWLibs, kGcSetFwEntryInfoOriginal14_4, kGcSetFwEntryInfoPatched14_4, 1}},
+    {NootRXAttributes::Navi22 | NootRXAttributes::Sonoma1404AndLater,
+        NootRXAttributes::Navi22 | NootRXAttributes::Sonoma1404AndLater,
+        {&kextRadeonX6810HWLibs, kPspSwInit1Original14_4, kPspSwInit1Patched14_4, 1}},
+    {NootRXAttributes::Navi22 | NootRXAttributes::Sonoma1404AndLater,
+        NootRXAttributes::Navi22 | NootRXAttributes::Sonoma1404AndLater,
+        LookupPatchPlus {&kextRadeonX6810HWLibs, kPspSwInit2Original14_4, kPspSwInit2Patched14_4, 1}.near(5, 0x1000)},
+    {NootRXAttributes::Navi22 | NootRXAttributes::Sonoma1404AndLater,
+        NootRXAttributes::Navi22 | NootRXAttributes::Sonoma1404AndLater,
+        LookupPatchPlus {&kextRadeonX6810HWLibs, kPspSwInit3Original14_4, kPspSwInit3Patched14_4, 1}.near(6, 0x1000)},
+    {NootRXAttributes::Navi22 | NootRXAttributes::Sonoma1404AndLater,
+        NootRXAttributes::Navi22 | NootRXAttributes::Sonoma1404AndLater,
+        {&kextRadeonX6810HWLibs, kSdmaInitFunctionPointerOriginal14_4, kSdmaInitFunctionPointerPatched14_4, 1}},
+    {NootRXAttributes::Navi22 | NootRXAttributes::Sonoma1404AndLater, NootRXAttributes::Navi22,
+        {&kextRadeonX6810HWLibs, kGcSetFwEntryInfoOriginal, kGcSetFwEntryInfoPatched, 1}},
+    {NootRXAttributes::Navi22 | NootRXAttributes::Sonoma1404AndLater, NootRXAttributes::Navi22,
+        {&kextRadeonX6810HWLibs, kPspSwInit1Original, kPspSwInit1Patched, 1}},
+    {NootRXAttributes::Navi22 | NootRXAttributes::Sonoma1404AndLater, NootRXAttributes::Navi22,
+        LookupPatchPlus {&kextRadeonX6810HWLibs, kPspSwInit2Original, kPspSwInit2Patched, 1}.near(10, 0x1000)},
+    {NootRXAttributes::Navi22 | NootRXAttributes::Sonoma1404AndLater, NootRXAttributes::Navi22,
+        LookupPatchPlus {&kextRadeonX6810HWLibs, kPspSwInit3Original, kPspSwInit3Patched, 1}.near(11, 0x1000)},
+    {NootRXAttributes::Navi22 | NootRXAttributes::VenturaAndLater | NootRXAttributes::Sonoma1404AndLater,
+        NootRXAttributes::Navi22 | NootRXAttributes::VenturaAndLater,
+        {&kextRadeonX6810HWLibs, kSdmaInitFunctionPointerOriginal, kSdmaInitFunctionPointerPatched, 1}},
+};
+
+// Every supported OS family for every Navi, Navi 22 and 23 need macOS 12 or newer.
+static constexpr UInt8 hwLibsPlanKeys[] = {
+    NootRXAttributes::BigSur | NootRXAttributes::Navi21,
+    NootRXAttributes::Navi21,
+    NootRXAttributes::Navi22,
+    NootRXAttributes::Navi23,
+    NootRXAttributes::VenturaAndLater | NootRXAttributes::Navi21,
+    NootRXAttributes::VenturaAndLater | NootRXAttributes::Navi22,
+    NootRXAttributes::VenturaAndLater | NootRXAttributes::Navi23,
+    NootRXAttributes::VenturaAndLater | NootRXAttributes::Sonoma1404AndLater | NootRXAttributes::Navi21,
+    NootRXAttributes::VenturaAndLater | NootRXAttributes::Sonoma1404AndLater | NootRXAttributes::Navi22,
+    NootRXAttributes::VenturaAndLater | NootRXAttributes::Sonoma1404AndLater | NootRXAttributes::Navi23,
+};
+
+static constexpr auto hwLibsPatchPlans = compileLookupPatchPlans(hwLibsPatches, hwLibsPlanKeys);
+
+struct PSPApplicationFirmware {
+    const char *application;
+    FWName firmware;
+};
+
+static constexpr PSPApplicationFirmware pspApplicationFirmware[] = {
+    {"AMD DTM Application", "psp_dtm.bin"},
+    {"AMD RAP Application", "psp_rap.bin"},
+    {"AMD HDCP Application", "psp_hdcp.bin"},
+    {"AMD AUC Application", "psp_auc.bin"},
+    {"AMD FP Application", "psp_fp.bin"},
+};
+static_assert(arrsize(pspApplicationFirmware) == PSPApplicationCount, "Update PSPApplicationCount");
+
+struct IPFirmware {
+    AMDUCodeID id;
+    FWName navi21, navi22, navi23;
+};
+
+#define GC_FIRMWARE(id, name) {id, "gc_10_3_" name, "gc_10_3_2_" name, "gc_10_3_4_" name}
+
+// Firmware loaded through `kPSPCommandLoadIPFW`, the row for the current Navi is resolved once in `processKext`.
+static constexpr IPFirmware ipFirmwareNames[] = {
+    {kUCodeSMU, "navi21_smc_firmware.bin", "navi22_smc_firmware.bin", "navi23_smc_firmware.bin"},
+    GC_FIRMWARE(kUCodeCE, "ce_ucode.bin"),
+    GC_FIRMWARE(kUCodePFP, "pfp_ucode.bin"),
+    GC_FIRMWARE(kUCodeME, "me_ucode.bin"),
+    GC_FIRMWARE(kUCodeMEC1, "mec_ucode.bin"),
+    GC_FIRMWARE(kUCodeMEC2, "mec_ucode.bin"),
+    GC_FIRMWARE(kUCodeMEC1JT, "mec_jt_ucode.bin"),
+    GC_FIRMWARE(kUCodeMEC2JT, "mec_jt_ucode.bin"),
+    // {kUCodeMES, "mes_10_3_mes0_ucode.bin", "mes_10_3_mes0_ucode.bin", "mes_10_3_mes0_ucode.bin"},
+    // {kUCodeMESStack, "mes_10_3_mes0_data.bin", "mes_10_3_mes0_data.bin", "mes_10_3_mes0_data.bin"},
+    GC_FIRMWARE(kUCodeRLC, "rlc_ucode.bin"),
+    {kUCodeSDMA0, "sdma_5_2_ucode.bin", "sdma_5_2_2_ucode.bin", "sdma_5_2_4_ucode.bin"},
+    {kUCodeVCN0, "ativvaxy_vcn3.dat", "ativvaxy_vcn3.dat", "ativvaxy_vcn3.dat"},
+    {kUCodeVCN1, "ativvaxy_vcn3.dat", "ativvaxy_vcn3.dat", "ativvaxy_vcn3.dat"},
+    GC_FIRMWARE(kUCodeRLCP, "rlcp_ucode.bin"),
+    GC_FIRMWARE(kUCodeRLCSRListGPM, "rlc_srlist_gpm_mem.bin"),
+    GC_FIRMWARE(kUCodeRLCSRListSRM, "rlc_srlist_srm_mem.bin"),
+    GC_FIRMWARE(kUCodeRLCSRListCntl, "rlc_srlist_cntl.bin"),
+    GC_FIRMWARE(kUCodeRLCLX6Iram, "rlc_lx6_iram_ucode.bin"),
+    GC_FIRMWARE(kUCodeRLCLX6Dram, "rlc_lx6_dram_ucode.bin"),
+    GC_FIRMWARE(kUCodeGlobalTapDelays, "global_tap_delays.bin"),
+    GC_FIRMWARE(kUCodeSE0TapDelays, "se0_tap_delays.bin"),
+    GC_FIRMWARE(kUCodeSE1TapDelays, "se1_tap_delays.bin"),
+    // Navi 22 and 23 only have two shader engines.
+    {kUCodeSE2TapDelays, "gc_10_3_se2_tap_delays.bin", {}, {}},
+    {kUCodeSE3TapDelays, "gc_10_3_se3_tap_delays.bin", {}, {}},
+    {kUCodeDMCUB, "atidmcub_instruction_dcn30.bin", "atidmcub_instruction_dcn30.bin",
+        "atidmcub_instruction_dcn302.bin"},
+};
+
+#undef GC_FIRMWARE
+
+// Points each ucode ID at the blob that `HWLibs::wrapPspCmdKmSubmit` loads for it on this Navi, ucodes without one
+// are left to the original function.
+inline void resolveIPFirmware(NootRXAttributes attributes, const FWMetadata *(&ipFirmware)[kUCodeVCN1 + 1]) {
+    for (const auto &entry : ipFirmwareNames) {
+        const auto &name = attributes.isNavi21() ? entry.navi21 :
+                           attributes.isNavi22() ? entry.navi22 :
+                                                   entry.navi23;
+        ipFirmware[entry.id] = name.name ? &getFWByName(name) : nullptr;
+    }
+}
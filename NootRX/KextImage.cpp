@@ -0,0 +1,317 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "KextImage.hpp"
+#include <Headers/kern_mach.hpp>
+#include <IOKit/IOLib.h>
+#include <mach-o/nlist.h>
+
+static KextImage currentImage {};
+static KextImage::MappedCheck mappedCheck {nullptr};
+
+static bool nameEquals(const char (&name)[16], const char *expected) { return !strncmp(name, expected, 16); }
+
+// LC_FUNCTION_STARTS is a list of ULEB128 deltas, the first one being relative to the start of __TEXT.
+// Returns the number of entries, only writing them out if `out` is set.
+static size_t readFunctionStarts(const UInt8 *data, size_t size, UInt64 limit, UInt32 *out) {
+    size_t count = 0;
+    UInt64 address = 0;
+    for (size_t i = 0; i < size;) {
+        UInt64 delta = 0;
+        UInt32 shift = 0;
+        UInt8 byte;
+        do {
+            if (i == size || shift > 56) { return count; }
+            byte = data[i++];
+            delta |= static_cast<UInt64>(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+
+        if (delta == 0) { break; }
+        address += delta;
+        if (address >= limit) { break; }
+        if (out) { out[count] = static_cast<UInt32>(address); }
+        count += 1;
+    }
+    return count;
+}
+
+// The first 8 bytes of a name, zero padded, to rule out most symbols without comparing names.
+static UInt64 getNamePrefix(const char *name, size_t maxLength) {
+    UInt64 prefix = 0;
+    if (maxLength < sizeof(prefix)) {
+        for (size_t i = 0; i < maxLength && name[i]; i++) {
+            prefix |= static_cast<UInt64>(static_cast<UInt8>(name[i])) << (i * 8);
+        }
+        return prefix;
+    }
+    memcpy(&prefix, name, sizeof(prefix));
+    // Whatever follows the terminator belongs to the next name.
+    auto zeros = (prefix - 0x0101010101010101ULL) & ~prefix & 0x8080808080808080ULL;
+    if (zeros) {
+        auto length = static_cast<UInt32>(__builtin_ctzll(zeros)) / 8;
+        prefix = length ? prefix & ((1ULL << (length * 8)) - 1) : 0;
+    }
+    return prefix;
+}
+
+static UInt64 getPrefixFilterBit(UInt64 prefix) { return 1ULL << ((prefix * 0x9E3779B97F4A7C15ULL) >> 58); }
+
+void KextImage::setMappedCheck(MappedCheck check) { mappedCheck = check; }
+
+const KextImage &KextImage::get(mach_vm_address_t address, size_t size) {
+    if (currentImage.address != address || currentImage.size != size) {
+        if (!currentImage.parse(address, size)) {
+            DBGLOG("KextImage", "Failed to parse image at 0x%llX, falling back to full scans", address);
+        }
+    }
+    return currentImage;
+}
+
+KextImage::~KextImage() {
+    if (this->functionStarts) { IOFree(this->functionStarts, this->functionStartCount * sizeof(UInt32)); }
+}
+
+void KextImage::reset() {
+    if (this->functionStarts) { IOFree(this->functionStarts, this->functionStartCount * sizeof(UInt32)); }
+    this->functionStarts = nullptr;
+    *this = {};
+}
+
+bool KextImage::parse(mach_vm_address_t address, size_t size) {
+    this->reset();
+    this->address = address;
+    this->size = size;
+
+    if (!address || size < sizeof(mach_header_64)) { return false; }
+    auto *header = reinterpret_cast<const mach_header_64 *>(address);
+    if (header->magic != MH_MAGIC_64 || header->sizeofcmds > size - sizeof(mach_header_64)) { return false; }
+
+    auto *commands = reinterpret_cast<const UInt8 *>(header + 1);
+    bool hasBase = false;
+    LinkeditSegment linkedit {};
+    const linkedit_data_command *functionStartsCommand = nullptr;
+    const symtab_command *symtabCommand = nullptr;
+
+    // __TEXT maps the header, so it gives the address every other segment is relative to. Kexts in a kernel
+    // collection keep their file offsets within the collection, so only a standalone kext has it at file offset 0.
+    for (UInt32 pass = 0; pass < 2; pass++) {
+        size_t cursor = 0;
+        for (UInt32 i = 0; i < header->ncmds; i++) {
+            if (cursor + sizeof(load_command) > header->sizeofcmds) { return false; }
+            auto *command = reinterpret_cast<const load_command *>(commands + cursor);
+            if (command->cmdsize < sizeof(load_command) || command->cmdsize > header->sizeofcmds - cursor) {
+                return false;
+            }
+            cursor += command->cmdsize;
+            if (command->cmd == LC_UUID && command->cmdsize >= sizeof(uuid_command)) {
+                memcpy(this->uuid, reinterpret_cast<const uuid_command *>(command)->uuid, sizeof(this->uuid));
+                this->hasUUID = true;
+                continue;
+            }
+            if (command->cmd == LC_FUNCTION_STARTS && command->cmdsize >= sizeof(linkedit_data_command)) {
+                functionStartsCommand = reinterpret_cast<const linkedit_data_command *>(command);
+                continue;
+            }
+            if (command->cmd == LC_SYMTAB && command->cmdsize >= sizeof(symtab_command)) {
+                symtabCommand = reinterpret_cast<const symtab_command *>(command);
+                continue;
+            }
+            if (command->cmd != LC_SEGMENT_64 || command->cmdsize < sizeof(segment_command_64)) { continue; }
+
+            auto *segment = reinterpret_cast<const segment_command_64 *>(command);
+            if (pass == 0) {
+                if (nameEquals(segment->segname, "__TEXT")) {
+                    this->baseAddress = segment->vmaddr;
+                    this->inCollection = segment->fileoff != 0;
+                    hasBase = true;
+                    break;
+                }
+                // Without __TEXT, the segment at the start of the file is the one mapping the header.
+                if (!hasBase && segment->fileoff == 0 && segment->filesize != 0) {
+                    this->baseAddress = segment->vmaddr;
+                    hasBase = true;
+                }
+                continue;
+            }
+
+            if (nameEquals(segment->segname, "__LINKEDIT")) {
+                linkedit = {segment->vmaddr, segment->vmsize, segment->fileoff, segment->filesize};
+            } else if (nameEquals(segment->segname, "__DATA")) {
+                this->translate(segment->vmaddr, segment->vmsize, this->data);
+            } else if (nameEquals(segment->segname, "__DATA_CONST")) {
+                this->translate(segment->vmaddr, segment->vmsize, this->dataConst);
+            }
+
+            if (segment->nsects > (command->cmdsize - sizeof(segment_command_64)) / sizeof(section_64)) { continue; }
+            auto *sections = reinterpret_cast<const section_64 *>(segment + 1);
+            for (UInt32 j = 0; j < segment->nsects; j++) {
+                auto &section = sections[j];
+                if (nameEquals(section.segname, "__TEXT")) {
+                    if (nameEquals(section.sectname, "__text")) {
+                        this->translate(section.addr, section.size, this->code);
+                    } else if (nameEquals(section.sectname, "__cstring")) {
+                        this->translate(section.addr, section.size, this->cstring);
+                    } else if (nameEquals(section.sectname, "__const")) {
+                        this->translate(section.addr, section.size, this->textConst);
+                    }
+                } else if (nameEquals(section.segname, "__TEXT_EXEC") && nameEquals(section.sectname, "__text")) {
+                    this->translate(section.addr, section.size, this->textExecCode);
+                }
+            }
+        }
+        if (!hasBase) { return false; }
+    }
+
+    if (functionStartsCommand && linkedit.vmaddr) {
+        this->decodeFunctionStarts(linkedit, functionStartsCommand->dataoff, functionStartsCommand->datasize);
+    }
+    if (symtabCommand && linkedit.vmaddr) {
+        this->mapSymbols(linkedit, symtabCommand->symoff, symtabCommand->nsyms, symtabCommand->stroff,
+            symtabCommand->strsize);
+    }
+
+    this->valid = true;
+    DBGLOG("KextImage", "0x%llX: code 0x%zX+0x%zX data 0x%zX+0x%zX const 0x%zX+0x%zX%s", address, this->code.offset,
+        this->code.size + this->textExecCode.size, this->data.offset, this->data.size, this->dataConst.offset,
+        this->dataConst.size, this->inCollection ? " in a kernel collection" : "");
+    return true;
+}
+
+// A standalone kext's __LINKEDIT is only trusted if it's inside the image, it isn't always kept next to the rest.
+// Kexts in a kernel collection all share the collection's __LINKEDIT, which lies outside of any of them and is only
+// used while the mapped check says it's there.
+const UInt8 *KextImage::mapLinkedit(const LinkeditSegment &linkedit, UInt32 dataOffset, UInt32 dataSize) const {
+    if (dataOffset < linkedit.fileoff || dataOffset - linkedit.fileoff > linkedit.filesize ||
+        dataSize > linkedit.filesize - (dataOffset - linkedit.fileoff) ||
+        dataOffset - linkedit.fileoff + dataSize > linkedit.vmsize) {
+        return nullptr;
+    }
+    // Offset from the load address, wrapping around when __LINKEDIT lies below the kext.
+    auto offset = linkedit.vmaddr + (dataOffset - linkedit.fileoff) - this->baseAddress;
+    auto *data = reinterpret_cast<const UInt8 *>(this->address + offset);
+    if (this->isInImage(data, dataSize)) { return data; }
+    if (!this->inCollection || !mappedCheck || !mappedCheck(reinterpret_cast<mach_vm_address_t>(data), dataSize)) {
+        return nullptr;
+    }
+    return data;
+}
+
+bool KextImage::isInImage(const void *data, size_t size) const {
+    auto offset = reinterpret_cast<mach_vm_address_t>(data) - this->address;
+    return offset < this->size && size <= this->size - offset;
+}
+
+// Checked again on every use, a collection's __LINKEDIT may have been jettisoned since the image was parsed.
+bool KextImage::hasSymbols() const {
+    if (!this->symbols) { return false; }
+    auto symbolsSize = this->symbolCount * sizeof(nlist_64);
+    if (this->isInImage(this->symbols, symbolsSize) && this->isInImage(this->strings, this->stringSize)) {
+        return true;
+    }
+    return mappedCheck && mappedCheck(reinterpret_cast<mach_vm_address_t>(this->symbols), symbolsSize) &&
+           mappedCheck(reinterpret_cast<mach_vm_address_t>(this->strings), this->stringSize);
+}
+
+void KextImage::decodeFunctionStarts(const LinkeditSegment &linkedit, UInt32 dataOffset, UInt32 dataSize) {
+    auto *data = this->mapLinkedit(linkedit, dataOffset, dataSize);
+    if (!data) { return; }
+
+    auto count = readFunctionStarts(data, dataSize, this->size, nullptr);
+    if (!count) { return; }
+    this->functionStarts = static_cast<UInt32 *>(IOMalloc(count * sizeof(UInt32)));
+    if (!this->functionStarts) { return; }
+    this->functionStartCount = readFunctionStarts(data, dataSize, this->size, this->functionStarts);
+    DBGLOG("KextImage", "0x%llX: %zu function starts", this->address, this->functionStartCount);
+}
+
+void KextImage::mapSymbols(const LinkeditSegment &linkedit, UInt32 symbolOffset, UInt32 symbolCount,
+    UInt32 stringOffset, UInt32 stringSize) {
+    if (!symbolCount || symbolCount > UINT32_MAX / sizeof(nlist_64)) { return; }
+    auto *symbols = this->mapLinkedit(linkedit, symbolOffset, static_cast<UInt32>(symbolCount * sizeof(nlist_64)));
+    auto *strings = this->mapLinkedit(linkedit, stringOffset, stringSize);
+    if (!symbols || !strings || reinterpret_cast<uintptr_t>(symbols) % alignof(nlist_64)) { return; }
+    this->symbols = reinterpret_cast<const nlist_64 *>(symbols);
+    this->symbolCount = symbolCount;
+    this->strings = reinterpret_cast<const char *>(strings);
+    this->stringSize = stringSize;
+    DBGLOG("KextImage", "0x%llX: %u symbols", this->address, symbolCount);
+}
+
+size_t KextImage::solveSymbols(const char *const *names, size_t count, size_t *offsets) const {
+    static constexpr size_t MaxNames = 16;
+    PANIC_COND(count > MaxNames, "KextImage", "Too many symbols at once");
+    UInt64 prefixes[MaxNames];
+    UInt64 filter = 0;
+    for (size_t i = 0; i < count; i++) {
+        offsets[i] = 0;
+        prefixes[i] = getNamePrefix(names[i], strnlen(names[i], sizeof(UInt64)));
+        filter |= getPrefixFilterBit(prefixes[i]);
+    }
+    if (!this->hasSymbols()) { return 0; }
+
+    size_t found = 0;
+    for (size_t i = 0; i < this->symbolCount && found < count; i++) {
+        auto &symbol = this->symbols[i];
+        // Only symbols defined in a section have an address, nothing is routed to the header.
+        if ((symbol.n_type & N_STAB) || (symbol.n_type & N_TYPE) != N_SECT || symbol.n_value <= this->baseAddress ||
+            symbol.n_value - this->baseAddress >= this->size || symbol.n_un.n_strx >= this->stringSize) {
+            continue;
+        }
+        auto *name = this->strings + symbol.n_un.n_strx;
+        auto maxLength = this->stringSize - symbol.n_un.n_strx;
+        auto prefix = getNamePrefix(name, maxLength);
+        if (!(filter & getPrefixFilterBit(prefix))) { continue; }
+        for (size_t j = 0; j < count; j++) {
+            if (offsets[j] || prefixes[j] != prefix || strncmp(name, names[j], maxLength) ||
+                strnlen(name, maxLength) == maxLength) {
+                continue;
+            }
+            offsets[j] = static_cast<size_t>(symbol.n_value - this->baseAddress);
+            found += 1;
+        }
+    }
+    return found;
+}
+
+bool KextImage::translate(UInt64 vmaddr, UInt64 vmsize, ScanRange &range) const {
+    if (vmaddr < this->baseAddress || vmaddr - this->baseAddress >= this->size) { return false; }
+    range.offset = static_cast<size_t>(vmaddr - this->baseAddress);
+    auto available = this->size - range.offset;
+    range.size = vmsize > available ? available : static_cast<size_t>(vmsize);
+    return true;
+}
+
+size_t KextImage::getRanges(PatternSection section, ScanRange *ranges) const {
+    size_t count = 0;
+    auto add = [&](const ScanRange &range) {
+        if (!range.size) { return; }
+        // Keep the list sorted so the first match across ranges is also the lowest one.
+        auto i = count;
+        for (; i > 0 && ranges[i - 1].offset > range.offset; i--) { ranges[i] = ranges[i - 1]; }
+        ranges[i] = range;
+        count += 1;
+    };
+
+    if (this->valid) {
+        switch (section) {
+            case PatternSection::Code:
+                add(this->code);
+                add(this->textExecCode);
+                break;
+            case PatternSection::Data:
+                add(this->textConst);
+                add(this->dataConst);
+                add(this->data);
+                break;
+            case PatternSection::CString:
+                add(this->cstring);
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (!count && (section == PatternSection::Any || !this->valid)) { add({0, this->size}); }
+    return count;
+}
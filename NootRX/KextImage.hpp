@@ -0,0 +1,91 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#pragma once
+#include <Headers/kern_util.hpp>
+
+struct nlist_64;
+
+// Which part of a kext a pattern is expected to live in.
+enum class PatternSection : UInt8 {
+    Any,
+    Code,       // __TEXT,__text and __TEXT_EXEC,__text
+    Data,       // __DATA, __DATA_CONST and __TEXT,__const
+    CString,    // __TEXT,__cstring
+};
+
+struct ScanRange {
+    size_t offset {0}, size {0};
+};
+
+// Section layout of a loaded kext, read from its Mach-O load commands.
+// Offsets are relative to the kext load address and clamped to the loaded image.
+class KextImage {
+    public:
+    static constexpr size_t MaxRanges = 4;
+
+    // Tells whether `size` bytes at `address` are backed by memory.
+    using MappedCheck = bool (*)(mach_vm_address_t address, size_t size);
+
+    ~KextImage();
+
+    // Parses the image on first use and keeps it around until a different kext is asked for.
+    static const KextImage &get(mach_vm_address_t address, size_t size);
+
+    // A kernel collection's __LINKEDIT lies outside of its kexts and can be jettisoned after boot, it is only read
+    // while `check` says it is mapped. Without a check it is never read.
+    static void setMappedCheck(MappedCheck check);
+
+    bool parse(mach_vm_address_t address, size_t size);
+
+    // Fills `ranges` in ascending order, the whole image is returned for `Any` or if parsing failed.
+    size_t getRanges(PatternSection section, ScanRange *ranges) const;
+
+    // Offsets of every function listed in LC_FUNCTION_STARTS, ascending. Empty if the table is not mapped.
+    inline const UInt32 *getFunctionStarts() const { return this->functionStarts; }
+    inline size_t getFunctionStartCount() const { return this->functionStartCount; }
+
+    // Finds every name in a single walk of LC_SYMTAB, `offsets[i]` is 0 for names the kext doesn't define.
+    size_t solveSymbols(const char *const *names, size_t count, size_t *offsets) const;
+    // Without LC_SYMTAB in the image, or with a shared one that is no longer mapped, symbols have to be solved through
+    // Lilu.
+    bool hasSymbols() const;
+
+    // LC_UUID of the kext, identifies the exact build.
+    inline const UInt8 *getUUID() const { return this->hasUUID ? this->uuid : nullptr; }
+
+    inline bool isValid() const { return this->valid; }
+    inline mach_vm_address_t getAddress() const { return this->address; }
+    inline size_t getSize() const { return this->size; }
+
+    // Whether the kext is part of a kernel collection rather than linked on its own.
+    inline bool isInCollection() const { return this->inCollection; }
+
+    private:
+    struct LinkeditSegment {
+        UInt64 vmaddr {0}, vmsize {0}, fileoff {0}, filesize {0};
+    };
+
+    bool translate(UInt64 vmaddr, UInt64 vmsize, ScanRange &range) const;
+    void decodeFunctionStarts(const LinkeditSegment &linkedit, UInt32 dataOffset, UInt32 dataSize);
+    const UInt8 *mapLinkedit(const LinkeditSegment &linkedit, UInt32 dataOffset, UInt32 dataSize) const;
+    bool isInImage(const void *data, size_t size) const;
+    void mapSymbols(const LinkeditSegment &linkedit, UInt32 symbolOffset, UInt32 symbolCount, UInt32 stringOffset,
+        UInt32 stringSize);
+    void reset();
+
+    mach_vm_address_t address {0};
+    size_t size {0};
+    bool valid {false};
+    UInt64 baseAddress {0};    // vmaddr of __TEXT, which is where the image is loaded
+    bool inCollection {false};
+    ScanRange code {}, textExecCode {}, cstring {}, textConst {}, data {}, dataConst {};
+    UInt8 uuid[16] {};
+    bool hasUUID {false};
+    UInt32 *functionStarts {nullptr};
+    size_t functionStartCount {0};
+    const nlist_64 *symbols {nullptr};
+    size_t symbolCount {0};
+    const char *strings {nullptr};
+    size_t stringSize {0};
+};
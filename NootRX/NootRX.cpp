@@ -4,6 +4,7 @@
 #include "NootRX.hpp"
 #include "Firmware.hpp"
 #include "Model.hpp"
+#include "OffsetCache.hpp"
 #include "PatcherPlus.hpp"
 #include <Headers/kern_api.hpp>
 #include <Headers/kern_devinfo.hpp>
@@ -21,6 +22,23 @@ static KernelPatcher::KextInfo kextAGDP {
     KernelPatcher::KextInfo::Unloaded,
 };
 
+static NVRAMOffsetCacheStorage offsetCacheStorage {};
+
+// Both come with the unsupported KPI.
+extern "C" {
+extern pmap_t kernel_pmap;
+ppnum_t pmap_find_phys(pmap_t pmap, addr64_t va);
+}
+
+// Memory that was jettisoned has no physical page behind it any more.
+static bool isKernelMemoryMapped(mach_vm_address_t address, size_t size) {
+    if (address + size < address) { return false; }
+    for (auto page = address & ~static_cast<mach_vm_address_t>(PAGE_MASK); page < address + size; page += PAGE_SIZE) {
+        if (!pmap_find_phys(kernel_pmap, page)) { return false; }
+    }
+    return true;
+}
+
 NootRXMain *NootRXMain::callback = nullptr;
 
 void NootRXMain::init() {
@@ -56,6 +74,10 @@ void NootRXMain::init() {
 
     callback = this;
 
+    KextImage::setMappedCheck(isKernelMemoryMapped);
+    // Learnt offsets go to NVRAM, which is small and shared with the firmware, so that is opt-in.
+    if (checkKernelArgument("-NRXOffsetCache")) { OffsetCache::get().setStorage(&offsetCacheStorage); }
+
     lilu.onKextLoadForce(&kextAGDP);
 
     this->dyldpatches.init();
@@ -278,10 +300,13 @@ void NootRXMain::ensureRMMIO() {
 
 void NootRXMain::processKext(KernelPatcher &patcher, size_t id, mach_vm_address_t slide, size_t size) {
     if (kextAGDP.loadIndex == id) {
+        OffsetCache::get().setKext("AGDP");
+
         // Don't apply AGDP patch on MacPro7,1
         if (strncmp("Mac-27AD2F918AE68F61", BaseDeviceInfo::get().boardIdentifier, 21) == 0) { return; }
 
-        const LookupPatchPlus patch {&kextAGDP, kAGDPBoardIDKeyOriginal, kAGDPBoardIDKeyPatched, 1};
+        const LookupPatchPlus patch {&kextAGDP, kAGDPBoardIDKeyOriginal, kAGDPBoardIDKeyPatched, 1, 0,
+            PatternSection::CString};
         PANIC_COND(!patch.apply(patcher, slide, size), "NootRX", "Failed to apply AGDP patch");
 
         DBGLOG("NootRX", "Processed Apple Graphics Device Policy");
@@ -292,6 +317,8 @@ void NootRXMain::processKext(KernelPatcher &patcher, size_t id, mach_vm_address_
     } else if (this->x6000.processKext(patcher, id, slide, size)) {
         DBGLOG("NootRX", "Processed Accelerator");
     }
+
+    OffsetCache::get().flush();
 }
 
 UInt32 NootRXMain::readReg32(UInt32 reg) {
@@ -311,15 +338,3 @@ void NootRXMain::writeReg32(UInt32 reg, UInt32 val) {
         this->rmmioPtr[mmPCIE_DATA2] = val;
     }
 }
-
-const char *NootRXMain::getGCPrefix() {
-    if (this->attributes.isNavi21()) {
-        return "gc_10_3_";
-    } else if (this->attributes.isNavi22()) {
-        return "gc_10_3_2_";
-    } else if (this->attributes.isNavi23()) {
-        return "gc_10_3_4_";
-    } else {
-        UNREACHABLE();
-    }
-}
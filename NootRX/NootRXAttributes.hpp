@@ -0,0 +1,32 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#pragma once
+#include <Headers/kern_util.hpp>
+
+class NootRXAttributes {
+    UInt8 value {0};
+
+    public:
+    static constexpr UInt8 BigSur = (1U << 0);
+    static constexpr UInt8 VenturaAndLater = (1U << 1);
+    static constexpr UInt8 Sonoma1404AndLater = (1U << 2);
+    static constexpr UInt8 Navi21 = (1U << 3);
+    static constexpr UInt8 Navi22 = (1U << 4);
+    static constexpr UInt8 Navi23 = (1U << 5);
+
+    inline UInt8 getValue() { return this->value; }
+    inline bool isBigSur() { return (this->value & BigSur) != 0; }
+    inline bool isVenturaAndLater() { return (this->value & VenturaAndLater) != 0; }
+    inline bool isSonoma1404AndLater() { return (this->value & Sonoma1404AndLater) != 0; }
+    inline bool isNavi21() { return (this->value & Navi21) != 0; }
+    inline bool isNavi22() { return (this->value & Navi22) != 0; }
+    inline bool isNavi23() { return (this->value & Navi23) != 0; }
+
+    inline void setBigSur() { this->value |= BigSur; }
+    inline void setVenturaAndLater() { this->value |= VenturaAndLater; }
+    inline void setSonoma1404AndLater() { this->value |= Sonoma1404AndLater; }
+    inline void setNavi21() { this->value |= Navi21; }
+    inline void setNavi22() { this->value |= Navi22; }
+    inline void setNavi23() { this->value |= Navi23; }
+};
@@ -0,0 +1,248 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "OffsetCache.hpp"
+#include "PatternSearch.hpp"
+
+static OffsetCache offsetCache {};
+
+static constexpr UInt64 FNVOffsetBasis = 0xCBF29CE484222325;
+static constexpr UInt64 FNVPrime = 0x100000001B3;
+
+static UInt64 hashBytes(UInt64 hash, const void *data, size_t size) {
+    auto *bytes = static_cast<const UInt8 *>(data);
+    for (size_t i = 0; i < size; i++) { hash = (hash ^ bytes[i]) * FNVPrime; }
+    return hash;
+}
+
+bool NVRAMOffsetCacheStorage::ensureReady() {
+    if (!this->ready && !this->failed) {
+        this->ready = this->nvram.init();
+        this->failed = !this->ready;
+        DBGLOG_COND(this->failed, "OffsetCache", "NVRAM is not available");
+    }
+    return this->ready;
+}
+
+UInt32 NVRAMOffsetCacheStorage::read(const char *name, UInt8 *buffer, UInt32 capacity) {
+    if (!this->ensureReady()) { return 0; }
+
+    UInt32 size = 0;
+    auto *data = this->nvram.read(name, size, NVStorage::OptChecksum);
+    if (!data) { return 0; }
+    if (size > capacity) { size = 0; }
+    memcpy(buffer, data, size);
+    Buffer::deleter(data);
+    return size;
+}
+
+bool NVRAMOffsetCacheStorage::write(const char *name, const UInt8 *buffer, UInt32 size) {
+    return this->ensureReady() && this->nvram.write(name, buffer, size, NVStorage::OptChecksum);
+}
+
+OffsetCache &OffsetCache::get() { return offsetCache; }
+
+// Only the bits the mask keeps count, so patterns that match the same bytes hash the same.
+static UInt64 hashPatternBytes(UInt64 hash, const UInt8 *pattern, const UInt8 *mask, size_t size) {
+    hash = hashBytes(hash, &size, sizeof(size));
+    for (size_t i = 0; i < size; i++) {
+        UInt8 byteMask = mask ? mask[i] : 0xFF;
+        UInt8 bytes[] = {static_cast<UInt8>(pattern[i] & byteMask), byteMask};
+        hash = hashBytes(hash, bytes, sizeof(bytes));
+    }
+    return hash;
+}
+
+UInt64 OffsetCache::hashPattern(const UInt8 *pattern, const UInt8 *mask, size_t size) {
+    return hashPatternBytes(FNVOffsetBasis, pattern, mask, size);
+}
+
+UInt64 OffsetCache::getEntryHash() const {
+    return hashBytes(FNVOffsetBasis, this->entries, this->count * sizeof(OffsetCacheEntry));
+}
+
+bool OffsetCache::wasWritten() const {
+    auto records = this->writeCount < MaxWrittenRecords ? this->writeCount : MaxWrittenRecords;
+    for (size_t i = 0; i < records; i++) {
+        if (!memcmp(this->written[i], this->uuid, sizeof(this->uuid))) { return true; }
+    }
+    return false;
+}
+
+bool OffsetCache::hasStorage() const { return this->storage && this->kext; }
+
+void OffsetCache::getRecordName(char (&name)[MaxRecordName]) const {
+    // The UUID is in the record, not its name, so updating macOS replaces the record rather than leaving it behind.
+    snprintf(name, sizeof(name), NVRAM_PREFIX(LILU_VENDOR_GUID, "nrx-oc-%s"), this->kext);
+}
+
+void OffsetCache::setKext(const char *name) {
+    if (this->kext == name) { return; }
+    this->flush();
+    this->kext = name;
+    this->selected = false;
+}
+
+bool OffsetCache::select(const KextImage &image) {
+    auto *uuid = image.getUUID();
+    if (!uuid) { return false; }
+    if (this->selected && !memcmp(this->uuid, uuid, sizeof(this->uuid))) { return true; }
+
+    this->flush();
+    memcpy(this->uuid, uuid, sizeof(this->uuid));
+    this->selected = true;
+    this->dirty = this->loaded = false;
+    this->loadedSetHash = this->loadedEntryHash = 0;
+    this->setHash = FNVOffsetBasis;
+    this->count = 0;
+    memset(this->used, 0, sizeof(this->used));
+
+    this->build = nullptr;
+    for (size_t i = 0; i < offsetDBCount; i++) {
+        if (!memcmp(offsetDB[i].uuid, uuid, sizeof(offsetDB[i].uuid))) {
+            this->build = &offsetDB[i];
+            DBGLOG("OffsetCache", "Build is in the offset database with %zu offsets", this->build->count);
+            break;
+        }
+    }
+    if (!this->hasStorage()) { return true; }
+
+    char name[MaxRecordName];
+    this->getRecordName(name);
+    UInt8 buffer[sizeof(OffsetCacheHeader) + sizeof(this->entries)];
+    auto size = this->storage->read(name, buffer, sizeof(buffer));
+    if (size < sizeof(OffsetCacheHeader)) { return true; }
+
+    OffsetCacheHeader header;
+    memcpy(&header, buffer, sizeof(header));
+    if (header.magic != OffsetCacheHeader::Magic || header.version != OffsetCacheHeader::Version ||
+        header.count > MaxEntries || size != sizeof(header) + header.count * sizeof(OffsetCacheEntry) ||
+        memcmp(header.uuid, this->uuid, sizeof(this->uuid))) {
+        DBGLOG("OffsetCache", "Discarding invalid record %s", name);
+        return true;
+    }
+    memcpy(this->entries, buffer + sizeof(header), header.count * sizeof(OffsetCacheEntry));
+    this->count = header.count;
+    if (this->getEntryHash() != header.entryHash) {
+        DBGLOG("OffsetCache", "Discarding corrupted record %s", name);
+        this->count = 0;
+        return true;
+    }
+
+    this->loaded = true;
+    this->loadedSetHash = header.setHash;
+    this->loadedEntryHash = header.entryHash;
+    DBGLOG("OffsetCache", "Loaded %zu offsets from %s", this->count, name);
+    return true;
+}
+
+bool OffsetCache::verify(const KextImage &image, UInt32 cachedOffset, const UInt8 *pattern, const UInt8 *mask,
+    size_t size, size_t *offset) const {
+    if (cachedOffset >= image.getSize() || size > image.getSize() - cachedOffset ||
+        !patternMatchesAt(reinterpret_cast<const UInt8 *>(image.getAddress()) + cachedOffset, pattern, mask, size)) {
+        DBGLOG("OffsetCache", "Stale offset 0x%X", cachedOffset);
+        return false;
+    }
+    *offset = cachedOffset;
+    return true;
+}
+
+bool OffsetCache::lookup(const KextImage &image, UInt64 hash, const UInt8 *pattern, const UInt8 *mask, size_t size,
+    size_t *offset) {
+    if (!this->select(image)) { return false; }
+    this->setHash = hashPatternBytes(this->setHash, pattern, mask, size);
+
+    if (this->build) {
+        size_t low = 0, high = this->build->count;
+        while (low < high) {
+            auto mid = (low + high) / 2;
+            auto &entry = this->build->entries[mid];
+            if (entry.patternHash == hash) {
+                if (this->verify(image, entry.offset, pattern, mask, size, offset)) { return true; }
+                break;
+            }
+            if (entry.patternHash < hash) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < this->count; i++) {
+        auto &entry = this->entries[i];
+        if (entry.hash != hash) { continue; }
+        this->used[i] = true;
+        return this->verify(image, entry.offset, pattern, mask, size, offset);
+    }
+    return false;
+}
+
+void OffsetCache::record(const KextImage &image, UInt64 hash, size_t offset) {
+    if (!this->hasStorage() || !this->select(image) || offset > 0xFFFFFFFF) { return; }
+
+    for (size_t i = 0; i < this->count; i++) {
+        auto &entry = this->entries[i];
+        if (entry.hash != hash) { continue; }
+        this->used[i] = true;
+        if (entry.offset != offset) {
+            entry.offset = static_cast<UInt32>(offset);
+            this->dirty = true;
+        }
+        return;
+    }
+
+    if (this->count == MaxEntries) { return; }
+    this->used[this->count] = true;
+    this->entries[this->count++] = {hash, static_cast<UInt32>(offset)};
+    this->dirty = true;
+}
+
+void OffsetCache::flush() {
+    if (!this->selected || !this->hasStorage()) { return; }
+    // A record made while looking for other patterns is rewritten, even if nothing new was found, to drop what's stale.
+    bool changedSet = this->loaded && this->setHash != this->loadedSetHash;
+    if (!this->dirty && !changedSet) { return; }
+    this->dirty = false;
+
+    // Offsets of patterns that weren't looked for this time belong to an older NootRX.
+    size_t count = 0;
+    for (size_t i = 0; i < this->count; i++) {
+        if (this->used[i]) {
+            this->used[count] = true;
+            this->entries[count++] = this->entries[i];
+        }
+    }
+    this->count = count;
+
+    auto entryHash = this->getEntryHash();
+    bool unchanged = this->loaded && this->setHash == this->loadedSetHash && entryHash == this->loadedEntryHash;
+    this->loaded = true;
+    this->loadedSetHash = this->setHash;
+    this->loadedEntryHash = entryHash;
+    if (unchanged) { return; }
+    if (this->wasWritten()) {
+        DBGLOG("OffsetCache", "Record was already written during this boot");
+        return;
+    }
+
+    OffsetCacheHeader header {OffsetCacheHeader::Magic, OffsetCacheHeader::Version, static_cast<UInt16>(this->count),
+        {}, this->setHash, entryHash};
+    memcpy(header.uuid, this->uuid, sizeof(header.uuid));
+
+    UInt8 buffer[sizeof(OffsetCacheHeader) + sizeof(this->entries)];
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), this->entries, this->count * sizeof(OffsetCacheEntry));
+
+    char name[MaxRecordName];
+    this->getRecordName(name);
+    auto size = static_cast<UInt32>(sizeof(header) + this->count * sizeof(OffsetCacheEntry));
+    // Even a failed write counts, retrying on every kext would only wear the storage out faster.
+    memcpy(this->written[this->writeCount % MaxWrittenRecords], this->uuid, sizeof(this->uuid));
+    this->writeCount += 1;
+    if (this->storage->write(name, buffer, size)) {
+        DBGLOG("OffsetCache", "Stored %zu offsets in %s", this->count, name);
+    } else {
+        DBGLOG("OffsetCache", "Failed to store %s", name);
+    }
+}
@@ -0,0 +1,94 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#pragma once
+#include "KextImage.hpp"
+#include "OffsetDB.hpp"
+#include <Headers/kern_nvram.hpp>
+
+// Where offset cache records are kept between boots.
+class OffsetCacheStorage {
+    public:
+    // Copies the record called `name` into `buffer`, returns its length or 0 if there's none.
+    virtual UInt32 read(const char *name, UInt8 *buffer, UInt32 capacity) = 0;
+    virtual bool write(const char *name, const UInt8 *buffer, UInt32 size) = 0;
+};
+
+class NVRAMOffsetCacheStorage : public OffsetCacheStorage {
+    public:
+    UInt32 read(const char *name, UInt8 *buffer, UInt32 capacity) override;
+    bool write(const char *name, const UInt8 *buffer, UInt32 size) override;
+
+    private:
+    bool ensureReady();
+
+    NVStorage nvram {};
+    bool ready {false}, failed {false};
+};
+
+struct OffsetCacheHeader {
+    static constexpr UInt32 Magic = 0x4F58524E;    // 'NRXO'
+    static constexpr UInt16 Version = 2;
+
+    UInt32 magic;
+    UInt16 version;
+    UInt16 count;
+    UInt8 uuid[16];
+    UInt64 setHash;      // Hash of the bytes and masks of every pattern looked up in the kext, in order
+    UInt64 entryHash;    // Hash of the entries following the header
+} PACKED;
+
+struct OffsetCacheEntry {
+    UInt64 hash;
+    UInt32 offset;
+} PACKED;
+
+// Remembers where patterns were found in a specific kext build, keyed by its LC_UUID.
+// Builds listed in the generated offset database are known ahead of time, anything else is learnt at runtime.
+// Cached offsets are only handed out after the pattern still matches there, so a stale record costs one compare.
+// Every kext has one record under a fixed name, which a new build of it overwrites instead of adding another.
+// A record is only written when its contents change, that is when a build is first seen or when NootRX looks for a
+// different set of patterns in it, and at most once per build and boot.
+class OffsetCache {
+    public:
+    static constexpr size_t MaxEntries = 64;
+    static constexpr size_t MaxWrittenRecords = 8;
+    static constexpr size_t MaxRecordName = 96;
+
+    static OffsetCache &get();
+    static UInt64 hashPattern(const UInt8 *pattern, const UInt8 *mask, size_t size);
+
+    inline void setStorage(OffsetCacheStorage *storage) { this->storage = storage; }
+    // Names the record of the kext looked into next, after writing back the previous one.
+    void setKext(const char *name);
+
+    bool lookup(const KextImage &image, UInt64 hash, const UInt8 *pattern, const UInt8 *mask, size_t size,
+        size_t *offset);
+    void record(const KextImage &image, UInt64 hash, size_t offset);
+
+    // Writes the current record back if anything new was found or the pattern set changed.
+    void flush();
+
+    inline size_t getWriteCount() const { return this->writeCount; }
+
+    private:
+    bool select(const KextImage &image);
+    bool verify(const KextImage &image, UInt32 cachedOffset, const UInt8 *pattern, const UInt8 *mask, size_t size,
+        size_t *offset) const;
+    bool hasStorage() const;
+    void getRecordName(char (&name)[MaxRecordName]) const;
+    UInt64 getEntryHash() const;
+    bool wasWritten() const;
+
+    OffsetCacheStorage *storage {nullptr};
+    const char *kext {nullptr};
+    UInt8 uuid[16] {};
+    bool selected {false}, dirty {false}, loaded {false};
+    const OffsetDBBuild *build {nullptr};
+    UInt64 loadedSetHash {0}, loadedEntryHash {0}, setHash {0};
+    size_t count {0};
+    OffsetCacheEntry entries[MaxEntries] {};
+    bool used[MaxEntries] {};
+    UInt8 written[MaxWrittenRecords][16] {};
+    size_t writeCount {0};
+};
@@ -0,0 +1,8 @@
+// Generated by Scripts/GenerateOffsetDB.py, do not edit.
+
+#include "OffsetDB.hpp"
+
+const OffsetDBBuild offsetDB[] = {
+    {},
+};
+const size_t offsetDBCount = 0;
@@ -0,0 +1,25 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#pragma once
+#include <Headers/kern_util.hpp>
+
+// Pattern offsets of known kext builds, see Scripts/GenerateOffsetDB.py.
+// The tree ships without entries, the script has to be run against the kext binaries of each macOS build first.
+// It covers the patterns declared in the kext headers and the call site patterns `CallSiteRedirect` assembles
+// from the tables in HWLibs.cpp, and lists every other pattern of a build as not covered. Patterns it doesn't
+// know about, or that don't match exactly once in a build, are left for OffsetCache to learn on the first boot.
+struct OffsetDBEntry {
+    UInt64 patternHash;
+    UInt32 offset;
+};
+
+struct OffsetDBBuild {
+    UInt8 uuid[16];
+    const OffsetDBEntry *entries;    // Sorted by `patternHash`
+    size_t count;
+};
+
+// Terminated by an empty entry, so the table is never zero-sized.
+extern const OffsetDBBuild offsetDB[];
+extern const size_t offsetDBCount;
@@ -2,93 +2,730 @@
 // See LICENSE for details.
 
 #include "PatcherPlus.hpp"
+#include "OffsetCache.hpp"
+#include "PatternSearch.hpp"
+#include <IOKit/IOLib.h>
+
+struct PatternQuery {
+    const UInt8 *pattern {nullptr}, *mask {nullptr};
+    size_t size {0};
+    PatternSection section {PatternSection::Any};
+    bool probeFunctionStarts {false};
+    const PatternSkipTable *skipTable {nullptr};
+    size_t offset {0};
+    // No match starts in [checkedFrom, offset), whatever comes before still has to be checked for one.
+    size_t checkedFrom {0};
+    bool found {false};
+    // Patches have to land on the first match in the image, solves and routes prefer their hinted section.
+    bool firstInImage {false};
+    // Index of an earlier query this one is searched right after, only used when `maxDistance` is set.
+    size_t predecessor {0}, maxDistance {0};
+    bool chainPending {false};
+};
+
+static PatternSearchMetrics lastMetrics {};
+
+const PatternSearchMetrics &PatternSearchMetrics::getLast() { return lastMetrics; }
+
+static void startMetrics() { lastMetrics = {}; }
+
+static const PatternSection hintedSections[] = {PatternSection::Code, PatternSection::Data, PatternSection::CString};
+
+// Patterns starting with a complete `push rbp; mov rbp, rsp` can only match at the start of a function.
+static bool findAtFunctionStart(const KextImage &image, PatternQuery &query) {
+    static const UInt8 prologue[] = {0x55, 0x48, 0x89, 0xE5};
+    if (query.size < arrsize(prologue)) { return false; }
+    for (size_t i = 0; i < arrsize(prologue); i++) {
+        if (query.pattern[i] != prologue[i] || (query.mask && query.mask[i] != 0xFF)) { return false; }
+    }
+
+    auto *data = reinterpret_cast<const UInt8 *>(image.getAddress());
+    auto *starts = image.getFunctionStarts();
+    for (size_t i = 0; i < image.getFunctionStartCount(); i++) {
+        if (query.size > image.getSize() - starts[i]) { break; }
+        if (patternMatchesAt(data + starts[i], query.pattern, query.mask, query.size)) {
+            query.offset = starts[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+// Bytes a search that stopped at the first match, if there was one, has looked at.
+static size_t getSearchedBytes(bool found, size_t offset, size_t patternSize, size_t size) {
+    return found && offset + patternSize < size ? offset + patternSize : size;
+}
+
+// Scans one range for every query that is still missing and either belongs to `section` or, when `fallback` is set,
+// to any section.
+static void scanQueries(PatternQuery *queries, size_t count, PatternSection section, bool fallback,
+    const UInt8 *data, const ScanRange &range) {
+    MultiPatternScanner scanner {};
+    size_t pending[MultiPatternScanner::MaxPatterns];
+    for (size_t i = 0; i < count; i++) {
+        auto &query = queries[i];
+        if (query.found || query.chainPending || (!fallback && query.section != section)) { continue; }
+        pending[scanner.getCount()] = i;
+        scanner.add(query.pattern, query.mask, query.size);
+    }
+    if (!scanner.getCount()) { return; }
+
+    // A lone pattern is better off with the anchored single pattern search.
+    bool single = scanner.getCount() == 1;
+    bool all = !single && scanner.scan(data + range.offset, range.size) == scanner.getCount();
+    size_t searched = 0;
+    for (size_t i = 0; i < scanner.getCount(); i++) {
+        auto &query = queries[pending[i]];
+        size_t offset = 0;
+        if (single) {
+            MaskedPatternSearch search {query.pattern, query.mask, query.size, query.skipTable};
+            bool found = search.find(data + range.offset, range.size, &offset);
+            searched = getSearchedBytes(found, offset, query.size, range.size);
+            if (!found) { continue; }
+        } else if (!scanner.getOffset(i, &offset)) {
+            continue;
+        } else if (all) {
+            auto end = getSearchedBytes(true, offset, query.size, range.size);
+            if (end > searched) { searched = end; }
+        }
+        if (fallback && query.section != PatternSection::Any) {
+            DBGLOG("Patcher+", "Pattern found outside of its section at 0x%zX", range.offset + offset);
+        }
+        query.offset = range.offset + offset;
+        query.checkedFrom = range.offset;
+        query.found = true;
+        if (range.offset == 0 && fallback) {
+            lastMetrics.fullScans += 1;
+        } else {
+            lastMetrics.sections += 1;
+        }
+    }
+    // The scanner only stops early once it found every pattern.
+    lastMetrics.bytesSearched += single || all ? searched : range.size;
+}
+
+// Bytes a scan of `section` reads before it gets to `end`, what a chained hit ending there saves is measured against.
+static size_t getScanSizeUpTo(const KextImage &image, PatternSection section, size_t end) {
+    ScanRange ranges[KextImage::MaxRanges];
+    auto rangeCount = image.isValid() && section != PatternSection::Any ? image.getRanges(section, ranges) : 0;
+    if (!rangeCount) { return end; }
+    size_t size = 0;
+    for (size_t i = 0; i < rangeCount && ranges[i].offset < end; i++) {
+        auto rangeEnd = end - ranges[i].offset;
+        size += rangeEnd < ranges[i].size ? rangeEnd : ranges[i].size;
+    }
+    return size;
+}
+
+// Searches the window following the predecessor's hit for every chained query whose predecessor has been found.
+// Chains still waiting on their predecessor are kept for later unless this is the last chance. A chain that misses
+// its window, or never gets to search it, joins the usual scans as a query for the first match in the image.
+static void findChained(PatternQuery *queries, size_t count, const KextImage &image, const UInt8 *data, size_t maxSize,
+    bool last) {
+    for (size_t i = 0; i < count; i++) {
+        auto &query = queries[i];
+        if (!query.chainPending) { continue; }
+        auto &predecessor = queries[query.predecessor];
+        if (!predecessor.found) {
+            query.chainPending = !last;
+            query.firstInImage = last;
+            continue;
+        }
+        query.chainPending = false;
+
+        auto start = predecessor.offset;
+        size_t window = 0, offset = 0;
+        bool found = false;
+        if (start < maxSize) {
+            window = query.maxDistance + query.size;
+            if (window > maxSize - start) { window = maxSize - start; }
+            MaskedPatternSearch search {query.pattern, query.mask, query.size, query.skipTable};
+            found = search.find(data + start, window, &offset);
+        }
+        auto searched = getSearchedBytes(found, offset, query.size, window);
+        lastMetrics.bytesSearched += searched;
+        if (!found) {
+            DBGLOG("Patcher+", "Pattern not within 0x%zX bytes after 0x%zX", query.maxDistance, start);
+            query.firstInImage = true;
+            continue;
+        }
+        query.offset = start + offset;
+        query.found = true;
+        lastMetrics.chained += 1;
+        auto scanned = getScanSizeUpTo(image, query.section, query.offset + query.size);
+        if (scanned > searched) { lastMetrics.bytesSaved += scanned - searched; }
+    }
+}
+
+// Moves every patch hit that wasn't found by a search from the start of the image to the first match in the image,
+// which is where `KernelPatcher::findPattern` would have found it. They all share one scan of what wasn't searched.
+static void findEarlierMatches(PatternQuery *queries, size_t count, const UInt8 *data, size_t maxSize) {
+    MultiPatternScanner scanner {};
+    size_t pending[MultiPatternScanner::MaxPatterns];
+    size_t end = 0;
+    for (size_t i = 0; i < count; i++) {
+        auto &query = queries[i];
+        if (!query.firstInImage || !query.found || !query.checkedFrom) { continue; }
+        pending[scanner.getCount()] = i;
+        scanner.add(query.pattern, query.mask, query.size);
+        // A match starting right before `checkedFrom` ends inside the part that was already searched.
+        auto queryEnd = query.checkedFrom + query.size - 1;
+        if (queryEnd > end) { end = queryEnd; }
+    }
+    if (!scanner.getCount()) { return; }
+    if (end > maxSize) { end = maxSize; }
+
+    bool single = scanner.getCount() == 1;
+    bool all = !single && scanner.scan(data, end) == scanner.getCount();
+    size_t searched = 0;
+    for (size_t i = 0; i < scanner.getCount(); i++) {
+        auto &query = queries[pending[i]];
+        size_t offset = 0;
+        if (single) {
+            MaskedPatternSearch search {query.pattern, query.mask, query.size, query.skipTable};
+            bool found = search.find(data, end, &offset);
+            searched = getSearchedBytes(found, offset, query.size, end);
+            if (!found) { continue; }
+        } else if (!scanner.getOffset(i, &offset)) {
+            continue;
+        } else if (all) {
+            auto queryEnd = getSearchedBytes(true, offset, query.size, end);
+            if (queryEnd > searched) { searched = queryEnd; }
+        }
+        query.checkedFrom = 0;
+        if (offset >= query.offset) { continue; }
+        DBGLOG("Patcher+", "Pattern found at 0x%zX matches earlier at 0x%zX", query.offset, offset);
+        query.offset = offset;
+        lastMetrics.earlier += 1;
+    }
+    lastMetrics.bytesSearched += single || all ? searched : end;
+}
+
+// Resolves up to `MultiPatternScanner::MaxPatterns` queries.
+// Cached offsets are tried first, then function starts for prologue patterns, then each hinted section is scanned
+// once for its queries and whatever is left over gets a single scan of the whole image.
+// Chained queries are searched right after their predecessor as soon as it is found and only join the scans on a miss.
+// For `firstInImage` queries, whichever way they were found, the offset is that of the first match in the image.
+static void findPatterns(PatternQuery *queries, size_t count, mach_vm_address_t address, size_t maxSize) {
+    auto *data = reinterpret_cast<const UInt8 *>(address);
+    auto &image = KextImage::get(address, maxSize);
+    auto &cache = OffsetCache::get();
+
+    UInt64 hashes[MultiPatternScanner::MaxPatterns];
+    bool cached[MultiPatternScanner::MaxPatterns];
+    size_t missing = 0;
+    for (size_t i = 0; i < count; i++) {
+        auto &query = queries[i];
+        hashes[i] = OffsetCache::hashPattern(query.pattern, query.mask, query.size);
+        // Only what the query resolved to last time is recorded, the first match or the chained hit.
+        cached[i] = cache.lookup(image, hashes[i], query.pattern, query.mask, query.size, &query.offset);
+        query.checkedFrom = 0;
+        if (cached[i]) {
+            query.found = true;
+            lastMetrics.cached += 1;
+        } else if (query.probeFunctionStarts && findAtFunctionStart(image, query)) {
+            query.found = true;
+            query.checkedFrom = query.offset;
+            lastMetrics.functionStarts += 1;
+        } else {
+            query.found = false;
+        }
+        query.chainPending = !query.found && query.maxDistance && query.predecessor < i;
+        if (!query.found) { missing += 1; }
+    }
+    lastMetrics.patterns += count;
+
+    if (missing) {
+        findChained(queries, count, image, data, maxSize, false);
+        if (image.isValid()) {
+            ScanRange ranges[KextImage::MaxRanges];
+            for (auto section : hintedSections) {
+                auto rangeCount = image.getRanges(section, ranges);
+                for (size_t i = 0; i < rangeCount; i++) {
+                    scanQueries(queries, count, section, false, data, ranges[i]);
+                }
+            }
+        }
+        findChained(queries, count, image, data, maxSize, false);
+        scanQueries(queries, count, PatternSection::Any, true, data, {0, maxSize});
+        findChained(queries, count, image, data, maxSize, true);
+        scanQueries(queries, count, PatternSection::Any, true, data, {0, maxSize});
+    }
+    findEarlierMatches(queries, count, data, maxSize);
+
+    for (size_t i = 0; i < count; i++) {
+        if (!queries[i].found) {
+            lastMetrics.missing += 1;
+        } else if (!cached[i]) {
+            cache.record(image, hashes[i], queries[i].offset);
+        }
+    }
+}
+
+// Solves up to `MultiPatternScanner::MaxPatterns` symbols with a single walk of the kext's symbol table.
+// Lilu, which walks its copy once per symbol, is only asked when the table isn't part of the image.
+static void solveSymbols(KernelPatcher &patcher, size_t id, const KextImage &image, const char *const *symbols,
+    size_t count, mach_vm_address_t *addresses) {
+    if (image.hasSymbols()) {
+        size_t offsets[MultiPatternScanner::MaxPatterns];
+        image.solveSymbols(symbols, count, offsets);
+        for (size_t i = 0; i < count; i++) { addresses[i] = offsets[i] ? image.getAddress() + offsets[i] : 0; }
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        addresses[i] = patcher.solveSymbol(id, symbols[i]);
+        if (!addresses[i]) { patcher.clearError(); }
+    }
+}
 
 bool SolveRequestPlus::solve(KernelPatcher &patcher, size_t id, mach_vm_address_t address, size_t maxSize) {
     PANIC_COND(!this->address, "Patcher+", "this->address is null");
+    startMetrics();
 
-    *this->address = patcher.solveSymbol(id, this->symbol);
+    solveSymbols(patcher, id, KextImage::get(address, maxSize), &this->symbol, 1, this->address);
     if (*this->address) { return true; }
-    patcher.clearError();
 
     if (!this->pattern || !this->patternSize) {
         DBGLOG("Patcher+", "Failed to solve %s using symbol", safeString(this->symbol));
         return false;
     }
 
-    size_t offset = 0;
-    if (!KernelPatcher::findPattern(this->pattern, this->mask, this->patternSize,
-            reinterpret_cast<const void *>(address), maxSize, &offset) ||
-        !offset) {
+    PatternQuery query {this->pattern, this->mask, this->patternSize, this->section, false, this->skipTable};
+    findPatterns(&query, 1, address, maxSize);
+    if (!query.found || !query.offset) {
         DBGLOG("Patcher+", "Failed to solve %s using pattern", safeString(this->symbol));
         return false;
     }
 
-    *this->address = address + offset;
+    *this->address = address + query.offset;
     return true;
 }
 
 bool SolveRequestPlus::solveAll(KernelPatcher &patcher, size_t id, SolveRequestPlus *requests, size_t count,
     mach_vm_address_t address, size_t maxSize) {
-    for (size_t i = 0; i < count; i++) {
-        if (!requests[i].solve(patcher, id, address, maxSize)) { return false; }
+    startMetrics();
+    auto &image = KextImage::get(address, maxSize);
+    for (size_t base = 0; base < count; base += MultiPatternScanner::MaxPatterns) {
+        auto chunk = count - base;
+        if (chunk > MultiPatternScanner::MaxPatterns) { chunk = MultiPatternScanner::MaxPatterns; }
+        const char *symbols[MultiPatternScanner::MaxPatterns];
+        mach_vm_address_t addresses[MultiPatternScanner::MaxPatterns];
+        for (size_t i = 0; i < chunk; i++) {
+            PANIC_COND(!requests[base + i].address, "Patcher+", "requests[%zu].address is null", base + i);
+            symbols[i] = requests[base + i].symbol;
+        }
+        solveSymbols(patcher, id, image, symbols, chunk, addresses);
+
+        PatternQuery queries[MultiPatternScanner::MaxPatterns];
+        size_t pending[MultiPatternScanner::MaxPatterns];
+        size_t pendingCount = 0;
+        for (size_t i = base; i < base + chunk; i++) {
+            auto &request = requests[i];
+            *request.address = addresses[i - base];
+            if (*request.address) { continue; }
+
+            if (!request.pattern || !request.patternSize) {
+                DBGLOG("Patcher+", "Failed to solve %s using symbol", safeString(request.symbol));
+                return false;
+            }
+            queries[pendingCount] = {request.pattern, request.mask, request.patternSize, request.section, false,
+                request.skipTable};
+            pending[pendingCount++] = i;
+        }
+
+        if (!pendingCount) { continue; }
+        findPatterns(queries, pendingCount, address, maxSize);
+        for (size_t i = 0; i < pendingCount; i++) {
+            auto &request = requests[pending[i]];
+            auto offset = queries[i].offset;
+            if (!queries[i].found || !offset) {
+                DBGLOG("Patcher+", "Failed to solve %s using pattern", safeString(request.symbol));
+                return false;
+            }
+            *request.address = address + offset;
+        }
     }
     return true;
 }
 
-bool RouteRequestPlus::route(KernelPatcher &patcher, size_t id, mach_vm_address_t address, size_t maxSize) {
-    if (patcher.routeMultiple(id, this, 1, address, maxSize)) { return true; }
-    patcher.clearError();
+static kern_return_t setKernelWriting(bool enable) {
+    return MachInfo::setKernelWriting(enable, KernelPatcher::kernelWriteLock);
+}
 
-    if (!this->pattern || !this->patternSize) {
-        DBGLOG("Patcher+", "Failed to route %s using symbol", safeString(this->symbol));
+PatchSession::PatchSession(WritingHook setWriting) : setWriting {setWriting ? setWriting : ::setKernelWriting} {}
+
+void PatchSession::fail(const char *reason) {
+    if (this->failed) { return; }
+    DBGLOG("Patcher+", "Patch session failed: %s", reason);
+    this->failed = true;
+}
+
+UInt8 *PatchSession::reserve(void *dest, size_t size) {
+    if (this->failed) { return nullptr; }
+    if (!dest || !size) {
+        this->fail("empty edit");
+        return nullptr;
+    }
+    // A batch that outgrows the session is a bug in NootRX, not something to find out about at commit time.
+    PANIC_COND(this->editCount == MaxEdits, "Patcher+", "More than %zu edits staged", MaxEdits);
+    auto *start = static_cast<UInt8 *>(dest);
+    for (size_t i = 0; i < this->editCount; i++) {
+        auto &edit = this->edits[i];
+        if (start < edit.dest + edit.size && edit.dest < start + size) {
+            this->fail("overlapping edits");
+            return nullptr;
+        }
+    }
+
+    if (this->dataSize + size * 2 > this->dataCapacity) {
+        auto capacity = this->dataCapacity ? this->dataCapacity : 0x100;
+        while (this->dataSize + size * 2 > capacity) { capacity *= 2; }
+        auto *data = static_cast<UInt8 *>(IOMalloc(capacity));
+        if (!data) {
+            this->fail("out of memory");
+            return nullptr;
+        }
+        if (this->data) {
+            memcpy(data, this->data, this->dataSize);
+            IOFree(this->data, this->dataCapacity);
+        }
+        this->data = data;
+        this->dataCapacity = capacity;
+    }
+
+    this->edits[this->editCount++] = {start, size, this->dataSize};
+    auto *ret = this->data + this->dataSize;
+    memcpy(ret + size, dest, size);
+    this->dataSize += size * 2;
+    return ret;
+}
+
+bool PatchSession::write(void *dest, const void *value, size_t size, const UInt8 *mask) {
+    auto *data = this->reserve(dest, size);
+    if (!data) { return false; }
+    auto *bytes = static_cast<const UInt8 *>(value);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = mask ? (data[size + i] & ~mask[i]) | (bytes[i] & mask[i]) : bytes[i];
+    }
+    return true;
+}
+
+bool PatchSession::fill(void *dest, UInt8 value, size_t size) {
+    auto *data = this->reserve(dest, size);
+    if (!data) { return false; }
+    memset(data, value, size);
+    return true;
+}
+
+bool PatchSession::route(mach_vm_address_t from, mach_vm_address_t to, mach_vm_address_t *org) {
+    if (this->failed) { return false; }
+    if (!from || !to) {
+        this->fail("empty route");
         return false;
     }
+    PANIC_COND(this->routeCount == MaxRoutes, "Patcher+", "More than %zu routes staged", MaxRoutes);
+    this->routes[this->routeCount++] = {from, to, org};
+    return true;
+}
 
-    size_t offset = 0;
-    if (!KernelPatcher::findPattern(this->pattern, this->mask, this->patternSize,
-            reinterpret_cast<const void *>(address), maxSize, &offset) ||
-        !offset) {
-        DBGLOG("Patcher+", "Failed to route %s using pattern", safeString(this->symbol));
+bool PatchSession::writeEdits(bool original) {
+    if (!this->editCount) { return true; }
+    if (this->setWriting(true) != KERN_SUCCESS) {
+        DBGLOG("Patcher+", "Failed to enable kernel writing");
         return false;
     }
+    for (size_t i = 0; i < this->editCount; i++) {
+        auto &edit = this->edits[i];
+        memcpy(edit.dest, this->data + edit.dataOffset + (original ? edit.size : 0), edit.size);
+    }
+    this->setWriting(false);
+    return true;
+}
 
-    auto org = patcher.routeFunction(address + offset, this->to, true);
-    if (!org) {
-        DBGLOG("Patcher+", "Failed to route %s using pattern: %d", safeString(this->symbol), patcher.getError());
+bool PatchSession::commit(KernelPatcher &patcher) {
+    if (this->failed || !this->writeEdits(false)) {
+        this->reset();
         return false;
     }
-    if (this->org) { *this->org = org; }
 
+    // Routes can't be taken back. When the first one fails, rolling back the edits leaves the kext as it was, but
+    // after that the earlier routes are live and the kext is half patched, which it can't be left running in.
+    for (size_t i = 0; i < this->routeCount; i++) {
+        auto &route = this->routes[i];
+        patcher.clearError();
+        auto org = patcher.routeFunction(route.from, route.to, route.org != nullptr);
+        if (patcher.getError() != KernelPatcher::Error::NoError || (route.org && !org)) {
+            PANIC_COND(i != 0, "Patcher+", "Failed to route 0x%llX after %zu routes were applied", route.from, i);
+            DBGLOG("Patcher+", "Failed to route 0x%llX: %d", route.from, static_cast<int>(patcher.getError()));
+            patcher.clearError();
+            if (!this->writeEdits(true)) { DBGLOG("Patcher+", "Failed to roll back edits"); }
+            this->reset();
+            return false;
+        }
+        if (route.org) { *route.org = org; }
+    }
+
+    DBGLOG("Patcher+", "Committed %zu edits and %zu routes", this->editCount, this->routeCount);
+    this->reset();
     return true;
 }
 
+void PatchSession::reset() {
+    if (this->data) { IOFree(this->data, this->dataCapacity); }
+    this->data = nullptr;
+    this->dataSize = this->dataCapacity = 0;
+    this->editCount = this->routeCount = 0;
+    this->failed = false;
+}
+
+bool RouteRequestPlus::route(KernelPatcher &patcher, size_t id, mach_vm_address_t address, size_t maxSize) {
+    PatchSession session {};
+    return this->stage(session, patcher, id, address, maxSize) && session.commit(patcher);
+}
+
 bool RouteRequestPlus::routeAll(KernelPatcher &patcher, size_t id, RouteRequestPlus *requests, size_t count,
     mach_vm_address_t address, size_t maxSize) {
-    for (size_t i = 0; i < count; i++) {
-        if (!requests[i].route(patcher, id, address, maxSize)) { return false; }
+    PatchSession session {};
+    return stageAll(session, patcher, id, requests, count, address, maxSize) && session.commit(patcher);
+}
+
+bool RouteRequestPlus::stage(PatchSession &session, KernelPatcher &patcher, size_t id, mach_vm_address_t address,
+    size_t maxSize) {
+    return stageAll(session, patcher, id, this, 1, address, maxSize);
+}
+
+bool RouteRequestPlus::stageAll(PatchSession &session, KernelPatcher &patcher, size_t id, RouteRequestPlus *requests,
+    size_t count, mach_vm_address_t address, size_t maxSize) {
+    startMetrics();
+    auto &image = KextImage::get(address, maxSize);
+    for (size_t base = 0; base < count; base += MultiPatternScanner::MaxPatterns) {
+        auto chunk = count - base;
+        if (chunk > MultiPatternScanner::MaxPatterns) { chunk = MultiPatternScanner::MaxPatterns; }
+        const char *symbols[MultiPatternScanner::MaxPatterns];
+        mach_vm_address_t addresses[MultiPatternScanner::MaxPatterns];
+        for (size_t i = 0; i < chunk; i++) { symbols[i] = requests[base + i].symbol; }
+        solveSymbols(patcher, id, image, symbols, chunk, addresses);
+
+        PatternQuery queries[MultiPatternScanner::MaxPatterns];
+        size_t pending[MultiPatternScanner::MaxPatterns];
+        size_t pendingCount = 0;
+        for (size_t i = base; i < base + chunk; i++) {
+            auto &request = requests[i];
+            auto from = addresses[i - base];
+            if (from) {
+                if (!session.route(from, request.to, request.org)) { return false; }
+                continue;
+            }
+
+            if (!request.pattern || !request.patternSize) {
+                DBGLOG("Patcher+", "Failed to route %s using symbol", safeString(request.symbol));
+                session.fail("unresolved route");
+                return false;
+            }
+            queries[pendingCount] = {request.pattern, request.mask, request.patternSize, request.section,
+                request.probeFunctionStarts, request.skipTable};
+            pending[pendingCount++] = i;
+        }
+
+        if (!pendingCount) { continue; }
+        findPatterns(queries, pendingCount, address, maxSize);
+        for (size_t i = 0; i < pendingCount; i++) {
+            auto &request = requests[pending[i]];
+            auto offset = queries[i].offset;
+            if (!queries[i].found || !offset) {
+                DBGLOG("Patcher+", "Failed to route %s using pattern", safeString(request.symbol));
+                session.fail("unresolved route");
+                return false;
+            }
+            if (!session.route(address + offset, request.to, request.org)) { return false; }
+        }
     }
     return true;
 }
 
 bool LookupPatchPlus::apply(KernelPatcher &patcher, mach_vm_address_t address, size_t maxSize) const {
-    if (!this->findMask && !this->replaceMask && !this->skip) {
-        patcher.applyLookupPatch(this, reinterpret_cast<UInt8 *>(address), maxSize);
-        return patcher.getError() == KernelPatcher::Error::NoError;
-    }
-    return KernelPatcher::findAndReplaceWithMask(reinterpret_cast<UInt8 *>(address), maxSize, this->find, this->size,
-        this->findMask, this->findMask ? this->size : 0, this->replace, this->size, this->replaceMask,
-        this->replaceMask ? this->size : 0, this->count, this->skip);
+    PatchSession session {};
+    return this->stage(session, address, maxSize) && session.commit(patcher);
 }
 
 bool LookupPatchPlus::applyAll(KernelPatcher &patcher, const LookupPatchPlus *patches, size_t count,
     mach_vm_address_t address, size_t maxSize) {
+    PatchSession session {};
+    return stageAll(session, patches, count, address, maxSize) && session.commit(patcher);
+}
+
+bool LookupPatchPlus::stage(PatchSession &session, mach_vm_address_t address, size_t maxSize) const {
+    startMetrics();
+    PatternQuery query {this->find, this->findMask, this->size, this->section, false, this->skipTable};
+    query.firstInImage = true;
+    findPatterns(&query, 1, address, maxSize);
+    if (query.found && this->stageAt(session, address + query.offset, maxSize - query.offset)) { return true; }
+    session.fail("lookup patch not found");
+    return false;
+}
+
+bool LookupPatchPlus::stageAt(PatchSession &session, mach_vm_address_t address, size_t maxSize) const {
+    auto *data = reinterpret_cast<UInt8 *>(address);
+    MaskedPatternSearch search {this->find, this->findMask, this->size, this->skipTable};
+    size_t offset = 0, skip = this->skip, replaced = 0;
+    while (search.find(data, maxSize, &offset)) {
+        if (skip) {
+            skip -= 1;
+            offset += this->size;
+            continue;
+        }
+
+        if (!session.write(data + offset, this->replace, this->size, this->replaceMask)) { return false; }
+        replaced += 1;
+        offset += this->size;
+
+        if (this->count && replaced == this->count) { break; }
+    }
+
+    return replaced != 0;
+}
+
+// Finds and stages up to `MultiPatternScanner::MaxPatterns` patches, `ids` are what they are logged as.
+static bool stagePatchChunk(PatchSession &session, const LookupPatchPlus *const *patches, const size_t *ids,
+    size_t count, mach_vm_address_t address, size_t maxSize) {
+    PatternQuery queries[MultiPatternScanner::MaxPatterns];
+    for (size_t i = 0; i < count; i++) {
+        auto &patch = *patches[i];
+        queries[i] = {patch.find, patch.findMask, patch.size, patch.section, false, patch.skipTable};
+        queries[i].firstInImage = true;
+        // Skip counts are relative to the first match in the image, so those patches are never chained.
+        if (!patch.maxDistance || patch.skip) { continue; }
+        for (size_t j = 0; j < i; j++) {
+            if (ids[j] != patch.predecessor) { continue; }
+            queries[i].predecessor = j;
+            queries[i].maxDistance = patch.maxDistance;
+            queries[i].firstInImage = false;
+            break;
+        }
+    }
+    findPatterns(queries, count, address, maxSize);
+
+    // Every hit is the first match in the image or after its predecessor, so every patch only has to look at what
+    // follows it.
     for (size_t i = 0; i < count; i++) {
-        if (patches[i].apply(patcher, address, maxSize)) {
-            DBGLOG("Patcher+", "Applied patches[%zu]", i);
+        auto offset = queries[i].offset;
+        if (queries[i].found && patches[i]->stageAt(session, address + offset, maxSize - offset)) {
+            DBGLOG("Patcher+", "Staged patches[%zu]", ids[i]);
         } else {
-            DBGLOG("Patcher+", "Failed to apply patches[%zu]", i);
+            DBGLOG("Patcher+", "Failed to stage patches[%zu]", ids[i]);
+            session.fail("lookup patch not found");
             return false;
         }
     }
     return true;
 }
+
+bool LookupPatchPlus::stageAll(PatchSession &session, const LookupPatchPlus *patches, size_t count,
+    mach_vm_address_t address, size_t maxSize) {
+    startMetrics();
+    const LookupPatchPlus *chunk[MultiPatternScanner::MaxPatterns];
+    size_t ids[MultiPatternScanner::MaxPatterns];
+    for (size_t base = 0; base < count; base += MultiPatternScanner::MaxPatterns) {
+        size_t chunkSize = 0;
+        for (; chunkSize < MultiPatternScanner::MaxPatterns && base + chunkSize < count; chunkSize++) {
+            chunk[chunkSize] = &patches[base + chunkSize];
+            ids[chunkSize] = base + chunkSize;
+        }
+        if (!stagePatchChunk(session, chunk, ids, chunkSize, address, maxSize)) { return false; }
+    }
+    return true;
+}
+
+bool LookupPatchPlus::stagePlan(PatchSession &session, const LookupPatchEntry *manifest, const UInt8 *entries,
+    size_t count, mach_vm_address_t address, size_t maxSize) {
+    startMetrics();
+    const LookupPatchPlus *chunk[MultiPatternScanner::MaxPatterns];
+    size_t ids[MultiPatternScanner::MaxPatterns];
+    for (size_t base = 0; base < count; base += MultiPatternScanner::MaxPatterns) {
+        size_t chunkSize = 0;
+        for (; chunkSize < MultiPatternScanner::MaxPatterns && base + chunkSize < count; chunkSize++) {
+            chunk[chunkSize] = &manifest[entries[base + chunkSize]].patch;
+            ids[chunkSize] = entries[base + chunkSize];
+        }
+        if (!stagePatchChunk(session, chunk, ids, chunkSize, address, maxSize)) { return false; }
+    }
+    return true;
+}
+
+void CallSiteRedirect::rewrite(UInt8 *site, const CallSiteShape &shape) const {
+    for (size_t i = 0; i < shape.size; i++) {
+        site[i] = shape.replaceMask ? (site[i] & ~shape.replaceMask[i]) | (shape.replace[i] & shape.replaceMask[i]) :
+                                      shape.replace[i];
+    }
+    auto handler = reinterpret_cast<UInt64>(this->handler);
+    memcpy(site + shape.handlerOffset, &handler, sizeof(handler));
+}
+
+bool CallSiteRedirect::applyAll(KernelPatcher &patcher, const CallSiteShape *shapes, size_t shapeCount,
+    const CallSiteRedirect *redirects, size_t count, mach_vm_address_t address, size_t maxSize) {
+    PatchSession session {};
+    return stageAll(session, shapes, shapeCount, redirects, count, address, maxSize) && session.commit(patcher);
+}
+
+bool CallSiteRedirect::stageAll(PatchSession &session, const CallSiteShape *shapes, size_t shapeCount,
+    const CallSiteRedirect *redirects, size_t count, mach_vm_address_t address, size_t maxSize) {
+    PANIC_COND(count * shapeCount > MultiPatternScanner::MaxPatterns, "Patcher+", "Too many call site patterns");
+    startMetrics();
+
+    UInt8 patterns[MultiPatternScanner::MaxPatterns][MaxShapeSize];
+    UInt8 masks[MultiPatternScanner::MaxPatterns][MaxShapeSize];
+    PatternQuery queries[MultiPatternScanner::MaxPatterns];
+    for (size_t s = 0; s < shapeCount; s++) {
+        auto &shape = shapes[s];
+        PANIC_COND(shape.size > MaxShapeSize || shape.immediateOffset + sizeof(UInt32) > shape.size ||
+                       shape.handlerOffset + sizeof(UInt64) > shape.size,
+            "Patcher+", "shapes[%zu] is invalid", s);
+        for (size_t r = 0; r < count; r++) {
+            auto i = r * shapeCount + s;
+            memcpy(patterns[i], shape.find, shape.size);
+            if (shape.findMask) {
+                memcpy(masks[i], shape.findMask, shape.size);
+            } else {
+                memset(masks[i], 0xFF, shape.size);
+            }
+            for (size_t b = 0; b < sizeof(UInt32); b++) {
+                auto value = static_cast<UInt8>(redirects[r].immediate >> (b * 8));
+                auto valueMask = static_cast<UInt8>(redirects[r].immediateMask >> (b * 8));
+                auto &byte = patterns[i][shape.immediateOffset + b];
+                byte = (byte & ~valueMask) | (value & valueMask);
+                masks[i][shape.immediateOffset + b] |= valueMask;
+            }
+            queries[i] = {patterns[i], masks[i], shape.size, PatternSection::Code};
+            queries[i].firstInImage = true;
+        }
+    }
+    findPatterns(queries, count * shapeCount, address, maxSize);
+
+    size_t sites[MultiPatternScanner::MaxPatterns];
+    const CallSiteShape *siteShapes[MultiPatternScanner::MaxPatterns];
+    for (size_t r = 0; r < count; r++) {
+        siteShapes[r] = nullptr;
+        for (size_t s = 0; s < shapeCount; s++) {
+            auto &query = queries[r * shapeCount + s];
+            if (!query.found) { continue; }
+            sites[r] = query.offset;
+            siteShapes[r] = &shapes[s];
+            break;
+        }
+        if (!siteShapes[r]) {
+            DBGLOG("Patcher+", "Failed to find call site 0x%X&0x%X", redirects[r].immediate,
+                redirects[r].immediateMask);
+            session.fail("call site not found");
+            return false;
+        }
+    }
+
+    for (size_t r = 0; r < count; r++) {
+        auto *site = reinterpret_cast<UInt8 *>(address + sites[r]);
+        UInt8 replacement[MaxShapeSize];
+        memcpy(replacement, site, siteShapes[r]->size);
+        redirects[r].rewrite(replacement, *siteShapes[r]);
+        if (!session.write(site, replacement, siteShapes[r]->size)) { return false; }
+    }
+    return true;
+}
@@ -2,22 +2,107 @@
 // See LICENSE for details.
 
 #pragma once
+#include "BytePattern.hpp"
+#include "KextImage.hpp"
 #include <Headers/kern_patcher.hpp>
 
+// Queues kext edits and routes so that everything can be checked before anything is touched.
+// `commit` writes all edits in one kernel writing window, then routes; nothing is written if staging failed.
+// A failing first route rolls the edits back, a later one panics since the routes before it can't be undone.
+// Staging more than `MaxEdits` edits or `MaxRoutes` routes panics.
+class PatchSession {
+    public:
+    static constexpr size_t MaxEdits = 32;
+    static constexpr size_t MaxRoutes = 8;
+
+    using WritingHook = kern_return_t (*)(bool enable);
+
+    explicit PatchSession(WritingHook setWriting = nullptr);
+    PatchSession(const PatchSession &) = delete;
+    PatchSession &operator=(const PatchSession &) = delete;
+    ~PatchSession() { this->reset(); }
+
+    // Queues `size` bytes from `value` to be written over `dest`, `mask` keeps the original bits where unset.
+    bool write(void *dest, const void *value, size_t size, const UInt8 *mask = nullptr);
+    bool fill(void *dest, UInt8 value, size_t size);
+    bool route(mach_vm_address_t from, mach_vm_address_t to, mach_vm_address_t *org);
+
+    template<typename T>
+    bool write(T *dest, const T &value) {
+        return this->write(static_cast<void *>(dest), &value, sizeof(T));
+    }
+
+    // Makes the commit fail, for checks done by the caller.
+    void fail(const char *reason);
+
+    inline bool hasFailed() const { return this->failed; }
+
+    bool commit(KernelPatcher &patcher);
+
+    private:
+    struct Edit {
+        UInt8 *dest;
+        size_t size;
+        size_t dataOffset;    // New bytes followed by the original ones
+    };
+
+    struct Route {
+        mach_vm_address_t from, to;
+        mach_vm_address_t *org;
+    };
+
+    UInt8 *reserve(void *dest, size_t size);
+    bool writeEdits(bool original);
+    void reset();
+
+    WritingHook setWriting {nullptr};
+    Edit edits[MaxEdits] {};
+    Route routes[MaxRoutes] {};
+    size_t editCount {0}, routeCount {0};
+    UInt8 *data {nullptr};
+    size_t dataSize {0}, dataCapacity {0};
+    bool failed {false};
+};
+
+// How the patterns of the last solve, route, lookup patch or call site request were found.
+struct PatternSearchMetrics {
+    size_t patterns {0};
+    size_t cached {0};            // Offsets from OffsetCache or the offset database
+    size_t functionStarts {0};    // Found at an LC_FUNCTION_STARTS entry
+    size_t sections {0};          // Found in their hinted section
+    size_t fullScans {0};         // Found by scanning the whole image
+    size_t missing {0};
+    size_t chained {0};           // Found within `maxDistance` bytes after their predecessor
+    size_t earlier {0};           // Hits that turned out to have an earlier match in the image
+    size_t bytesSearched {0};
+    size_t bytesSaved {0};        // Section bytes that chained hits didn't have to scan
+
+    static const PatternSearchMetrics &getLast();
+};
+
 struct SolveRequestPlus : KernelPatcher::SolveRequest {
     const UInt8 *pattern {nullptr}, *mask {nullptr};
     size_t patternSize {0};
+    PatternSection section {PatternSection::Any};
+    const PatternSkipTable *skipTable {nullptr};
 
     template<typename T>
     SolveRequestPlus(const char *s, T &addr) : KernelPatcher::SolveRequest {s, addr} {}
 
     template<typename T, typename P, size_t N>
-    SolveRequestPlus(const char *s, T &addr, const P (&pattern)[N])
-        : KernelPatcher::SolveRequest {s, addr}, pattern {pattern}, patternSize {N} {}
+    SolveRequestPlus(const char *s, T &addr, const P (&pattern)[N], PatternSection section = PatternSection::Any)
+        : KernelPatcher::SolveRequest {s, addr}, pattern {pattern}, patternSize {N}, section {section} {}
 
     template<typename T, typename P, size_t N>
-    SolveRequestPlus(const char *s, T &addr, const P (&pattern)[N], const UInt8 (&mask)[N])
-        : KernelPatcher::SolveRequest {s, addr}, pattern {pattern}, mask {mask}, patternSize {N} {}
+    SolveRequestPlus(const char *s, T &addr, const P (&pattern)[N], const UInt8 (&mask)[N],
+        PatternSection section = PatternSection::Any)
+        : KernelPatcher::SolveRequest {s, addr}, pattern {pattern}, mask {mask}, patternSize {N}, section {section} {}
+
+    template<typename T, size_t N, bool S>
+    SolveRequestPlus(const char *s, T &addr, const BytePattern<N, S> &pattern,
+        PatternSection section = PatternSection::Any)
+        : KernelPatcher::SolveRequest {s, addr}, pattern {pattern.pattern}, mask {pattern.getMask()}, patternSize {N},
+          section {section}, skipTable {pattern.getSkipTable()} {}
 
     bool solve(KernelPatcher &patcher, size_t id, mach_vm_address_t address, size_t maxSize);
 
@@ -34,6 +119,10 @@ struct SolveRequestPlus : KernelPatcher::SolveRequest {
 struct RouteRequestPlus : KernelPatcher::RouteRequest {
     const UInt8 *pattern {nullptr}, *mask {nullptr};
     size_t patternSize {0};
+    PatternSection section {PatternSection::Code};
+    // Try prologue patterns against LC_FUNCTION_STARTS before scanning the section.
+    bool probeFunctionStarts {true};
+    const PatternSkipTable *skipTable {nullptr};
 
     template<typename T>
     RouteRequestPlus(const char *s, T t, mach_vm_address_t &o) : KernelPatcher::RouteRequest {s, t, o} {}
@@ -68,58 +157,219 @@ struct RouteRequestPlus : KernelPatcher::RouteRequest {
     RouteRequestPlus(const char *s, T t, const P (&pattern)[N], const UInt8 (&mask)[N])
         : KernelPatcher::RouteRequest {s, t}, pattern {pattern}, mask {mask}, patternSize {N} {}
 
+    template<typename T, size_t N, bool S>
+    RouteRequestPlus(const char *s, T t, mach_vm_address_t &o, const BytePattern<N, S> &pattern)
+        : KernelPatcher::RouteRequest {s, t, o}, pattern {pattern.pattern}, mask {pattern.getMask()}, patternSize {N},
+          skipTable {pattern.getSkipTable()} {}
+
+    template<typename T, typename O, size_t N, bool S>
+    RouteRequestPlus(const char *s, T t, O &o, const BytePattern<N, S> &pattern)
+        : KernelPatcher::RouteRequest {s, t, o}, pattern {pattern.pattern}, mask {pattern.getMask()}, patternSize {N},
+          skipTable {pattern.getSkipTable()} {}
+
+    template<typename T, size_t N, bool S>
+    RouteRequestPlus(const char *s, T t, const BytePattern<N, S> &pattern)
+        : KernelPatcher::RouteRequest {s, t}, pattern {pattern.pattern}, mask {pattern.getMask()}, patternSize {N},
+          skipTable {pattern.getSkipTable()} {}
+
     bool route(KernelPatcher &patcher, size_t id, mach_vm_address_t address, size_t maxSize);
+    bool stage(PatchSession &session, KernelPatcher &patcher, size_t id, mach_vm_address_t address, size_t maxSize);
 
     static bool routeAll(KernelPatcher &patcher, size_t id, RouteRequestPlus *requests, size_t count,
         mach_vm_address_t address, size_t maxSize);
+    static bool stageAll(PatchSession &session, KernelPatcher &patcher, size_t id, RouteRequestPlus *requests,
+        size_t count, mach_vm_address_t address, size_t maxSize);
 
     template<size_t N>
     static bool routeAll(KernelPatcher &patcher, size_t id, RouteRequestPlus (&requests)[N], mach_vm_address_t address,
         size_t maxSize) {
         return routeAll(patcher, id, requests, N, address, maxSize);
     }
+
+    template<size_t N>
+    static bool stageAll(PatchSession &session, KernelPatcher &patcher, size_t id, RouteRequestPlus (&requests)[N],
+        mach_vm_address_t address, size_t maxSize) {
+        return stageAll(session, patcher, id, requests, N, address, maxSize);
+    }
 };
 
+struct LookupPatchEntry;
+
 struct LookupPatchPlus : KernelPatcher::LookupPatch {
     const UInt8 *findMask {nullptr}, *replaceMask {nullptr};
     const size_t skip {0};
+    const PatternSection section {PatternSection::Code};
+    const PatternSkipTable *skipTable {nullptr};
+    size_t predecessor {0}, maxDistance {0};
 
-    LookupPatchPlus(KernelPatcher::KextInfo *kext, const UInt8 *find, const UInt8 *replace, size_t size, size_t count,
-        size_t skip = 0)
-        : KernelPatcher::LookupPatch {kext, find, replace, size, count}, skip {skip} {}
+    constexpr LookupPatchPlus(KernelPatcher::KextInfo *kext, const UInt8 *find, const UInt8 *replace, size_t size,
+        size_t count, size_t skip = 0, PatternSection section = PatternSection::Code)
+        : KernelPatcher::LookupPatch {kext, find, replace, size, count}, skip {skip}, section {section} {}
 
-    LookupPatchPlus(KernelPatcher::KextInfo *kext, const UInt8 *find, const UInt8 *findMask, const UInt8 *replace,
-        size_t size, size_t count, size_t skip = 0)
-        : KernelPatcher::LookupPatch {kext, find, replace, size, count}, findMask {findMask}, skip {skip} {}
+    constexpr LookupPatchPlus(KernelPatcher::KextInfo *kext, const UInt8 *find, const UInt8 *findMask,
+        const UInt8 *replace, size_t size, size_t count, size_t skip = 0, PatternSection section = PatternSection::Code)
+        : KernelPatcher::LookupPatch {kext, find, replace, size, count}, findMask {findMask}, skip {skip},
+          section {section} {}
 
-    LookupPatchPlus(KernelPatcher::KextInfo *kext, const UInt8 *find, const UInt8 *findMask, const UInt8 *replace,
-        const UInt8 *replaceMask, size_t size, size_t count, size_t skip = 0)
+    constexpr LookupPatchPlus(KernelPatcher::KextInfo *kext, const UInt8 *find, const UInt8 *findMask,
+        const UInt8 *replace, const UInt8 *replaceMask, size_t size, size_t count, size_t skip = 0,
+        PatternSection section = PatternSection::Code)
         : KernelPatcher::LookupPatch {kext, find, replace, size, count}, findMask {findMask}, replaceMask {replaceMask},
-          skip {skip} {}
+          skip {skip}, section {section} {}
 
     template<size_t N>
-    LookupPatchPlus(KernelPatcher::KextInfo *kext, const UInt8 (&find)[N], const UInt8 (&replace)[N], size_t count,
-        size_t skip = 0)
-        : LookupPatchPlus {kext, find, replace, N, count, skip} {}
+    constexpr LookupPatchPlus(KernelPatcher::KextInfo *kext, const UInt8 (&find)[N], const UInt8 (&replace)[N],
+        size_t count, size_t skip = 0, PatternSection section = PatternSection::Code)
+        : LookupPatchPlus {kext, find, replace, N, count, skip, section} {}
 
     template<size_t N>
-    LookupPatchPlus(KernelPatcher::KextInfo *kext, const UInt8 (&find)[N], const UInt8 (&findMask)[N],
-        const UInt8 (&replace)[N], size_t count, size_t skip = 0)
-        : LookupPatchPlus {kext, find, findMask, replace, N, count, skip} {}
+    constexpr LookupPatchPlus(KernelPatcher::KextInfo *kext, const UInt8 (&find)[N], const UInt8 (&findMask)[N],
+        const UInt8 (&replace)[N], size_t count, size_t skip = 0, PatternSection section = PatternSection::Code)
+        : LookupPatchPlus {kext, find, findMask, replace, N, count, skip, section} {}
 
     template<size_t N>
-    LookupPatchPlus(KernelPatcher::KextInfo *kext, const UInt8 (&find)[N], const UInt8 (&findMask)[N],
-        const UInt8 (&replace)[N], const UInt8 (&replaceMask)[N], size_t count, size_t skip = 0)
-        : LookupPatchPlus {kext, find, findMask, replace, replaceMask, N, count, skip} {}
+    constexpr LookupPatchPlus(KernelPatcher::KextInfo *kext, const UInt8 (&find)[N], const UInt8 (&findMask)[N],
+        const UInt8 (&replace)[N], const UInt8 (&replaceMask)[N], size_t count, size_t skip = 0,
+        PatternSection section = PatternSection::Code)
+        : LookupPatchPlus {kext, find, findMask, replace, replaceMask, N, count, skip, section} {}
+
+    // Wildcards in `replace` keep the original bytes.
+    template<size_t N, bool F, bool R>
+    constexpr LookupPatchPlus(KernelPatcher::KextInfo *kext, const BytePattern<N, F> &find,
+        const BytePattern<N, R> &replace, size_t count, size_t skip = 0, PatternSection section = PatternSection::Code)
+        : KernelPatcher::LookupPatch {kext, find.pattern, replace.pattern, N, count}, findMask {find.getMask()},
+          replaceMask {replace.getMask()}, skip {skip}, section {section}, skipTable {find.getSkipTable()} {}
+
+    // When staged in one batch with `predecessor`, an index into the `stageAll` array or the manifest, patch the first
+    // match within `maxDistance` bytes after where it was found instead of the first one in the image.
+    // Only for patterns meant to be in the same function, patches with a skip count are never chained.
+    constexpr LookupPatchPlus near(size_t predecessor, size_t maxDistance) const {
+        LookupPatchPlus ret {*this};
+        ret.predecessor = predecessor;
+        ret.maxDistance = maxDistance;
+        return ret;
+    }
 
     bool apply(KernelPatcher &patcher, mach_vm_address_t address, size_t maxSize) const;
+    bool stage(PatchSession &session, mach_vm_address_t address, size_t maxSize) const;
+    bool stageAt(PatchSession &session, mach_vm_address_t address, size_t maxSize) const;
 
     static bool applyAll(KernelPatcher &patcher, const LookupPatchPlus *patches, size_t count,
         mach_vm_address_t address, size_t maxSize);
+    static bool stageAll(PatchSession &session, const LookupPatchPlus *patches, size_t count,
+        mach_vm_address_t address, size_t maxSize);
+    // Like `stageAll` for `manifest[entries[0..count)]`.
+    static bool stagePlan(PatchSession &session, const LookupPatchEntry *manifest, const UInt8 *entries,
+        size_t count, mach_vm_address_t address, size_t maxSize);
 
     template<size_t N>
     static bool applyAll(KernelPatcher &patcher, const LookupPatchPlus (&patches)[N], mach_vm_address_t address,
         size_t maxSize) {
         return applyAll(patcher, patches, N, address, maxSize);
     }
+
+    template<size_t N>
+    static bool stageAll(PatchSession &session, const LookupPatchPlus (&patches)[N], mach_vm_address_t address,
+        size_t maxSize) {
+        return stageAll(session, patches, N, address, maxSize);
+    }
+};
+
+// A manifest entry, applied when the masked attribute bits equal `value`.
+struct LookupPatchEntry {
+    UInt8 mask {0}, value {0};
+    LookupPatchPlus patch;
+
+    constexpr bool appliesTo(UInt8 attributes) const { return (attributes & this->mask) == this->value; }
+};
+
+// The manifest entries applying to one attribute combination, in manifest order.
+template<size_t N>
+struct LookupPatchPlan {
+    static_assert(N <= 0x100, "Manifest entries are indexed by a byte");
+
+    UInt8 key {0};
+    size_t count {0};
+    UInt8 entries[N] {};
+
+    // Stages the planned entries of `manifest` with `LookupPatchPlus::stageAll`.
+    bool stage(PatchSession &session, const LookupPatchEntry (&manifest)[N], mach_vm_address_t address,
+        size_t maxSize) const {
+        return LookupPatchPlus::stagePlan(session, manifest, this->entries, this->count, address, maxSize);
+    }
+};
+
+template<size_t N, size_t K>
+struct LookupPatchPlans {
+    LookupPatchPlan<N> plans[K] {};
+
+    constexpr const LookupPatchPlan<N> *find(UInt8 key) const {
+        for (size_t i = 0; i < K; i++) {
+            if (this->plans[i].key == key) { return &this->plans[i]; }
+        }
+        return nullptr;
+    }
+};
+
+// Resolves the manifest for every attribute combination in `keys` at compile time, so that picking the patches at
+// runtime is a table lookup.
+template<size_t N, size_t K>
+constexpr LookupPatchPlans<N, K> compileLookupPatchPlans(const LookupPatchEntry (&manifest)[N],
+    const UInt8 (&keys)[K]) {
+    LookupPatchPlans<N, K> ret {};
+    for (size_t i = 0; i < K; i++) {
+        auto &plan = ret.plans[i];
+        plan.key = keys[i];
+        for (size_t j = 0; j < N; j++) {
+            if (manifest[j].appliesTo(keys[i])) { plan.entries[plan.count++] = static_cast<UInt8>(j); }
+        }
+    }
+    return ret;
+}
+
+// An instruction sequence calling a function with a 32-bit immediate that tells the call sites apart, such as
+// `lea rsi, [rel blob]; mov edx, size; call _memcpy`.
+struct CallSiteShape {
+    const UInt8 *find {nullptr}, *findMask {nullptr};
+    const UInt8 *replace {nullptr}, *replaceMask {nullptr};
+    size_t size {0};
+    size_t immediateOffset {0};    // Where the immediate is in `find`
+    size_t handlerOffset {0};      // Where the handler address is written in `replace`
+
+    // Wildcards in `replace` keep the original bytes.
+    template<size_t N, bool F, bool R>
+    CallSiteShape(const BytePattern<N, F> &find, const BytePattern<N, R> &replace, size_t immediateOffset,
+        size_t handlerOffset)
+        : find {find.pattern}, findMask {find.getMask()}, replace {replace.pattern}, replaceMask {replace.getMask()},
+          size {N}, immediateOffset {immediateOffset}, handlerOffset {handlerOffset} {}
+};
+
+// Redirects the call site with a matching immediate to `handler`.
+struct CallSiteRedirect {
+    static constexpr size_t MaxShapeSize = 32;
+
+    UInt32 immediate {0}, immediateMask {0};
+    void (*handler)(void *data) {nullptr};
+
+    // Writes the replacement of `shape` over `site`, the caller takes care of kernel writing.
+    void rewrite(UInt8 *site, const CallSiteShape &shape) const;
+
+    // Finds the sites of every redirect in any of the shapes in a single pass, preferring earlier shapes,
+    // then rewrites all of them in one kernel writing window. Nothing is written unless every site is found.
+    static bool applyAll(KernelPatcher &patcher, const CallSiteShape *shapes, size_t shapeCount,
+        const CallSiteRedirect *redirects, size_t count, mach_vm_address_t address, size_t maxSize);
+    static bool stageAll(PatchSession &session, const CallSiteShape *shapes, size_t shapeCount,
+        const CallSiteRedirect *redirects, size_t count, mach_vm_address_t address, size_t maxSize);
+
+    template<size_t S, size_t N>
+    static bool applyAll(KernelPatcher &patcher, const CallSiteShape (&shapes)[S],
+        const CallSiteRedirect (&redirects)[N], mach_vm_address_t address, size_t maxSize) {
+        return applyAll(patcher, shapes, S, redirects, N, address, maxSize);
+    }
+
+    template<size_t S, size_t N>
+    static bool stageAll(PatchSession &session, const CallSiteShape (&shapes)[S],
+        const CallSiteRedirect (&redirects)[N], mach_vm_address_t address, size_t maxSize) {
+        return stageAll(session, shapes, S, redirects, N, address, maxSize);
+    }
 };
@@ -0,0 +1,81 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#pragma once
+#include <Headers/kern_util.hpp>
+
+template<typename Value>
+struct PathTrieEntry {
+    const char *path;
+    Value value;
+    bool prefix;    // Also matches every path that continues past `path`
+};
+
+// Room for the worst case, where no two paths share a prefix.
+template<typename Value, size_t N>
+constexpr size_t getPathTrieCapacity(const PathTrieEntry<Value> (&entries)[N]) {
+    size_t capacity = 1;
+    for (size_t i = 0; i < N; i++) {
+        for (size_t j = 0; entries[i].path[j]; j++) { capacity += 1; }
+    }
+    return capacity;
+}
+
+// Byte trie over a fixed set of paths, built at compile time.
+// A lookup walks the path once and stops at the first byte that no path in the set continues with, so paths that
+// aren't targets usually leave after a handful of bytes.
+template<typename Value, size_t NodeCount>
+class PathTrie {
+    static_assert(NodeCount <= 0x10000, "Node indices are 16-bit");
+
+    public:
+    template<size_t N>
+    constexpr explicit PathTrie(const PathTrieEntry<Value> (&entries)[N]) {
+        for (size_t i = 0; i < N; i++) { this->insert(entries[i]); }
+    }
+
+    // Returns the value of the first path in the set that matches `path`, or `fallback`.
+    Value lookup(const char *path, Value fallback) const {
+        UInt16 index = 0;
+        for (;; path++) {
+            const auto &node = this->nodes[index];
+            if (node.terminal && (node.prefix || *path == '\0')) { return node.value; }
+            if (*path == '\0') { return fallback; }
+            index = node.child;
+            while (index && this->nodes[index].byte != *path) { index = this->nodes[index].sibling; }
+            if (!index) { return fallback; }
+        }
+    }
+
+    private:
+    // Node 0 is the root and never anyone's child or sibling, so 0 also means none.
+    struct Node {
+        char byte {0};
+        bool terminal {false};
+        bool prefix {false};
+        Value value {};
+        UInt16 child {0};
+        UInt16 sibling {0};
+    };
+
+    constexpr void insert(const PathTrieEntry<Value> &entry) {
+        UInt16 index = 0;
+        for (const char *path = entry.path; *path; path++) {
+            auto next = this->nodes[index].child;
+            while (next && this->nodes[next].byte != *path) { next = this->nodes[next].sibling; }
+            if (!next) {
+                next = static_cast<UInt16>(this->count++);
+                this->nodes[next].byte = *path;
+                this->nodes[next].sibling = this->nodes[index].child;
+                this->nodes[index].child = next;
+            }
+            index = next;
+        }
+        this->nodes[index].terminal = true;
+        this->nodes[index].prefix = entry.prefix;
+        this->nodes[index].value = entry.value;
+    }
+
+    Node nodes[NodeCount] {};
+    size_t count {1};
+};
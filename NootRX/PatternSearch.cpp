@@ -0,0 +1,301 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "PatternSearch.hpp"
+
+// Eight bytes at a time in a general purpose register, see the note in the header.
+static constexpr UInt64 WordLowBits = 0x0101010101010101;
+static constexpr UInt64 WordLowMask = 0x7F7F7F7F7F7F7F7F;
+
+static inline UInt64 loadWord(const UInt8 *ptr) {
+    UInt64 value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static inline UInt64 splatByte(UInt8 value) { return value * WordLowBits; }
+
+// Sets the top bit of every zero byte of `value` and nothing else, unlike the cheaper `(x - 1) & ~x` trick, which can
+// also flag the byte after a zero.
+static inline UInt64 getZeroBytes(UInt64 value) {
+    return ~(((value & WordLowMask) + WordLowMask) | value | WordLowMask);
+}
+
+// Index of the lowest byte flagged by `getZeroBytes`, the loads are little endian.
+static inline size_t getFirstByte(UInt64 bits) { return static_cast<size_t>(__builtin_ctzll(bits)) / 8; }
+
+// Rough byte frequencies of x86-64 code and the data tables around it, higher is more common.
+UInt8 getByteCommonness(UInt8 value) {
+    switch (value) {
+        case 0x00:
+            return 255;
+        case 0xFF:
+            return 200;
+        case 0x48:
+            return 180;
+        case 0x89:
+            return 150;
+        case 0x8B:
+            return 140;
+        case 0x41:
+            return 130;
+        case 0x4C:
+            return 110;
+        case 0x0F:
+        case 0x45:
+            return 100;
+        case 0xE8:
+            return 90;
+        case 0x24:
+        case 0x83:
+        case 0x8D:
+            return 80;
+        case 0x01:
+        case 0x49:
+        case 0x85:
+            return 70;
+        case 0x74:
+        case 0x75:
+        case 0x84:
+        case 0xC0:
+            return 60;
+        case 0x31:
+        case 0x44:
+        case 0xC7:
+            return 50;
+        case 0x02:
+        case 0x08:
+        case 0x10:
+        case 0x55:
+        case 0x5D:
+        case 0x66:
+        case 0x90:
+        case 0xC3:
+        case 0xE5:
+        case 0xEB:
+            return 40;
+        case 0x04:
+        case 0x20:
+        case 0x40:
+        case 0x80:
+            return 30;
+        default:
+            return 0;
+    }
+}
+
+bool patternMatchesAt(const UInt8 *data, const UInt8 *pattern, const UInt8 *mask, size_t size) {
+    size_t i = 0;
+    for (; i + sizeof(UInt64) <= size; i += sizeof(UInt64)) {
+        auto diff = loadWord(data + i) ^ loadWord(pattern + i);
+        if (mask != nullptr) { diff &= loadWord(mask + i); }
+        if (diff != 0) { return false; }
+    }
+    for (; i < size; i++) {
+        auto byteMask = mask == nullptr ? 0xFF : mask[i];
+        if ((data[i] & byteMask) != (pattern[i] & byteMask)) { return false; }
+    }
+    return true;
+}
+
+MaskedPatternSearch::MaskedPatternSearch(const UInt8 *pattern, const UInt8 *mask, size_t size,
+    const PatternSkipTable *skipTable)
+    : pattern {pattern}, mask {mask}, size {size} {
+    if (skipTable && skipTable->runSize >= MinSkipRun && skipTable->runOffset + skipTable->runSize <= size) {
+        this->skipTable = skipTable;
+    }
+    UInt32 best = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (mask != nullptr && mask[i] != 0xFF) { continue; }
+        bool paired = i + 1 < size && (mask == nullptr || mask[i + 1] == 0xFF);
+        UInt32 score = getByteCommonness(pattern[i]);
+        score = paired ? score + getByteCommonness(pattern[i + 1]) : score + 0x100;
+        if (!this->anchored || score < best) {
+            this->anchor = i;
+            this->anchored = true;
+            this->paired = paired;
+            best = score;
+        }
+    }
+}
+
+bool MaskedPatternSearch::find(const UInt8 *data, size_t size, size_t *offset) const {
+    if (this->size == 0 || size < this->size || *offset > size - this->size) { return false; }
+
+    if (this->skipTable) { return this->findWithSkipTable(data, size, offset); }
+
+    size_t lastStart = size - this->size;
+    size_t start = *offset;
+
+    if (!this->anchored) {
+        for (; start <= lastStart; start++) {
+            if (patternMatchesAt(data + start, this->pattern, this->mask, this->size)) {
+                *offset = start;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Walk the anchor position instead of the pattern start, `pos - anchor` is the candidate start.
+    auto pos = start + this->anchor;
+    auto lastPos = lastStart + this->anchor;
+    auto first = this->pattern[this->anchor];
+    UInt8 second = this->paired ? this->pattern[this->anchor + 1] : 0;
+    auto firstWord = splatByte(first);
+    auto secondWord = splatByte(second);
+
+    // The paired load reads one byte past the word.
+    while (pos + sizeof(UInt64) + 1 <= size && pos <= lastPos) {
+        auto bits = getZeroBytes(loadWord(data + pos) ^ firstWord);
+        if (this->paired) { bits &= getZeroBytes(loadWord(data + pos + 1) ^ secondWord); }
+        while (bits != 0) {
+            auto candidate = pos + getFirstByte(bits);
+            if (candidate > lastPos) { return false; }
+            if (patternMatchesAt(data + candidate - this->anchor, this->pattern, this->mask, this->size)) {
+                *offset = candidate - this->anchor;
+                return true;
+            }
+            bits &= bits - 1;
+        }
+        pos += sizeof(UInt64);
+    }
+
+    for (; pos <= lastPos; pos++) {
+        if (data[pos] != first || (this->paired && data[pos + 1] != second)) { continue; }
+        if (patternMatchesAt(data + pos - this->anchor, this->pattern, this->mask, this->size)) {
+            *offset = pos - this->anchor;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MaskedPatternSearch::findWithSkipTable(const UInt8 *data, size_t size, size_t *offset) const {
+    auto runOffset = this->skipTable->runOffset;
+    auto runSize = this->skipTable->runSize;
+    auto *run = this->pattern + runOffset;
+    auto last = run[runSize - 1];
+
+    // `pos` is where the run starts in the data, the pattern starts `runOffset` bytes before.
+    auto lastPos = size - this->size + runOffset;
+    for (auto pos = *offset + runOffset; pos <= lastPos;) {
+        auto value = data[pos + runSize - 1];
+        if (value == last && !memcmp(data + pos, run, runSize - 1) &&
+            patternMatchesAt(data + pos - runOffset, this->pattern, this->mask, this->size)) {
+            *offset = pos - runOffset;
+            return true;
+        }
+        pos += this->skipTable->shifts[value];
+    }
+    return false;
+}
+
+bool MultiPatternScanner::add(const UInt8 *pattern, const UInt8 *mask, size_t size) {
+    if (this->count == MaxPatterns || pattern == nullptr || size == 0) { return false; }
+
+    auto &entry = this->entries[this->count];
+    entry.pattern = pattern;
+    entry.mask = mask;
+    entry.size = size;
+
+    bool anchored = false;
+    for (size_t i = 0; i < size; i++) {
+        if (mask != nullptr && mask[i] != 0xFF) { continue; }
+        if (!anchored || getByteCommonness(pattern[i]) < getByteCommonness(pattern[entry.anchor])) {
+            entry.anchor = i;
+            anchored = true;
+        }
+    }
+
+    auto index = static_cast<UInt8>(this->count + 1);
+    if (anchored) {
+        auto &head = this->heads[pattern[entry.anchor]];
+        if (!head) { this->anchorBytes[this->anchorByteCount++] = pattern[entry.anchor]; }
+        entry.next = head;
+        head = index;
+    } else {
+        entry.next = this->unanchored;
+        this->unanchored = index;
+    }
+    this->count += 1;
+
+    return true;
+}
+
+// `onCandidate` gets the pattern index and start of every position holding the anchor byte of a pattern and returns
+// false to end the walk. Unanchored patterns are offered every position.
+template<typename F>
+void MultiPatternScanner::walk(const UInt8 *data, size_t size, F onCandidate) const {
+    size_t pos = 0;
+    // Unanchored patterns can start anywhere, so there's nothing to filter on.
+    if (!this->unanchored && this->anchorByteCount) {
+        for (; pos + sizeof(UInt64) <= size; pos += sizeof(UInt64)) {
+            auto word = loadWord(data + pos);
+            UInt64 bits = 0;
+            for (size_t i = 0; i < this->anchorByteCount; i++) {
+                bits |= getZeroBytes(word ^ splatByte(this->anchorBytes[i]));
+            }
+            for (; bits != 0; bits &= bits - 1) {
+                if (!this->visit(data, pos + getFirstByte(bits), onCandidate)) { return; }
+            }
+        }
+    }
+    for (; pos < size; pos++) {
+        if (!this->visit(data, pos, onCandidate)) { return; }
+    }
+}
+
+template<typename F>
+bool MultiPatternScanner::visit(const UInt8 *data, size_t pos, F &onCandidate) const {
+    for (auto i = this->heads[data[pos]]; i != 0;) {
+        size_t index = i - 1;
+        const auto &entry = this->entries[index];
+        i = entry.next;
+        if (pos >= entry.anchor && !onCandidate(index, pos - entry.anchor)) { return false; }
+    }
+    for (auto i = this->unanchored; i != 0;) {
+        size_t index = i - 1;
+        i = this->entries[index].next;
+        if (!onCandidate(index, pos)) { return false; }
+    }
+    return true;
+}
+
+bool MultiPatternScanner::matchesAt(size_t index, const UInt8 *data, size_t size, size_t start) const {
+    const auto &entry = this->entries[index];
+    return entry.size <= size - start && patternMatchesAt(data + start, entry.pattern, entry.mask, entry.size);
+}
+
+size_t MultiPatternScanner::scan(const UInt8 *data, size_t size) {
+    size_t remaining = this->count;
+    for (size_t i = 0; i < this->count; i++) { this->entries[i].found = false; }
+
+    this->walk(data, size, [&](size_t index, size_t start) {
+        auto &entry = this->entries[index];
+        if (entry.found || !this->matchesAt(index, data, size, start)) { return true; }
+        entry.found = true;
+        entry.offset = start;
+        remaining -= 1;
+        return remaining != 0;
+    });
+
+    return this->count - remaining;
+}
+
+void MultiPatternScanner::forEachMatch(const UInt8 *data, size_t size, MatchCallback callback, void *context) const {
+    // First start each pattern may be reported at again.
+    size_t resume[MaxPatterns] {};
+    this->walk(data, size, [&](size_t index, size_t start) {
+        if (start < resume[index] || !this->matchesAt(index, data, size, start)) { return true; }
+        resume[index] = start + this->entries[index].size;
+        callback(context, index, start);
+        return true;
+    });
+}
+
+bool MultiPatternScanner::getOffset(size_t index, size_t *offset) const {
+    if (index >= this->count || !this->entries[index].found) { return false; }
+    *offset = this->entries[index].offset;
+    return true;
+}
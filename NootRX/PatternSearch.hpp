@@ -0,0 +1,86 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#pragma once
+#include <Headers/kern_util.hpp>
+
+// Nothing in here touches vector registers. XNU doesn't save the user's SSE state on kernel entry and kexts are built
+// soft-float, so the searches work on 8 bytes at a time in general purpose registers instead.
+
+// Horspool shifts for the longest wildcard-free run of a pattern, see `BytePattern`.
+struct PatternSkipTable {
+    size_t runOffset {0}, runSize {0};
+    UInt8 shifts[0x100] {};
+};
+
+// Masked pattern search for a single pattern.
+// The rarest fully-masked byte pair is picked as the anchor when the pattern is built, the data is then scanned
+// for that pair 8 bytes at a time and only the candidates get a full masked compare.
+class MaskedPatternSearch {
+    public:
+    // Runs of at least this many wildcard-free bytes are searched with their Horspool table instead.
+    static constexpr size_t MinSkipRun = 32;
+
+    MaskedPatternSearch(const UInt8 *pattern, const UInt8 *mask, size_t size,
+        const PatternSkipTable *skipTable = nullptr);
+
+    // Same contract as `KernelPatcher::findPattern`, the search starts at `*offset`.
+    bool find(const UInt8 *data, size_t size, size_t *offset) const;
+
+    private:
+    bool findWithSkipTable(const UInt8 *data, size_t size, size_t *offset) const;
+
+    const UInt8 *pattern {nullptr}, *mask {nullptr};
+    size_t size {0};
+    const PatternSkipTable *skipTable {nullptr};
+    size_t anchor {0};
+    bool anchored {false};
+    bool paired {false};
+};
+
+// Finds matches of several masked patterns in a single walk over the data.
+// Every pattern is keyed by one fully-masked anchor byte. The data is compared 8 bytes at a time against all the
+// distinct anchor bytes, and only the positions holding one go through the anchor table to get verified.
+class MultiPatternScanner {
+    public:
+    static constexpr size_t MaxPatterns = 16;
+
+    // Called for each match by `forEachMatch`, with the index of the pattern in the order they were added.
+    using MatchCallback = void (*)(void *context, size_t index, size_t offset);
+
+    bool add(const UInt8 *pattern, const UInt8 *mask, size_t size);
+    // Finds the first match of every pattern, see `getOffset`. Returns how many were found.
+    size_t scan(const UInt8 *data, size_t size);
+    // Reports every match of every pattern that doesn't overlap an earlier match of the same pattern.
+    // Keeps no state in the scanner, so a scanner that is set up once can be shared between threads.
+    void forEachMatch(const UInt8 *data, size_t size, MatchCallback callback, void *context) const;
+    bool getOffset(size_t index, size_t *offset) const;
+
+    inline size_t getCount() const { return this->count; }
+
+    private:
+    struct Entry {
+        const UInt8 *pattern {nullptr}, *mask {nullptr};
+        size_t size {0};
+        size_t anchor {0};
+        size_t offset {0};
+        bool found {false};
+        UInt8 next {0};
+    };
+
+    template<typename F>
+    void walk(const UInt8 *data, size_t size, F onCandidate) const;
+    template<typename F>
+    bool visit(const UInt8 *data, size_t pos, F &onCandidate) const;
+    bool matchesAt(size_t index, const UInt8 *data, size_t size, size_t start) const;
+
+    Entry entries[MaxPatterns] {};
+    UInt8 heads[256] {};
+    UInt8 unanchored {0};
+    UInt8 anchorBytes[MaxPatterns] {};
+    size_t anchorByteCount {0};
+    size_t count {0};
+};
+
+bool patternMatchesAt(const UInt8 *data, const UInt8 *pattern, const UInt8 *mask, size_t size);
+UInt8 getByteCommonness(UInt8 value);
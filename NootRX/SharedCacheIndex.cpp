@@ -0,0 +1,8 @@
+// Generated by Scripts/GenerateSharedCacheIndex.py, do not edit.
+
+#include "SharedCacheIndex.hpp"
+
+const SharedCacheIndex sharedCacheIndex[] = {
+    {},
+};
+const size_t sharedCacheIndexCount = 0;
@@ -0,0 +1,19 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#pragma once
+#include <Headers/kern_util.hpp>
+
+// Where the header of every dyld shared cache file keeps its UUID, must match `UUID_OFFSET`.
+static constexpr size_t SharedCacheUUIDOffset = 0x58;
+
+// Pages of known dyld shared cache files that hold a `DYLDPatches` target, see Scripts/GenerateSharedCacheIndex.py.
+struct SharedCacheIndex {
+    UInt8 uuid[16];
+    const UInt32 *pages;    // Sorted file offsets in units of `PAGE_SIZE`
+    size_t count;
+};
+
+// Terminated by an empty entry, so the table is never zero-sized.
+extern const SharedCacheIndex sharedCacheIndex[];
+extern const size_t sharedCacheIndexCount;
@@ -0,0 +1,117 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#pragma once
+#include <Headers/kern_util.hpp>
+#include <IOKit/IOLib.h>
+
+// Remembers a small decision about a file, or about one offset in it, keyed by the vnode and its `vnode_vid`, so the
+// code signing hook doesn't have to redo its work for every page it sees. A recycled vnode gets a new vid, so its old
+// entries simply stop matching.
+// Readers never block: every slot is a seqlock, a reader that races a writer treats it as a miss, and a writer that
+// races another writer drops its entry. The vnode is only compared, never dereferenced.
+// The slots are only allocated by `allocate`, so a cache whose user never runs costs nothing. Until then, or if that
+// fails, every lookup misses and every insert is dropped. Offsets are page aligned.
+template<typename Value, size_t SlotCount>
+class VnodeCache {
+    static_assert((SlotCount & (SlotCount - 1)) == 0, "SlotCount must be a power of two");
+
+    public:
+    // Each key may live in this many consecutive slots.
+    static constexpr size_t Ways = 2;
+
+    VnodeCache() = default;
+    VnodeCache(const VnodeCache &) = delete;
+    VnodeCache &operator=(const VnodeCache &) = delete;
+
+    ~VnodeCache() {
+        if (this->slots) { IOFree(this->slots, sizeof(Slot) * SlotCount); }
+    }
+
+    // Must be called before the cache is shared, from a context that may block.
+    bool allocate() {
+        if (this->slots) { return true; }
+        auto *slots = static_cast<Slot *>(IOMalloc(sizeof(Slot) * SlotCount));
+        if (!slots) { return false; }
+        memset(slots, 0, sizeof(Slot) * SlotCount);
+        __atomic_store_n(&this->slots, slots, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    bool lookup(const void *vnode, UInt32 vid, UInt64 offset, Value *value) const {
+        auto *slots = __atomic_load_n(&this->slots, __ATOMIC_ACQUIRE);
+        if (!slots) { return false; }
+        auto page = static_cast<UInt32>(offset / PAGE_SIZE);
+        auto index = indexOf(vnode, vid, page);
+        for (size_t i = 0; i < Ways; i++) {
+            const auto &slot = slots[(index + i) & (SlotCount - 1)];
+            auto sequence = __atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE);
+            if (sequence & 1) { continue; }
+            auto slotVnode = __atomic_load_n(&slot.vnode, __ATOMIC_RELAXED);
+            auto slotVid = __atomic_load_n(&slot.vid, __ATOMIC_RELAXED);
+            auto slotPage = __atomic_load_n(&slot.page, __ATOMIC_RELAXED);
+            auto slotValue = __atomic_load_n(&slot.value, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&slot.sequence, __ATOMIC_RELAXED) != sequence) { continue; }
+            if (slotVnode == vnode && slotVid == vid && slotPage == page) {
+                *value = slotValue;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void insert(const void *vnode, UInt32 vid, UInt64 offset, Value value) {
+        auto *slots = __atomic_load_n(&this->slots, __ATOMIC_ACQUIRE);
+        if (!slots) { return; }
+        auto page = static_cast<UInt32>(offset / PAGE_SIZE);
+        auto index = indexOf(vnode, vid, page);
+        // Prefer the slot already holding this vnode and page, then an empty one, and evict the first otherwise.
+        auto *target = &slots[index];
+        for (size_t i = 0; i < Ways; i++) {
+            auto &slot = slots[(index + i) & (SlotCount - 1)];
+            auto slotVnode = __atomic_load_n(&slot.vnode, __ATOMIC_RELAXED);
+            if (slotVnode == vnode && __atomic_load_n(&slot.page, __ATOMIC_RELAXED) == page) {
+                target = &slot;
+                break;
+            }
+            if (!slotVnode && target == &slots[index]) { target = &slot; }
+        }
+
+        auto sequence = __atomic_load_n(&target->sequence, __ATOMIC_RELAXED);
+        if ((sequence & 1) || !__atomic_compare_exchange_n(&target->sequence, &sequence, sequence + 1, false,
+                                  __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        __atomic_store_n(&target->vnode, vnode, __ATOMIC_RELAXED);
+        __atomic_store_n(&target->vid, vid, __ATOMIC_RELAXED);
+        __atomic_store_n(&target->page, page, __ATOMIC_RELAXED);
+        __atomic_store_n(&target->value, value, __ATOMIC_RELAXED);
+        __atomic_store_n(&target->sequence, sequence + 2, __ATOMIC_RELEASE);
+    }
+
+    private:
+    // 24 bytes for the values in use, the page rather than the offset keeps it from growing to 32.
+    struct Slot {
+        UInt32 sequence;    // Odd while a writer owns the slot
+        UInt32 vid;
+        const void *vnode;
+        UInt32 page;
+        Value value;
+    };
+
+    static size_t indexOf(const void *vnode, UInt32 vid, UInt32 page) {
+        // MurmurHash3 fmix64, vnodes are zone allocated, so the raw low bits cluster badly.
+        UInt64 hash =
+            reinterpret_cast<uintptr_t>(vnode) ^ (static_cast<UInt64>(vid) << 32) ^ (page * 0x9E3779B97F4A7C15);
+        hash ^= hash >> 33;
+        hash *= 0xFF51AFD7ED558CCD;
+        hash ^= hash >> 33;
+        hash *= 0xC4CEB9FE1A85EC53;
+        hash ^= hash >> 33;
+        return static_cast<size_t>(hash) & (SlotCount - 1);
+    }
+
+    Slot *slots {nullptr};
+};
@@ -3,6 +3,7 @@
 
 #include "X6000.hpp"
 #include "NootRX.hpp"
+#include "OffsetCache.hpp"
 #include "PatcherPlus.hpp"
 #include <Headers/kern_api.hpp>
 #include <IOKit/IOService.h>
@@ -30,6 +31,7 @@ void X6000::init() {
 
 bool X6000::processKext(KernelPatcher &patcher, size_t id, mach_vm_address_t slide, size_t size) {
     if (kextRadeonX6000.loadIndex == id) {
+        OffsetCache::get().setKext("X6000");
         NootRXMain::callback->ensureRMMIO();
 
         RouteRequestPlus request {"__ZN35AMDRadeonX6000_AMDAccelVideoContext9getHWInfoEP13sHardwareInfo", wrapGetHWInfo,
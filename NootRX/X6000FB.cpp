@@ -3,6 +3,7 @@
 
 #include "X6000FB.hpp"
 #include "NootRX.hpp"
+#include "OffsetCache.hpp"
 #include "PatcherPlus.hpp"
 #include <Headers/kern_api.hpp>
 
@@ -30,17 +31,21 @@ void X6000FB::init() {
 
 bool X6000FB::processKext(KernelPatcher &patcher, size_t id, mach_vm_address_t slide, size_t size) {
     if (kextRadeonX6000Framebuffer.loadIndex == id) {
+        OffsetCache::get().setKext("X6000FB");
         NootRXMain::callback->ensureRMMIO();
 
         CAILAsicCapsEntry *orgAsicCapsTable = nullptr;
 
-        SolveRequestPlus solveRequest {"__ZL20CAIL_ASIC_CAPS_TABLE", orgAsicCapsTable, kCailAsicCapsTablePattern};
+        SolveRequestPlus solveRequest {"__ZL20CAIL_ASIC_CAPS_TABLE", orgAsicCapsTable, kCailAsicCapsTablePattern,
+            PatternSection::Data};
         PANIC_COND(!solveRequest.solve(patcher, id, slide, size), "X6000FB", "Failed to resolve CAIL_ASIC_CAPS_TABLE");
 
+        PatchSession session {};
+
         if (!NootRXMain::callback->attributes.isNavi21()) {
             RouteRequestPlus request {"__ZNK32AMDRadeonX6000_AmdAsicInfoNavi2327getEnumeratedRevisionNumberEv",
                 wrapGetEnumeratedRevision};
-            PANIC_COND(!request.route(patcher, id, slide, size), "X6000FB",
+            PANIC_COND(!request.stage(session, patcher, id, slide, size), "X6000FB",
                 "Failed to route getEnumeratedRevisionNumber");
         }
 
@@ -51,21 +56,20 @@ bool X6000FB::processKext(KernelPatcher &patcher, size_t id, mach_vm_address_t s
                 {"__ZN34AMDRadeonX6000_AmdRadeonController10doGPUPanicEPKcz", wrapDoGPUPanic},
                 {"_dm_logger_write", wrapDmLoggerWrite, kDmLoggerWritePattern},
             };
-            PANIC_COND(!RouteRequestPlus::routeAll(patcher, id, requests, slide, size), "X6000FB",
+            PANIC_COND(!RouteRequestPlus::stageAll(session, patcher, id, requests, slide, size), "X6000FB",
                 "Failed to route debug symbols");
         }
 
-        PANIC_COND(MachInfo::setKernelWriting(true, KernelPatcher::kernelWriteLock) != KERN_SUCCESS, "X6000FB",
-            "Failed to enable kernel writing");
-        orgAsicCapsTable[0].familyId = AMDGPU_FAMILY_NAVI;
-        orgAsicCapsTable[0].deviceId = NootRXMain::callback->deviceId;
-        orgAsicCapsTable[0].revNo = NootRXMain::callback->devRevision;
-        orgAsicCapsTable[0].emulatedRevNo =
+        auto capsEntry = orgAsicCapsTable[0];
+        capsEntry.familyId = AMDGPU_FAMILY_NAVI;
+        capsEntry.deviceId = NootRXMain::callback->deviceId;
+        capsEntry.revNo = NootRXMain::callback->devRevision;
+        capsEntry.emulatedRevNo =
             static_cast<UInt32>(NootRXMain::callback->enumRevision) + NootRXMain::callback->devRevision;
-        orgAsicCapsTable[0].revId = NootRXMain::callback->pciRevision;
-        orgAsicCapsTable[0].caps = ddiCapsNavi2Universal;
-        MachInfo::setKernelWriting(false, KernelPatcher::kernelWriteLock);
-        DBGLOG("X6000FB", "Applied DDI Caps patches");
+        capsEntry.revId = NootRXMain::callback->pciRevision;
+        capsEntry.caps = ddiCapsNavi2Universal;
+        session.write(orgAsicCapsTable, capsEntry);
+        DBGLOG("X6000FB", "Staged DDI Caps patches");
 
         if (ADDPR(debugEnabled)) {
             auto *logEnableMaskMinors =
@@ -83,10 +87,7 @@ bool X6000FB::processKext(KernelPatcher &patcher, size_t id, mach_vm_address_t s
                 logEnableMaskMinors = instAddr + 7 + *reinterpret_cast<SInt32 *>(instAddr + 3);
             }
 
-            PANIC_COND(MachInfo::setKernelWriting(true, KernelPatcher::kernelWriteLock) != KERN_SUCCESS, "X6000FB",
-                "Failed to enable kernel writing");
-            memset(logEnableMaskMinors, 0xFF, 0x80);    // Enable all DalDmLogger logs
-            MachInfo::setKernelWriting(false, KernelPatcher::kernelWriteLock);
+            session.fill(logEnableMaskMinors, 0xFF, 0x80);    // Enable all DalDmLogger logs
 
             // Enable all Display Core and BiosParserHelper logs
             const LookupPatchPlus patches[] = {
@@ -94,10 +95,12 @@ bool X6000FB::processKext(KernelPatcher &patcher, size_t id, mach_vm_address_t s
                 {&kextRadeonX6000Framebuffer, kBiosParserHelperInitWithDataOriginal,
                     kBiosParserHelperInitWithDataPatched, 1},
             };
-            PANIC_COND(!LookupPatchPlus::applyAll(patcher, patches, slide, size), "X6000FB",
+            PANIC_COND(!LookupPatchPlus::stageAll(session, patches, slide, size), "X6000FB",
                 "Failed to apply debug enablement patches");
         }
 
+        PANIC_COND(!session.commit(patcher), "X6000FB", "Failed to commit patches");
+
         return true;
     }
 
@@ -1,19 +1,22 @@
 #!/bin/sh
 
 target_file="${PROJECT_DIR}/NootRX/Firmware.cpp"
-if [ -f "$target_file" ]; then
-    rm -f "$target_file"
-fi
 while [ $# -gt 0 ];
 do
     case $1 in
         -P) fw_files=$2
             shift
         ;;
+        -C) fw_flags="${fw_flags} --compress"
+        ;;
+        -D) fw_flags="${fw_flags} --delta"
+        ;;
+        -I) fw_flags="${fw_flags} --incbin"
+        ;;
 
     esac
     shift
 done
 
 script_file="${PROJECT_DIR}/Scripts/GenerateFirmware.py"
-python3 "${script_file}" "${target_file}" "${fw_files}"
+python3 "${script_file}" "${target_file}" "${fw_files}" ${fw_flags}
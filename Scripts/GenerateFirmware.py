@@ -3,13 +3,50 @@
 # Copyright © 2022-2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
 # See LICENSE for details.
 
+# Usage: GenerateFirmware.py <target file> <firmware directory> [--compress] [--delta] [--incbin] [--report]
+# --compress stores binary blobs as zlib streams when that saves at least an eighth of their size.
+# --delta stores the Navi 22/23 variant of a blob as a patch against the Navi 21 one when that is smaller.
+# --incbin leaves the payloads out of the C++ file and pulls them into the assembly file next to it with `.incbin`,
+# straight from the firmware directory or from the `Blobs` directory next to it for compressed and patched ones.
+# --report prints the stored size of each blob and the host inflate throughput.
+# Byte-identical blobs are stored once and every name points at the same array; the duplicates are always listed.
+# Outputs are only rewritten when their contents change, and a manifest of the input hashes next to the target skips
+# generation entirely when neither the blobs, the options nor this script changed and the payloads the last run stored
+# in the `Blobs` directory are intact.
+
+import hashlib
+import json
 import os
+import re
 import sys
+import time
+import zlib
 
 header = """#include "Firmware.hpp"
 
-#define A(N, D) static const UInt8 N[] = D 
+#define A(N, L, D) alignas(FWAlignment) static const UInt8 N[(L + FWAlignment - 1) / FWAlignment * FWAlignment] = D
+#define E(N) extern "C" const UInt8 N[]
 #define F(N, D, L) {.name = N, .metadata = {.data = D, .length = L}}
+#define Z(N, D, L, C) {.name = N, .metadata = {.data = D, .length = L, .compressedLength = C}}
+#define P(N, D, L, B) {.name = N, .metadata = {.data = D, .length = L, .base = &firmware[B].metadata}}
+"""
+
+# Every payload starts on a boundary of this many bytes and is padded up to the next one. Must match `FWAlignment`,
+# which the generated file checks.
+alignment = 64
+
+asm_header = """// Generated by Scripts/GenerateFirmware.py, do not edit.
+
+#ifdef __APPLE__
+#define SYMBOL(N) _##N
+#define HIDDEN .private_extern
+    .section __TEXT,__const
+#else
+#define SYMBOL(N) N
+#define HIDDEN .hidden
+    .section .note.GNU-stack, "", @progbits
+    .section .rodata
+#endif
 """
 
 special_chars = {
@@ -55,32 +92,336 @@ def is_file_text(name: str) -> bool:
     return not name.endswith(".dat") and not name.endswith(".bin")
 
 
-def process_files(target_file, dir):
+# FNV-1a, must match `getFWNameHash`.
+def fw_name_hash(name: str) -> int:
+    value = 0xCBF29CE484222325
+    for b in name.encode():
+        value = ((value ^ b) * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+    return value
+
+
+# Must match `getFWSlot`.
+def fw_slot(hash: int, seed: int, count: int) -> int:
+    value = (hash & 0xFFFFFFFF) ^ seed
+    value ^= value >> 16
+    value = (value * 0x85EBCA6B) & 0xFFFFFFFF
+    value ^= value >> 13
+    value = (value * 0xC2B2AE35) & 0xFFFFFFFF
+    value ^= value >> 16
+    return value % count
+
+
+# Hash and displace: names are put in buckets by the upper half of their hash, then each bucket, biggest first,
+# gets the first seed that moves all of its names into free slots. Returns the seeds and the name of each slot.
+def build_perfect_hash(names):
+    count = len(names)
+    seed_count = max(1, count // 2)
+    buckets = [[] for _ in range(seed_count)]
+    for name in names:
+        buckets[(fw_name_hash(name) >> 32) % seed_count].append(name)
+
+    seeds = [0] * seed_count
+    slots = [None] * count
+    for bucket in sorted(range(seed_count), key=lambda v: -len(buckets[v])):
+        if not buckets[bucket]:
+            break
+        hashes = [fw_name_hash(name) for name in buckets[bucket]]
+        for seed in range(1 << 32):
+            taken = [fw_slot(hash, seed, count) for hash in hashes]
+            if len(set(taken)) == len(taken) and all(slots[v] is None for v in taken):
+                break
+        seeds[bucket] = seed
+        for name, slot in zip(buckets[bucket], taken):
+            slots[slot] = name
+    return seeds, slots
+
+
+# Text blobs are handed out by pointer, so only binaries that copy through `FWMetadata::copyTo` are compressed.
+def compress_blob(data):
+    compressed = zlib.compress(data, 9)
+    return compressed if len(compressed) <= len(data) - len(data) // 8 else None
+
+
+# Variants of a blob for sibling ASICs share a family. The shortest name, the Navi 21 one, is the delta baseline.
+def pick_delta_bases(names):
+    families = {}
+    for name in names:
+        family = re.sub(r"^(gc_10_3|sdma_5_2)_[24]_", r"\1_", name)
+        families.setdefault(re.sub(r"navi2[123]", "navi2x", family), []).append(name)
+    bases = {}
+    for members in families.values():
+        base = min(members, key=lambda v: (len(v), v))
+        bases.update({name: base for name in members if name != base})
+    return bases
+
+
+def encode_leb128(value):
+    out = bytearray()
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+    return out
+
+
+def decode_leb128(data, off):
+    value = shift = 0
+    while True:
+        value |= (data[off] & 0x7F) << shift
+        shift += 7
+        off += 1
+        if data[off - 1] < 0x80:
+            return value, off
+
+
+# Runs of a LEB128 count of unchanged bytes, a LEB128 length and that many bytes to XOR into the base, ended by an
+# empty run. Runs less than 3 bytes apart are merged, as a new run header costs at least 2. Must match `applyDelta`.
+def encode_delta(data, base):
+    if len(data) != len(base):
+        return None
+    diff = bytes(a ^ b for a, b in zip(data, base))
+    runs = []
+    for i, b in enumerate(diff):
+        if not b:
+            continue
+        if runs and i - runs[-1][1] < 3:
+            runs[-1][1] = i + 1
+        else:
+            runs.append([i, i + 1])
+    patch = bytearray()
+    off = 0
+    for start, end in runs:
+        patch += encode_leb128(start - off) + encode_leb128(end - start) + diff[start:end]
+        off = end
+    return bytes(patch + encode_leb128(0) + encode_leb128(0))
+
+
+def apply_delta(base, patch):
+    out = bytearray(base)
+    off = i = 0
+    while True:
+        skip, i = decode_leb128(patch, i)
+        count, i = decode_leb128(patch, i)
+        if not count:
+            return bytes(out)
+        off += skip
+        for k in range(count):
+            out[off + k] ^= patch[i + k]
+        off += count
+        i += count
+
+
+def time_inflate(compressed):
+    best = None
+    for _ in range(5):
+        start = time.perf_counter()
+        zlib.decompress(compressed)
+        elapsed = time.perf_counter() - start
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+
+def print_report(report):
+    print(f"{'name':<52}{'length':>10}{'stored':>10}{'ratio':>7}{'inflate':>11}{'MB/s':>8}  delta base")
+    total_len = total_stored = total_time = 0
+    for name, length, stored, compressed, base, shared in sorted(report):
+        stored = 0 if shared else stored
+        total_len += length
+        total_stored += stored
+        line = f"{name:<52}{length:>10}{stored:>10}{stored / length:>7.2f}"
+        if compressed and not shared:
+            elapsed = time_inflate(compressed)
+            total_time += elapsed
+            line += f"{elapsed * 1e6:>9.0f}us{length / elapsed / 1e6:>8.0f}"
+        elif base:
+            line += f"{'':>19}  {base}"
+        print(line)
+    print(f"{'total':<52}{total_len:>10}{total_stored:>10}{total_stored / total_len:>7.2f}{total_time * 1e6:>9.0f}us")
+
+
+# Leaves the file and its timestamp alone when it already has these contents, so the build doesn't redo its users.
+def write_if_changed(path, data):
+    if os.path.exists(path):
+        with open(path, "rb") as file:
+            if file.read() == data:
+                return False
+    with open(path, "wb") as file:
+        file.write(data)
+    return True
+
+
+repo_dir = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def sha256_file(path):
+    with open(path, "rb") as file:
+        return hashlib.sha256(file.read()).hexdigest()
+
+
+# The outputs match the inputs in `manifest` if the previous run recorded the same ones, and if the payloads it stored
+# in the blob directory and included from the assembly file are all still there, as they are build products that can
+# be deleted or left half written on their own.
+def is_up_to_date(target_file, asm_file, manifest_file, blob_dir, manifest, paths):
+    if not all(os.path.exists(v) for v in (target_file, asm_file, manifest_file)):
+        return False
+    try:
+        with open(manifest_file, "rb") as file:
+            previous = json.load(file)
+    except ValueError:
+        return False
+    stored = previous.pop("stored", None)
+    if previous != manifest or not isinstance(stored, dict):
+        return False
+    for file, digest in stored.items():
+        path = os.path.join(blob_dir, file)
+        if not os.path.isfile(path) or sha256_file(path) != digest:
+            return False
+    if manifest["options"]["incbin"]:
+        expected = {os.path.abspath(os.path.join(blob_dir, v)) if v in stored else paths[v] for v in paths}
+        with open(asm_file, "r") as file:
+            included = set(re.findall(r'^\s*\.incbin "(.*)"$', file.read(), re.MULTILINE))
+        # Duplicates aren't included, so every inclusion has to be one of this checkout's payloads.
+        if not included or not included <= expected:
+            return False
+    return True
+
+
+def process_files(target_file, dir, compress=False, delta=False, incbin=False, report=False):
     os.makedirs(os.path.dirname(target_file), exist_ok=True)
-    lines = header.splitlines(keepends=True) + ["\n"]
-    file_list_content = []
+    asm_file = os.path.splitext(target_file)[0] + ".S"
+    manifest_file = os.path.splitext(target_file)[0] + ".manifest"
+    lines = header.splitlines(keepends=True) + [
+        "\n",
+        f'static_assert(FWAlignment == {alignment}, "Generated for another alignment");\n',
+        "\n",
+    ]
+    # Always written, so the project can list it whichever mode generated the C++ file.
+    asm_lines = asm_header.splitlines(keepends=True) + ["\n"]
+    blob_dir = os.path.splitext(target_file)[0] + "Blobs"
+    if incbin:
+        os.makedirs(blob_dir, exist_ok=True)
+    paths = {}
+    blobs = {}
+    stored_blobs = {}
+    blob_report = []
+    payloads = {}
+    duplicates = []
     files = filter(
         lambda v: not is_file_excluded(os.path.basename(v[1])),
         [(root, file) for root, _, files in os.walk(dir) for file in files],
     )
-    for root, file in files:
-        with open(os.path.join(root, file), "rb") as src_file:
-            src_data = src_file.read()
-            src_len = len(src_data)
+    for root, file in sorted(files, key=lambda v: v[1]):
+        assert file not in blobs, f"Duplicate firmware name {file}"
+        paths[file] = os.path.abspath(os.path.join(root, file))
+        with open(paths[file], "rb") as src_file:
+            blobs[file] = src_file.read()
+
+    with open(__file__, "rb") as script_file:
+        script_hash = hashlib.sha256(script_file.read()).hexdigest()
+    # Relative to the repository, so that the manifest of a checkout doesn't change when it's moved.
+    manifest = {
+        "generator": script_hash,
+        "options": {"compress": compress, "delta": delta, "incbin": incbin},
+        "blobs": {
+            file: [os.path.relpath(paths[file], repo_dir), hashlib.sha256(data).hexdigest()]
+            for file, data in blobs.items()
+        },
+    }
+    if not report and is_up_to_date(target_file, asm_file, manifest_file, blob_dir, manifest, paths):
+        print(f"Firmware: {len(blobs)} blobs up to date")
+        return
+
+    bases = pick_delta_bases(blobs) if delta else {}
+    descriptors = {}
+    # Baselines go first, so a variant identical to its baseline is deduplicated rather than patched.
+    for file in sorted(blobs, key=lambda v: (v in bases, v)):
+        src_data = blobs[file]
         is_text = is_file_text(os.path.basename(file))
-        var_ident = file.replace(".", "_").replace("-", "_")
-        var_contents = bytes_to_cstr(src_data, is_text)
-        lines.append(f"A({var_ident}, {var_contents});\n")
-        var_len = src_len + 1 if is_text else src_len  # NUL Byte
-        file_list_content.append(f'    F("{file}", {var_ident}, 0x{var_len:X}),\n')
+        var_len = len(src_data) + 1 if is_text else len(src_data)  # NUL Byte
+        # Text and binary payloads are encoded differently, so they are never shared with each other.
+        key = (manifest["blobs"][file][1], is_text)
+        shared = key in payloads
+        if shared:
+            var_ident, original, stored, compressed, base = payloads[key]
+            duplicates.append((file, original, stored))
+        else:
+            compressed = compress_blob(src_data) if compress and not is_text else None
+            patch = encode_delta(src_data, blobs[bases[file]]) if file in bases and not is_text else None
+            if patch and len(patch) < len(compressed or src_data):
+                assert apply_delta(blobs[bases[file]], patch) == src_data, f"Delta of {file} does not round-trip"
+                compressed, base = None, bases[file]
+            else:
+                patch, base = None, None
+            stored = len(patch or compressed or src_data)
+            var_ident = file.replace(".", "_").replace("-", "_")
+            if incbin:
+                var_ident = f"firmware_{var_ident}"
+                lines.append(f"E({var_ident});\n")
+                path = paths[file]
+                if patch or compressed:
+                    path = os.path.abspath(os.path.join(blob_dir, file))
+                    write_if_changed(path, patch or compressed)
+                    stored_blobs[file] = hashlib.sha256(patch or compressed).hexdigest()
+                assert '"' not in path and "\\" not in path, f"Cannot include {path}"
+                # The build can't see into `.incbin`, so the hash makes a changed payload change this file too.
+                asm_lines += [
+                    f"// {file} sha256 {manifest['blobs'][file][1]}\n",
+                    f"    .globl SYMBOL({var_ident})\n",
+                    f"    HIDDEN SYMBOL({var_ident})\n",
+                    f"    .p2align {alignment.bit_length() - 1}\n",
+                    f"SYMBOL({var_ident}):\n",
+                    f'    .incbin "{path}"\n',
+                ]
+                if is_text:
+                    asm_lines.append("    .byte 0\n")
+                asm_lines.append(f"    .p2align {alignment.bit_length() - 1}\n")
+            else:
+                var_contents = bytes_to_cstr(patch or compressed or src_data, is_text)
+                # The literal's NUL byte is part of the array for binaries too.
+                lines.append(f"A({var_ident}, 0x{stored + 1:X}, {var_contents});\n")
+            payloads[key] = (var_ident, file, stored, compressed, base)
+        descriptors[file] = (var_ident, var_len, compressed, base)
+        blob_report.append((file, var_len, stored, compressed, base, shared))
 
+    seeds, slots = build_perfect_hash(list(descriptors))
+    slot_of = {name: slot for slot, name in enumerate(slots)}
     lines.append("\nconst struct FWDescriptor firmware[] = {\n")
-    lines += file_list_content
-    lines += ["};\n", f"const size_t firmwareCount = {len(file_list_content)};\n"]
+    for name in slots:
+        var_ident, var_len, compressed, base = descriptors[name]
+        if base:
+            lines.append(f'    P("{name}", {var_ident}, 0x{var_len:X}, {slot_of[base]}),\n')
+        elif compressed:
+            lines.append(f'    Z("{name}", {var_ident}, 0x{var_len:X}, 0x{len(compressed):X}),\n')
+        else:
+            lines.append(f'    F("{name}", {var_ident}, 0x{var_len:X}),\n')
+    lines += ["};\n", f"const size_t firmwareCount = {len(slots)};\n"]
+    lines.append("\nconst UInt32 firmwareSeeds[] = {\n")
+    lines += [f"    0x{seed:X},\n" for seed in seeds]
+    lines += ["};\n", f"const size_t firmwareSeedCount = {len(seeds)};\n"]
+
+    updated = [
+        os.path.basename(path)
+        for path, contents in ((target_file, lines), (asm_file, asm_lines))
+        if write_if_changed(path, "".join(contents).encode())
+    ]
+    if os.path.isdir(blob_dir):
+        for stale in set(os.listdir(blob_dir)) - set(stored_blobs):
+            os.remove(os.path.join(blob_dir, stale))
+    manifest["stored"] = stored_blobs
+    write_if_changed(manifest_file, (json.dumps(manifest, indent=4, sort_keys=True) + "\n").encode())
 
-    with open(target_file, "w") as file:
-        file.writelines(lines)
+    saved = sum(size for _, _, size in duplicates)
+    print(f"Firmware: {len(descriptors)} blobs, {len(payloads)} unique payloads, {saved} bytes deduplicated")
+    print(f"  updated: {', '.join(updated) or 'nothing'}")
+    for name, original, size in duplicates:
+        print(f"  {name} -> {original} ({size} bytes)")
+
+    if report:
+        print_report(blob_report)
 
 
 if __name__ == "__main__":
-    process_files(sys.argv[1], sys.argv[2])
+    flags = sys.argv[3:]
+    process_files(
+        sys.argv[1], sys.argv[2], "--compress" in flags, "--delta" in flags, "--incbin" in flags, "--report" in flags
+    )
@@ -0,0 +1,227 @@
+#!/usr/bin/python3
+
+# Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+# See LICENSE for details.
+
+# Resolves the patterns declared in the kext headers against a directory of known kext binaries
+# and writes the offsets into NootRX/OffsetDB.cpp, keyed by each binary's LC_UUID.
+# The call site patterns `CallSiteRedirect` assembles at run time are rebuilt from the tables in the sources.
+# Every pattern that doesn't end up in the database is reported, OffsetCache learns those on the first boot.
+# Usage: GenerateOffsetDB.py <target file> [binary directory]
+
+import os
+import re
+import struct
+import sys
+
+header = """// Generated by Scripts/GenerateOffsetDB.py, do not edit.
+
+#include "OffsetDB.hpp"
+
+"""
+
+pattern_headers = ["HWLibs.hpp", "X6000FB.hpp", "X6000.hpp", "NootRX.hpp"]
+call_site_sources = ["HWLibs.cpp"]
+
+array_re = re.compile(r"static const UInt8 (k\w+)\[\] = (\{[^}]*\}|\"(?:[^\"\\]|\\.)*\");", re.S)
+byte_pattern_re = re.compile(r"static constexpr auto (k\w+)\s*=\s*BYTE_PATTERN\(((?:\s*\"[^\"]*\")+)\);", re.S)
+stem_re = re.compile(r"^(.*?(?:Pattern|Original))(\w*)$")
+shapes_re = re.compile(r"const CallSiteShape (\w+)\[\] = \{(.*?)\};", re.S)
+shape_re = re.compile(r"\{\s*(k\w+),\s*k\w+,\s*(\d+),\s*\d+\s*\}")
+redirects_re = re.compile(r"const CallSiteRedirect \w+\[\] = \{(.*?)\};\s*[^;]*?stageAll\(\w+, (\w+),", re.S)
+redirect_re = re.compile(r"\{\s*(0x[0-9A-Fa-f]+),\s*(0x[0-9A-Fa-f]+),\s*\w+\s*\}")
+
+MH_MAGIC_64 = 0xFEEDFACF
+FAT_MAGIC = 0xCAFEBABE
+CPU_TYPE_X86_64 = 0x01000007
+LC_SEGMENT_64 = 0x19
+LC_UUID = 0x1B
+
+FNV_OFFSET_BASIS = 0xCBF29CE484222325
+FNV_PRIME = 0x100000001B3
+
+
+def fnv1a(data: bytes, value=FNV_OFFSET_BASIS) -> int:
+    for b in data:
+        value = ((value ^ b) * FNV_PRIME) & 0xFFFFFFFFFFFFFFFF
+    return value
+
+
+# Must match `OffsetCache::hashPattern`.
+def hash_pattern(pattern: bytes, mask: bytes) -> int:
+    value = fnv1a(struct.pack("<Q", len(pattern)))
+    for p, m in zip(pattern, mask):
+        value = fnv1a(bytes([p & m, m]), value)
+    return value
+
+
+def parse_array(body: str) -> bytes:
+    if body.startswith('"'):
+        return body[1:-1].encode().decode("unicode_escape").encode("latin-1") + b"\0"
+    return bytes(int(v, 0) for v in body.strip("{}").replace("\n", " ").split(",") if v.strip())
+
+
+# Must match `parseBytePattern`, returns the pattern and its mask.
+def parse_byte_pattern(body: str):
+    pattern, mask = bytearray(), bytearray()
+    for token in "".join(re.findall(r"\"([^\"]*)\"", body)).split():
+        if token == "?":
+            token = "??"
+        pattern.append(int(token.replace("?", "0"), 16))
+        mask.append(int("".join("0" if v == "?" else "F" for v in token), 16))
+    return bytes(pattern), bytes(mask)
+
+
+def load_arrays(source_dir):
+    arrays = {}
+    for name in pattern_headers:
+        with open(os.path.join(source_dir, name)) as file:
+            contents = file.read()
+        arrays.update((m.group(1), parse_array(m.group(2))) for m in array_re.finditer(contents))
+        for m in byte_pattern_re.finditer(contents):
+            pattern, mask = parse_byte_pattern(m.group(2))
+            arrays[m.group(1)] = pattern
+            arrays[f"{m.group(1)}#Mask"] = mask
+    return arrays
+
+
+def load_patterns(source_dir):
+    arrays = load_arrays(source_dir)
+    patterns = []
+    for name, data in arrays.items():
+        match = stem_re.match(name)
+        if match is None or "Mask" in match.group(2):
+            continue
+        stem, suffix = match.groups()
+        mask_names = [f"{name}#Mask", f"{stem}Mask{suffix}"]
+        if "Pattern" in stem:
+            mask_names.append(stem.replace("Pattern", "Mask") + suffix)
+        mask = next((arrays[v] for v in mask_names if v in arrays), b"\xFF" * len(data))
+        assert len(mask) == len(data), name
+        patterns.append((name, data, mask))
+    return patterns + load_call_sites(source_dir, arrays)
+
+
+# Must match `CallSiteRedirect::stageAll`, which writes the masked immediate into a copy of the shape.
+def load_call_sites(source_dir, arrays):
+    patterns, seen = [], set()
+    for name in call_site_sources:
+        with open(os.path.join(source_dir, name)) as file:
+            contents = file.read()
+        shapes = {m.group(1): shape_re.findall(m.group(2)) for m in shapes_re.finditer(contents)}
+        for table in redirects_re.finditer(contents):
+            for immediate, immediate_mask in redirect_re.findall(table.group(1)):
+                immediate, immediate_mask = int(immediate, 16), int(immediate_mask, 16)
+                for shape, offset in shapes.get(table.group(2), []):
+                    pattern, mask = bytearray(arrays[shape]), bytearray(arrays[f"{shape}#Mask"])
+                    for i in range(4):
+                        value, value_mask = (immediate >> (i * 8)) & 0xFF, (immediate_mask >> (i * 8)) & 0xFF
+                        pattern[int(offset) + i] = (pattern[int(offset) + i] & ~value_mask) | (value & value_mask)
+                        mask[int(offset) + i] |= value_mask
+                    if (bytes(pattern), bytes(mask)) not in seen:
+                        seen.add((bytes(pattern), bytes(mask)))
+                        patterns.append((f"{shape}({immediate:#010x})", bytes(pattern), bytes(mask)))
+    return patterns
+
+
+def get_slice(data: bytes) -> bytes:
+    if struct.unpack_from(">I", data)[0] == FAT_MAGIC:
+        for i in range(struct.unpack_from(">I", data, 4)[0]):
+            cpu, _, offset, size, _ = struct.unpack_from(">iiIII", data, 8 + i * 20)
+            if cpu == CPU_TYPE_X86_64:
+                return data[offset : offset + size]
+        return b""
+    return data
+
+
+# Lays the segments out the way they are mapped, offsets are relative to the segment holding the header.
+def load_image(data: bytes):
+    if len(data) < 32 or struct.unpack_from("<I", data)[0] != MH_MAGIC_64:
+        return None, None
+    ncmds = struct.unpack_from("<I", data, 16)[0]
+    segments, uuid, cursor = [], None, 32
+    for _ in range(ncmds):
+        cmd, size = struct.unpack_from("<II", data, cursor)
+        if cmd == LC_UUID:
+            uuid = data[cursor + 8 : cursor + 24]
+        elif cmd == LC_SEGMENT_64:
+            name = data[cursor + 8 : cursor + 24].rstrip(b"\0").decode()
+            vmaddr, vmsize, fileoff, filesize = struct.unpack_from("<QQQQ", data, cursor + 24)
+            if name != "__LINKEDIT":
+                segments.append((vmaddr, vmsize, fileoff, filesize))
+        cursor += size
+    base = next((v[0] for v in segments if v[2] == 0 and v[3] != 0), None)
+    if uuid is None or base is None:
+        return None, None
+    image = bytearray(max(v[0] - base + v[1] for v in segments))
+    for vmaddr, _, fileoff, filesize in segments:
+        image[vmaddr - base : vmaddr - base + filesize] = data[fileoff : fileoff + filesize]
+    return uuid, bytes(image)
+
+
+def find_all(image: bytes, pattern: bytes, mask: bytes, limit=2):
+    # Anchor on the longest fully masked run, then verify the whole pattern.
+    runs = re.finditer(b"(?:\xFF)+", mask)
+    run = max(runs, key=lambda v: v.end() - v.start(), default=None)
+    if run is None:
+        return []
+    needle, shift = pattern[run.start() : run.end()], run.start()
+    found, pos = [], image.find(needle)
+    while pos != -1 and len(found) < limit:
+        start = pos - shift
+        if start >= 0 and start + len(pattern) <= len(image):
+            window = image[start : start + len(pattern)]
+            if all((w & m) == (p & m) for w, p, m in zip(window, pattern, mask)):
+                found.append(start)
+        pos = image.find(needle, pos + 1)
+    return found
+
+
+def process_binaries(target_file, binary_dir):
+    source_dir = os.path.dirname(target_file)
+    patterns = load_patterns(source_dir)
+    builds = []
+    files = (
+        sorted(os.path.join(root, file) for root, _, files in os.walk(binary_dir) for file in files)
+        if binary_dir
+        else []
+    )
+    for path in files:
+        with open(path, "rb") as file:
+            uuid, image = load_image(get_slice(file.read()))
+        if uuid is None or any(v[0] == uuid for v in builds):
+            continue
+        entries, missing = {}, []
+        for name, pattern, mask in patterns:
+            found = find_all(image, pattern, mask)
+            # Only unique matches are stored, anything else could disagree with the runtime search order.
+            if len(found) == 1 and found[0] != 0:
+                entries[hash_pattern(pattern, mask)] = found[0]
+            else:
+                missing.append(f"{name} ({'ambiguous' if found else 'not found'})")
+        if entries:
+            builds.append((uuid, os.path.basename(path), sorted(entries.items())))
+        print(f"{os.path.basename(path)} {uuid.hex().upper()}: {len(entries)}/{len(patterns)} patterns")
+        for name in missing:
+            print(f"    not covered: {name}")
+    if not builds:
+        print(f"No kext binaries given, none of the {len(patterns)} patterns are covered", file=sys.stderr)
+
+    lines = [header]
+    for i, (uuid, name, entries) in enumerate(builds):
+        lines.append(f"// {name}\nstatic const OffsetDBEntry build{i}[] = {{\n")
+        lines += [f"    {{0x{k:016X}, 0x{v:X}}},\n" for k, v in entries]
+        lines.append("};\n\n")
+
+    lines.append("const OffsetDBBuild offsetDB[] = {\n")
+    for i, (uuid, _, entries) in enumerate(builds):
+        uuid_bytes = ", ".join(f"0x{v:02X}" for v in uuid)
+        lines.append(f"    {{{{{uuid_bytes}}},\n        build{i}, {len(entries)}}},\n")
+    lines += ["    {},\n", "};\n", f"const size_t offsetDBCount = {len(builds)};\n"]
+
+    with open(target_file, "w") as file:
+        file.writelines(lines)
+
+
+if __name__ == "__main__":
+    process_binaries(sys.argv[1], sys.argv[2] if len(sys.argv) > 2 else None)
@@ -0,0 +1,102 @@
+#!/usr/bin/python3
+
+# Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+# See LICENSE for details.
+
+# Searches a directory of dyld shared cache files for the patterns `DYLDPatches` applies to the shared cache
+# and writes the pages holding them into NootRX/SharedCacheIndex.cpp, keyed by the UUID of each file.
+# Sub-caches are separate files with their own UUID and are indexed like any other.
+# Usage: GenerateSharedCacheIndex.py <target file> [cache directory]
+
+import mmap
+import os
+import re
+import struct
+import sys
+
+header = """// Generated by Scripts/GenerateSharedCacheIndex.py, do not edit.
+
+#include "SharedCacheIndex.hpp"
+
+"""
+
+pattern_header = "DYLDPatches.hpp"
+# Everything `DYLDPatches::patchSharedCachePage` searches for.
+pattern_names = ["kVideoToolboxDRMModelOriginal"]
+
+array_re = re.compile(r"static const (?:UInt8|char) (k\w+)\[\] = (\{[^}]*\}|\"(?:[^\"\\]|\\.)*\");", re.S)
+
+CACHE_MAGIC = b"dyld_v1"
+# Must match `SharedCacheUUIDOffset`.
+UUID_OFFSET = 0x58
+# Must match `PAGE_SIZE`.
+PAGE_SIZE = 0x1000
+
+
+def parse_array(body: str) -> bytes:
+    if body.startswith('"'):
+        return body[1:-1].encode().decode("unicode_escape").encode("latin-1") + b"\0"
+    return bytes(int(v, 0) for v in body.strip("{}").replace("\n", " ").split(",") if v.strip())
+
+
+def load_patterns(source_dir):
+    with open(os.path.join(source_dir, pattern_header)) as file:
+        arrays = {m.group(1): parse_array(m.group(2)) for m in array_re.finditer(file.read())}
+    return [(name, arrays[name]) for name in pattern_names]
+
+
+# Only matches that fit in one page count, the runtime never sees the rest of a match that crosses a page.
+def find_pages(data, pattern: bytes):
+    pages, pos = set(), data.find(pattern)
+    while pos != -1:
+        if pos // PAGE_SIZE == (pos + len(pattern) - 1) // PAGE_SIZE:
+            pages.add(pos // PAGE_SIZE)
+        pos = data.find(pattern, pos + 1)
+    return pages
+
+
+def process_caches(target_file, cache_dir):
+    patterns = load_patterns(os.path.dirname(target_file))
+    caches = []
+    files = (
+        sorted(os.path.join(root, file) for root, _, files in os.walk(cache_dir) for file in files)
+        if cache_dir
+        else []
+    )
+    for path in files:
+        if os.path.getsize(path) < UUID_OFFSET + 16:
+            continue
+        with open(path, "rb") as file, mmap.mmap(file.fileno(), 0, access=mmap.ACCESS_READ) as data:
+            if data[: len(CACHE_MAGIC)] != CACHE_MAGIC:
+                continue
+            uuid = data[UUID_OFFSET : UUID_OFFSET + 16]
+            if any(v[0] == uuid for v in caches):
+                continue
+            pages = set()
+            for _, pattern in patterns:
+                pages |= find_pages(data, pattern)
+        # Files without a match are kept too, every one of their pages can then be skipped.
+        caches.append((uuid, os.path.basename(path), sorted(pages)))
+        print(f"{os.path.basename(path)} {uuid.hex().upper()}: {len(pages)} page(s)")
+
+    lines = [header]
+    for i, (uuid, name, pages) in enumerate(caches):
+        if not pages:
+            continue
+        lines.append(f"// {name}\nstatic const UInt32 cache{i}[] = {{\n")
+        lines += [f"    0x{v:X},\n" for v in pages]
+        lines.append("};\n\n")
+
+    lines.append("const SharedCacheIndex sharedCacheIndex[] = {\n")
+    for i, (uuid, name, pages) in enumerate(caches):
+        uuid_bytes = ", ".join(f"0x{v:02X}" for v in uuid)
+        array = f"cache{i}" if pages else "nullptr"
+        lines.append(f"    {{{{{uuid_bytes}}},\n        {array}, {len(pages)}}},    // {name}\n")
+    lines += ["    {},\n", "};\n", f"const size_t sharedCacheIndexCount = {len(caches)};\n"]
+
+    with open(target_file, "w") as file:
+        file.writelines(lines)
+
+
+if __name__ == "__main__":
+    process_caches(sys.argv[1], sys.argv[2] if len(sys.argv) > 2 else None)
@@ -0,0 +1,55 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "BytePattern.hpp"
+#include "Test.hpp"
+
+static constexpr auto kNibbles = BYTE_PATTERN("4? ?4 ?? 7F");
+static constexpr auto kExact = BYTE_PATTERN("48 8B 7F");
+
+// A 9-byte run, a wildcard, then a 40-byte run of 0x00 to 0x27.
+static constexpr auto kTwoRuns = BYTE_PATTERN("E8 E8 E8 E8 E8 E8 E8 E8 E8 ?? "
+                                              "00 01 02 03 04 05 06 07 08 09 0A 0B 0C 0D 0E 0F 10 11 12 13 "
+                                              "14 15 16 17 18 19 1A 1B 1C 1D 1E 1F 20 21 22 23 24 25 26 27");
+
+static constexpr auto kShortRun = BYTE_PATTERN("00 01 02 03 04 05 06 07 08 09 0A 0B 0C 0D 0E 0F "
+                                               "10 11 12 13 14 15 16 17 18 19 1A 1B 1C 1D 1E ?? 1F");
+static constexpr auto kLongRun = BYTE_PATTERN("00 01 02 03 04 05 06 07 08 09 0A 0B 0C 0D 0E 0F "
+                                              "10 11 12 13 14 15 16 17 18 19 1A 1B 1C 1D 1E 1F ??");
+
+TEST(parsesNibbleWildcards) {
+    static_assert(kNibbles.size() == 4);
+    const UInt8 pattern[] = {0x40, 0x04, 0x00, 0x7F};
+    const UInt8 mask[] = {0xF0, 0x0F, 0x00, 0xFF};
+    CHECK(!memcmp(kNibbles.pattern, pattern, sizeof(pattern)));
+    REQUIRE(kNibbles.getMask() != nullptr);
+    CHECK(!memcmp(kNibbles.getMask(), mask, sizeof(mask)));
+    CHECK(kExact.getMask() == nullptr);
+}
+
+TEST(panicsOnInvalidCharacters) {
+    CHECK(panics([] { keep(parseBytePattern<2, false>("48 4G")); }));
+    CHECK(panics([] { keep(parseBytePattern<2, false>("48 ???")); }));
+    CHECK(panics([] { keep(parseBytePattern<2, false>("48 8")); }));
+    CHECK(!panics([] { keep(parseBytePattern<2, false>("48 8b")); }));
+}
+
+TEST(buildsTheSkipTableFromTheLongestRun) {
+    auto *table = kTwoRuns.getSkipTable();
+    REQUIRE(table != nullptr);
+    CHECK(table->runOffset == 10);
+    CHECK(table->runSize == 40);
+    CHECK(table->shifts[0x00] == 39);
+    CHECK(table->shifts[0x26] == 1);
+    // The last byte of the run and anything not in it shift by the whole run.
+    CHECK(table->shifts[0x27] == 40);
+    CHECK(table->shifts[0xE8] == 40);
+}
+
+TEST(onlyLongRunsCarryASkipTable) {
+    static_assert(sizeof(kShortRun) < sizeof(PatternSkipTable));
+    CHECK(kShortRun.getSkipTable() == nullptr);
+    CHECK(kNibbles.getSkipTable() == nullptr);
+    REQUIRE(kLongRun.getSkipTable() != nullptr);
+    CHECK(kLongRun.getSkipTable()->runSize == MaskedPatternSearch::MinSkipRun);
+}
@@ -0,0 +1,113 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "DYLDPatchesFixture.hpp"
+
+// Filled by `getSharedCacheFile` with the pages it puts the DRM model string in.
+static UInt32 indexedPages[24] {};
+const SharedCacheIndex sharedCacheIndex[] = {
+    {{0x3C, 0x9B, 0x27, 0x41, 0x8E, 0x11, 0x35, 0x5A, 0x96, 0x0D, 0x4F, 0xA2, 0x71, 0xC8, 0x05, 0xEE}, indexedPages,
+        arrsize(indexedPages)},
+    {},
+};
+const size_t sharedCacheIndexCount = 1;
+
+static constexpr size_t PageIns = 200000;
+
+// A 64 MiB shared cache file with the DRM model string in a few pages. Every seventh byte is the first one of the
+// string, so the search has candidates to reject the way it does in real code.
+static std::vector<UInt8> getSharedCacheFile(size_t pages) {
+    std::vector<UInt8> file(pages * PAGE_SIZE);
+    TestRandom random {pages};
+    for (auto &byte : file) { byte = random.below(7) ? static_cast<UInt8>(random.next()) : 'M'; }
+    for (size_t i = 0; i < arrsize(indexedPages); i++) {
+        indexedPages[i] = static_cast<UInt32>((i + 1) * (pages / (arrsize(indexedPages) + 1)));
+        auto offset = indexedPages[i] * PAGE_SIZE + random.below(PAGE_SIZE - sizeof(kVideoToolboxDRMModelOriginal));
+        memcpy(file.data() + offset, kVideoToolboxDRMModelOriginal, sizeof(kVideoToolboxDRMModelOriginal));
+    }
+    return file;
+}
+
+// Replays page-ins of the file through the hook, three quarters of them to an eighth of the pages the way pages
+// evicted under memory pressure come back, each with its original contents.
+static void measureReplay(const char *label, long allocations, const std::vector<UInt8> &file, size_t pages) {
+    DYLDPatchesFixture fixture {allocations};
+    vnode vp {"/System/Library/dyld/dyld_shared_cache_x86_64.01", 1};
+    std::vector<UInt8> page(PAGE_SIZE);
+    TestRandom random {pages};
+    measure(label, 1, [&] {
+        for (size_t i = 0; i < PageIns; i++) {
+            auto index = random.below(4) ? random.below(pages / 8) : random.below(pages);
+            memcpy(page.data(), file.data() + index * PAGE_SIZE, PAGE_SIZE);
+            fixture.validate(&vp, index * PAGE_SIZE, page.data());
+        }
+    });
+}
+
+// Every page of the file validated once, as when it is first mapped, with its header either in the index or not.
+static void measureFirstPass(const char *label, const UInt8 *uuid, const std::vector<UInt8> &file, size_t pages) {
+    DYLDPatchesFixture fixture {};
+    vnode vp {"/System/Library/dyld/dyld_shared_cache_x86_64.01", 0};
+    std::vector<UInt8> page(PAGE_SIZE);
+    measure(label, 3, [&] {
+        // A new vid each time, so that neither the memo nor the cache indices remember the last pass.
+        vp.vid += 1;
+        for (size_t index = 0; index < pages; index++) {
+            memcpy(page.data(), file.data() + index * PAGE_SIZE, PAGE_SIZE);
+            if (!index) { memcpy(page.data() + SharedCacheUUIDOffset, uuid, sizeof(SharedCacheIndex::uuid)); }
+            fixture.validate(&vp, index * PAGE_SIZE, page.data());
+        }
+    });
+}
+
+BENCH(sharedCacheIndexFirstPass) {
+    static constexpr size_t Pages = 16384;
+    static const UInt8 unknown[16] {};
+    auto file = getSharedCacheFile(Pages);
+    printf("    %zu pages, %zu of them indexed\n", Pages, arrsize(indexedPages));
+    measureFirstPass("not in the index", unknown, file, Pages);
+    measureFirstPass("in the index", sharedCacheIndex[0].uuid, file, Pages);
+}
+
+BENCH(pageMemoReplay) {
+    static constexpr size_t Pages = 16384;
+    auto file = getSharedCacheFile(Pages);
+    printf("    %zu page-ins, 3/4 of them to 1/8 of %zu pages\n", PageIns, Pages);
+    measureReplay("searching every page", 2, file, Pages);
+    measureReplay("with the page memo", -1, file, Pages);
+}
+
+// Pages of code-like bytes that none of the patches match, the common case for every page of a patched file.
+BENCH(patchSetPagesAgainstApply) {
+    static constexpr size_t Pages = 4096;
+    static const UInt8 common[] = {0x48, 0x89, 0x8B, 0x00, 0x41, 0xE8, 0x0F, 0xFF, 0x4C, 0x24, 0x83, 0x45};
+    std::vector<UInt8> file(Pages * PAGE_SIZE);
+    TestRandom random {23};
+    for (auto &byte : file) {
+        byte = random.below(5) ? common[random.below(arrsize(common))] : static_cast<UInt8>(random.next());
+    }
+    UInt8 finds[MultiPatternScanner::MaxPatterns][8], replace[8] {};
+    std::vector<DYLDPatch> patches {};
+    for (size_t i = 0; i < MultiPatternScanner::MaxPatterns; i++) {
+        UInt8 find[] = {0xC7, 0xC0, static_cast<UInt8>(i + 1), 0x00, 0x00, 0x00, 0x0F, 0xA2};
+        memcpy(finds[i], find, sizeof(find));
+        patches.emplace_back(finds[i], replace, "Bench");
+    }
+
+    printf("    %zu pages, per walk over all of them\n", Pages);
+    for (size_t count : {1, 4, 16}) {
+        char label[64];
+        snprintf(label, sizeof(label), "%zu patches, DYLDPatch::apply each", count);
+        measure(label, 3, [&] {
+            for (size_t page = 0; page < Pages; page++) {
+                for (size_t i = 0; i < count; i++) { patches[i].apply(&file[page * PAGE_SIZE], PAGE_SIZE); }
+            }
+        });
+        DYLDPatchSet set {};
+        for (size_t i = 0; i < count; i++) { set.add(patches[i]); }
+        snprintf(label, sizeof(label), "%zu patches, DYLDPatchSet", count);
+        measure(label, 3, [&] {
+            for (size_t page = 0; page < Pages; page++) { set.apply(&file[page * PAGE_SIZE], PAGE_SIZE); }
+        });
+    }
+}
@@ -0,0 +1,78 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#pragma once
+#include "DYLDPatches.hpp"
+#include "Test.hpp"
+#include <Headers/kern_api.hpp>
+#include <Headers/kern_devinfo.hpp>
+#include <vector>
+
+// A `DYLDPatches` with its `cs_validate_page` hook routed, which pages are then validated through the way the kernel
+// would. The hook goes to the last one constructed.
+class DYLDPatchesFixture {
+    public:
+    using CsValidatePage = void (*)(vnode *vp, memory_object_t pager, memory_object_offset_t page_offset,
+        const void *data, int *validated_p, int *tainted_p, int *nx_p);
+
+    // Allocations past the first `allocations` fail, the caches are allocated in the order they are declared.
+    explicit DYLDPatchesFixture(long allocations = -1) {
+        this->patches.init();
+        KernelPatcher patcher {};
+        patcher.routeHook = route;
+        patcher.routeContext = this;
+        ioMallocFailAfter = allocations;
+        this->patches.processPatcher(patcher);
+        ioMallocFailAfter = -1;
+    }
+
+    bool isRouted() const { return this->hook != nullptr; }
+    size_t getValidations() const { return this->validations; }
+
+    void validate(vnode *vp, UInt64 offset, UInt8 *page) {
+        int validated = 0, tainted = 0, nx = 0;
+        this->hook(vp, nullptr, offset, page, &validated, &tainted, &nx);
+    }
+
+    private:
+    static inline DYLDPatchesFixture *current {nullptr};
+
+    static mach_vm_address_t route(void *context, mach_vm_address_t, mach_vm_address_t to) {
+        current = static_cast<DYLDPatchesFixture *>(context);
+        current->hook = reinterpret_cast<CsValidatePage>(to);
+        return reinterpret_cast<mach_vm_address_t>(validatePage);
+    }
+
+    // Stands in for the kernel's `cs_validate_page`, which the hook calls first.
+    static void validatePage(vnode *, memory_object_t, memory_object_offset_t, const void *, int *validated_p, int *,
+        int *) {
+        current->validations += 1;
+        *validated_p = 1;
+    }
+
+    DYLDPatches patches {};
+    CsValidatePage hook {nullptr};
+    size_t validations {0};
+};
+
+// How much of `kVideoToolboxDRMModelOriginal` the model identifier is written over.
+static constexpr size_t DRMModelPatchedSize = 20;
+
+// A page of a shared cache file, with the DRM model string at `match` unless that is `NoDRMModel`.
+static constexpr size_t NoDRMModel = ~static_cast<size_t>(0);
+
+inline std::vector<UInt8> getSharedCachePage(UInt64 seed, size_t match) {
+    std::vector<UInt8> page(PAGE_SIZE);
+    TestRandom random {seed};
+    for (auto &byte : page) { byte = static_cast<UInt8>(random.next()); }
+    if (match != NoDRMModel) {
+        memcpy(page.data() + match, kVideoToolboxDRMModelOriginal, sizeof(kVideoToolboxDRMModelOriginal));
+    }
+    return page;
+}
+
+inline bool isDRMModelPatched(const std::vector<UInt8> &page, size_t match) {
+    return !memcmp(page.data() + match, BaseDeviceInfo::get().modelIdentifier, DRMModelPatchedSize) &&
+           !memcmp(page.data() + match + DRMModelPatchedSize, kVideoToolboxDRMModelOriginal + DRMModelPatchedSize,
+               sizeof(kVideoToolboxDRMModelOriginal) - DRMModelPatchedSize);
+}
@@ -0,0 +1,320 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "DYLDPatchesFixture.hpp"
+#include <string>
+
+// Stands in for the generated index, which is empty in the tree. Page 0x100001 is past 4 GiB.
+static const UInt32 kIndexedPages[] = {0x1, 0x2, 0x7, 0x64, 0x65, 0x100001};
+const SharedCacheIndex sharedCacheIndex[] = {
+    {{0x3C, 0x9B, 0x27, 0x41, 0x8E, 0x11, 0x35, 0x5A, 0x96, 0x0D, 0x4F, 0xA2, 0x71, 0xC8, 0x05, 0xEE}, kIndexedPages,
+        arrsize(kIndexedPages)},
+    {{0x3C, 0x9B, 0x27, 0x41, 0x8E, 0x11, 0x35, 0x5A, 0x96, 0x0D, 0x4F, 0xA2, 0x71, 0xC8, 0x05, 0xEF}, nullptr, 0},
+    {},
+};
+const size_t sharedCacheIndexCount = 2;
+
+static constexpr char kSharedCachePath[] = "/System/Library/dyld/dyld_shared_cache_x86_64.01";
+
+static constexpr size_t MaxTestPatch = 8;
+
+// Small alphabets and short patterns, so that partial matches and overlapping hits are common.
+struct TestPatch {
+    UInt8 find[MaxTestPatch], findMask[MaxTestPatch], replace[MaxTestPatch], replaceMask[MaxTestPatch];
+    size_t size;
+
+    TestPatch(TestRandom &random, UInt8 alphabet) : size {random.below(MaxTestPatch - 1) + 1} {
+        static const UInt8 masks[] = {0x00, 0x01, 0xFF, 0xFF};
+        for (size_t i = 0; i < this->size; i++) {
+            this->find[i] = static_cast<UInt8>(random.below(alphabet));
+            this->findMask[i] = masks[random.below(arrsize(masks))];
+            this->replace[i] = static_cast<UInt8>(random.next());
+            this->replaceMask[i] = static_cast<UInt8>(random.next());
+        }
+    }
+};
+
+// A set of one patch rewrites the same bytes as the patch searching on its own.
+TEST(patchSetMatchesApply) {
+    TestRandom random {23};
+    UInt8 data[300], expected[300];
+    for (size_t iteration = 0; iteration < 20000; iteration++) {
+        auto alphabet = static_cast<UInt8>(random.below(3) + 2);
+        auto size = random.below(sizeof(data)) + 1;
+        for (size_t i = 0; i < size; i++) { data[i] = static_cast<UInt8>(random.below(alphabet)); }
+        memcpy(expected, data, size);
+
+        TestPatch test {random, alphabet};
+        bool findMasked = random.below(2), replaceMasked = random.below(2);
+        DYLDPatch patch {test.find, findMasked ? test.findMask : nullptr, test.replace,
+            replaceMasked ? test.replaceMask : nullptr, test.size, "Test"};
+        patch.apply(expected, size);
+        DYLDPatchSet set {};
+        REQUIRE(set.add(patch));
+        set.apply(data, size);
+        CHECK(!memcmp(data, expected, size));
+    }
+}
+
+TEST(patchSetAppliesEveryPatchInOneWalk) {
+    std::vector<UInt8> finds(MultiPatternScanner::MaxPatterns * 8), replaces(finds.size());
+    std::vector<DYLDPatch> patches {};
+    for (size_t i = 0; i < MultiPatternScanner::MaxPatterns; i++) {
+        UInt8 find[] = {0x0F, 0xA2, 0xB8, static_cast<UInt8>(i), 0x00, 0x00, 0x00, 0xC3};
+        memcpy(&finds[i * 8], find, 8);
+        memset(&replaces[i * 8], static_cast<int>(0x90 + i), 8);
+        patches.emplace_back(&finds[i * 8], &replaces[i * 8], 8, "Test");
+    }
+    DYLDPatchSet set {};
+    for (const auto &patch : patches) { REQUIRE(set.add(patch)); }
+    CHECK(!set.add(patches[0]));
+
+    // Each pattern twice, from the end of the page backwards, plus one straddling the end.
+    std::vector<UInt8> page(PAGE_SIZE, 0xCC);
+    for (size_t i = 0; i < MultiPatternScanner::MaxPatterns; i++) {
+        memcpy(&page[PAGE_SIZE - 0x100 - i * 0x40], &finds[i * 8], 8);
+        memcpy(&page[0x80 + i * 0x20], &finds[i * 8], 8);
+    }
+    memcpy(&page[PAGE_SIZE - 4], &finds[0], 4);
+    set.apply(page.data(), PAGE_SIZE);
+    for (size_t i = 0; i < MultiPatternScanner::MaxPatterns; i++) {
+        CHECK(!memcmp(&page[PAGE_SIZE - 0x100 - i * 0x40], &replaces[i * 8], 8));
+        CHECK(!memcmp(&page[0x80 + i * 0x20], &replaces[i * 8], 8));
+    }
+    CHECK(!memcmp(&page[PAGE_SIZE - 4], &finds[0], 4));
+}
+
+// More patches than a set holds are split over several.
+TEST(applyAllTakesAnyNumberOfPatches) {
+    static constexpr size_t Count = 2 * MultiPatternScanner::MaxPatterns + 3;
+    UInt8 finds[Count][4], replaces[Count][4];
+    std::vector<DYLDPatch> patches {};
+    std::vector<UInt8> page(PAGE_SIZE, 0xCC);
+    for (size_t i = 0; i < Count; i++) {
+        UInt8 find[] = {0x0F, 0xA2, static_cast<UInt8>(i), 0xC3};
+        memcpy(finds[i], find, 4);
+        memset(replaces[i], static_cast<int>(i), 4);
+        patches.emplace_back(finds[i], replaces[i], "Test");
+        memcpy(&page[i * 0x40], finds[i], 4);
+    }
+    DYLDPatch::applyAll(patches.data(), patches.size(), page.data(), PAGE_SIZE);
+    for (size_t i = 0; i < Count; i++) { CHECK(!memcmp(&page[i * 0x40], replaces[i], 4)); }
+}
+
+TEST(patchesTheDRMModelInSharedCachePages) {
+    DYLDPatchesFixture fixture {};
+    REQUIRE(fixture.isRouted());
+    vnode file {kSharedCachePath, 1};
+    auto page = getSharedCachePage(1, 0x123);
+    fixture.validate(&file, 3 * PAGE_SIZE, page.data());
+    CHECK(fixture.getValidations() == 1);
+    CHECK(isDRMModelPatched(page, 0x123));
+    auto other = getSharedCachePage(2, NoDRMModel);
+    auto original = other;
+    fixture.validate(&file, 4 * PAGE_SIZE, other.data());
+    CHECK(other == original);
+}
+
+// An evicted page comes back with its original contents and is patched again at the offset the memo has for it.
+TEST(repatchesEvictedPagesFromTheMemo) {
+    DYLDPatchesFixture fixture {};
+    vnode file {kSharedCachePath, 1};
+    for (size_t i = 0; i < 3; i++) {
+        auto page = getSharedCachePage(1, 0x123);
+        fixture.validate(&file, 3 * PAGE_SIZE, page.data());
+        CHECK(isDRMModelPatched(page, 0x123));
+    }
+}
+
+// The memo is trusted over the page: a match anywhere else isn't searched for, and the known offset is only written
+// after checking that it still holds the original bytes.
+TEST(onlyRevisitsTheOffsetInTheMemo) {
+    DYLDPatchesFixture fixture {};
+    vnode file {kSharedCachePath, 1};
+    auto page = getSharedCachePage(1, 0x123);
+    fixture.validate(&file, 3 * PAGE_SIZE, page.data());
+    REQUIRE(isDRMModelPatched(page, 0x123));
+
+    auto moved = getSharedCachePage(1, 0x456);
+    auto original = moved;
+    fixture.validate(&file, 3 * PAGE_SIZE, moved.data());
+    CHECK(moved == original);
+
+    auto empty = getSharedCachePage(2, NoDRMModel);
+    fixture.validate(&file, 5 * PAGE_SIZE, empty.data());
+    auto late = getSharedCachePage(2, 0x200);
+    original = late;
+    fixture.validate(&file, 5 * PAGE_SIZE, late.data());
+    CHECK(late == original);
+
+    // A recycled vnode is a different file, whose pages are searched again.
+    file.vid = 2;
+    fixture.validate(&file, 3 * PAGE_SIZE, moved.data());
+    CHECK(isDRMModelPatched(moved, 0x456));
+    fixture.validate(&file, 5 * PAGE_SIZE, late.data());
+    CHECK(isDRMModelPatched(late, 0x200));
+}
+
+// The memo is the last cache allocated, without it every page is searched.
+TEST(searchesEveryPageWithoutTheMemo) {
+    DYLDPatchesFixture fixture {2};
+    REQUIRE(fixture.isRouted());
+    vnode file {kSharedCachePath, 1};
+    auto page = getSharedCachePage(1, 0x123);
+    fixture.validate(&file, 3 * PAGE_SIZE, page.data());
+    CHECK(isDRMModelPatched(page, 0x123));
+    auto moved = getSharedCachePage(1, 0x456);
+    fixture.validate(&file, 3 * PAGE_SIZE, moved.data());
+    CHECK(isDRMModelPatched(moved, 0x456));
+}
+
+TEST(patchesWithoutAnyCache) {
+    DYLDPatchesFixture fixture {0};
+    REQUIRE(fixture.isRouted());
+    vnode file {kSharedCachePath, 1};
+    for (size_t i = 0; i < 2; i++) {
+        auto page = getSharedCachePage(1, 0x123);
+        fixture.validate(&file, 3 * PAGE_SIZE, page.data());
+        CHECK(isDRMModelPatched(page, 0x123));
+    }
+}
+
+TEST(routesNothingOutsideNormalRuns) {
+    lilu.runMode = LiluAPI::RunningSafeMode;
+    DYLDPatchesFixture fixture {};
+    lilu.runMode = LiluAPI::RunningNormal;
+    CHECK(!fixture.isRouted());
+}
+
+// A page with both the CoreLSKD CPUID check, twice, and the DRM model string.
+static std::vector<UInt8> getTargetPage() {
+    auto page = getSharedCachePage(3, 0x800);
+    memcpy(page.data() + 0x40, kCoreLSKDOriginal, sizeof(kCoreLSKDOriginal));
+    memcpy(page.data() + 0xF00, kCoreLSKDOriginal, sizeof(kCoreLSKDOriginal));
+    return page;
+}
+
+TEST(coreLSKDPatchOnlyReplacesTheCPUIDSignature) {
+    static_assert(sizeof(kCoreLSKDOriginal) == sizeof(kCoreLSKDPatched));
+    auto readImm32 = [](const UInt8 *insn) {
+        return static_cast<UInt32>(insn[2]) | static_cast<UInt32>(insn[3]) << 8 | static_cast<UInt32>(insn[4]) << 16 |
+               static_cast<UInt32>(insn[5]) << 24;
+    };
+    // Both start with `mov eax, imm32` (C7 /0, ModRM C0), so the instructions still end at the same bytes.
+    for (const auto *insn : {kCoreLSKDOriginal, kCoreLSKDPatched}) {
+        CHECK(insn[0] == 0xC7);
+        CHECK(insn[1] == 0xC0);
+    }
+    // `cpuid` of leaf 1 becomes a two byte `nop`, leaving the signature in EAX.
+    CHECK(readImm32(kCoreLSKDOriginal) == 1);
+    CHECK(kCoreLSKDOriginal[6] == 0x0F && kCoreLSKDOriginal[7] == 0xA2);
+    CHECK(kCoreLSKDPatched[6] == 0x66 && kCoreLSKDPatched[7] == 0x90);
+    auto signature = readImm32(kCoreLSKDPatched);
+    auto family = (signature >> 8) & 0xF;
+    auto model = ((signature >> 12) & 0xF0) | ((signature >> 4) & 0xF);
+    CHECK(family == 6);
+    CHECK(model == 0x3C);
+    CHECK((signature & 0xF) == 3);
+    // No extended family and nothing in the reserved bits.
+    CHECK((signature & 0xFFF0F000) == 0);
+}
+
+TEST(patchesCoreLSKDPages) {
+    DYLDPatchesFixture fixture {};
+    for (const char *path : {kCoreLSKDPath, kCoreLSKDMSEPath}) {
+        vnode file {path, 1};
+        for (size_t i = 0; i < 2; i++) {
+            auto page = getTargetPage();
+            fixture.validate(&file, i * PAGE_SIZE, page.data());
+            CHECK(!memcmp(page.data() + 0x40, kCoreLSKDPatched, sizeof(kCoreLSKDPatched)));
+            CHECK(!memcmp(page.data() + 0xF00, kCoreLSKDPatched, sizeof(kCoreLSKDPatched)));
+            CHECK(!isDRMModelPatched(page, 0x800));
+        }
+    }
+}
+
+TEST(leavesOtherFilesAlone) {
+    DYLDPatchesFixture fixture {};
+    std::string extended = std::string {kCoreLSKDPath} + "x";
+    std::string truncated = std::string {kCoreLSKDPath, sizeof(kCoreLSKDPath) - 2};
+    // The second cache is under a path in the trie, but isn't the one Lilu says is in use.
+    const char *paths[] = {extended.c_str(), truncated.c_str(), "/usr/lib/libSystem.B.dylib",
+        "/private/var/db/dyld/dyld_shared_cache_x86_64h", nullptr};
+    UInt32 vid = 1;
+    for (const char *path : paths) {
+        vnode file {path, vid++};
+        auto page = getTargetPage();
+        auto original = page;
+        fixture.validate(&file, 0, page.data());
+        fixture.validate(&file, PAGE_SIZE, page.data());
+        CHECK(page == original);
+    }
+    CHECK(fixture.getValidations() == 2 * arrsize(paths));
+}
+
+// The first 128 pages of a cache and one past 4 GiB.
+static std::vector<UInt64> getTestPages() {
+    std::vector<UInt64> pages {};
+    for (UInt64 page = 1; page < 0x80; page++) { pages.push_back(page); }
+    pages.push_back(0x100001);
+    return pages;
+}
+
+// Validates the header page of `file` unless `uuid` is null, then each of `getTestPages` with the DRM model string.
+// Returns the pages that were patched.
+static std::vector<UInt64> getPatchedPages(DYLDPatchesFixture &fixture, vnode *file, const UInt8 *uuid) {
+    if (uuid) {
+        auto page = getSharedCachePage(4, NoDRMModel);
+        memcpy(page.data() + SharedCacheUUIDOffset, uuid, sizeof(SharedCacheIndex::uuid));
+        fixture.validate(file, 0, page.data());
+    }
+    std::vector<UInt64> patched {};
+    for (auto index : getTestPages()) {
+        auto page = getSharedCachePage(index, 0x300);
+        fixture.validate(file, index * PAGE_SIZE, page.data());
+        if (isDRMModelPatched(page, 0x300)) { patched.push_back(index); }
+    }
+    return patched;
+}
+
+static const UInt8 *const kIndexedUUID = sharedCacheIndex[0].uuid;
+static const UInt8 *const kMatchFreeUUID = sharedCacheIndex[1].uuid;
+static const UInt8 kUnknownUUID[16] = {0x01};
+
+TEST(searchesOnlyTheIndexedPages) {
+    DYLDPatchesFixture fixture {};
+    vnode file {kSharedCachePath, 1};
+    CHECK(getPatchedPages(fixture, &file, kIndexedUUID) ==
+          std::vector<UInt64>(std::begin(kIndexedPages), std::end(kIndexedPages)));
+    // The header page isn't listed either.
+    auto header = getSharedCachePage(4, 0x300);
+    memcpy(header.data() + SharedCacheUUIDOffset, kIndexedUUID, sizeof(SharedCacheIndex::uuid));
+    fixture.validate(&file, 0, header.data());
+    CHECK(!isDRMModelPatched(header, 0x300));
+}
+
+TEST(skipsEveryPageOfAMatchFreeCache) {
+    DYLDPatchesFixture fixture {};
+    vnode file {kSharedCachePath, 1};
+    CHECK(getPatchedPages(fixture, &file, kMatchFreeUUID).empty());
+}
+
+// Until the header has been seen, or for a cache that isn't in the index, every page is searched.
+TEST(searchesEveryPageOfUnknownCaches) {
+    DYLDPatchesFixture fixture {};
+    vnode unknown {kSharedCachePath, 1}, unseen {kSharedCachePath, 2};
+    CHECK(getPatchedPages(fixture, &unknown, kUnknownUUID) == getTestPages());
+    CHECK(getPatchedPages(fixture, &unseen, nullptr) == getTestPages());
+    // A recycled vnode doesn't keep the index of the file before it.
+    vnode file {kSharedCachePath, 3};
+    getPatchedPages(fixture, &file, kIndexedUUID);
+    file.vid = 4;
+    CHECK(getPatchedPages(fixture, &file, nullptr) == getTestPages());
+}
+
+// The cache indices are the second cache allocated.
+TEST(searchesEveryPageWithoutTheCacheIndices) {
+    DYLDPatchesFixture fixture {1};
+    vnode file {kSharedCachePath, 1};
+    CHECK(getPatchedPages(fixture, &file, kIndexedUUID) == getTestPages());
+}
@@ -0,0 +1,37 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#pragma once
+#include "OffsetCache.hpp"
+#include <string>
+
+// Keeps every offset cache record in a file of its own, the stand-in for NVRAM on the host.
+class FileOffsetCacheStorage : public OffsetCacheStorage {
+    public:
+    explicit FileOffsetCacheStorage(const char *directory) : directory {directory} {}
+
+    UInt32 read(const char *name, UInt8 *buffer, UInt32 capacity) override {
+        auto *file = fopen(this->getPath(name).c_str(), "rb");
+        if (!file) { return 0; }
+        auto size = fread(buffer, 1, capacity, file);
+        // Like NVRAM, a record that doesn't fit isn't read at all.
+        if (fgetc(file) != EOF) { size = 0; }
+        fclose(file);
+        return static_cast<UInt32>(size);
+    }
+
+    bool write(const char *name, const UInt8 *buffer, UInt32 size) override {
+        this->writes += 1;
+        auto *file = fopen(this->getPath(name).c_str(), "wb");
+        if (!file) { return false; }
+        bool written = fwrite(buffer, 1, size, file) == size;
+        return fclose(file) == 0 && written;
+    }
+
+    std::string getPath(const char *name) const { return this->directory + "/" + name; }
+
+    size_t writes {0};
+
+    private:
+    std::string directory;
+};
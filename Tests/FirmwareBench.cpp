@@ -0,0 +1,105 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "Firmware.hpp"
+#include "Test.hpp"
+#include <vector>
+
+static constexpr size_t LookupCount = 100000;
+
+static const FWMetadata &findLinearly(const char *name) {
+    for (size_t i = 0; i < firmwareCount; i++) {
+        if (!strcmp(firmware[i].name, name)) { return firmware[i].metadata; }
+    }
+    PANIC("FW", "'%s' not found", name);
+}
+
+BENCH(firmwareLookup) {
+    // The worst case for the linear lookup is the last entry, with its name built at runtime like the PSP IP
+    // firmware loads do.
+    auto *worst = firmware[firmwareCount - 1].name;
+    char filename[128];
+
+    printf("    %zu blobs, %zu lookups\n", firmwareCount, LookupCount);
+    measure("linear, last entry, snprintf", 10, [&] {
+        for (size_t i = 0; i < LookupCount; i++) {
+            snprintf(filename, sizeof(filename), "%s", worst);
+            keep(findLinearly(filename).length);
+        }
+    });
+    measure("perfect hash, last entry, snprintf", 10, [&] {
+        for (size_t i = 0; i < LookupCount; i++) {
+            snprintf(filename, sizeof(filename), "%s", worst);
+            keep(getFWByName(filename).length);
+        }
+    });
+    measure("linear, literal", 10, [&] {
+        for (size_t i = 0; i < LookupCount; i++) { keep(findLinearly("psp_sos_navi21.bin").length); }
+    });
+    measure("perfect hash, literal", 10, [&] {
+        for (size_t i = 0; i < LookupCount; i++) { keep(FW_BY_NAME("psp_sos_navi21.bin").length); }
+    });
+}
+
+BENCH(compressedFirmwareCopy) {
+    size_t largest = 0, total = 0, stored = 0;
+    std::vector<const FWMetadata *> blobs;
+    for (size_t i = 0; i < firmwareCount; i++) {
+        auto &fw = firmware[i].metadata;
+        if (!fw.compressedLength) { continue; }
+        blobs.push_back(&fw);
+        largest = fw.length > largest ? fw.length : largest;
+        total += fw.length;
+        stored += fw.compressedLength;
+    }
+    std::vector<UInt8> source(largest, 0x5A), dest(largest);
+
+    printf("    %zu compressed blobs, %zu bytes stored for %zu\n", blobs.size(), stored, total);
+    measure("copyTo, inflating", 10, [&] {
+        for (auto *fw : blobs) { fw->copyTo(dest.data()); }
+        keep(dest[0]);
+    });
+    measure("memcpy of the same lengths", 10, [&] {
+        for (auto *fw : blobs) { memcpy(dest.data(), source.data(), fw->length); }
+        keep(dest[0]);
+    });
+}
+
+BENCH(patchedFirmwareCopy) {
+    size_t largest = 0, total = 0, stored = 0;
+    std::vector<const FWMetadata *> blobs;
+    for (size_t i = 0; i < firmwareCount; i++) {
+        auto &fw = firmware[i].metadata;
+        if (!fw.base) { continue; }
+        blobs.push_back(&fw);
+        largest = fw.length > largest ? fw.length : largest;
+        total += fw.length;
+    }
+    std::vector<UInt8> dest(largest);
+    for (auto *fw : blobs) {
+        // Every run header and payload, up to the terminating empty run.
+        auto *patch = fw->data;
+        for (size_t runs = 0;; runs++) {
+            size_t values[2] {};
+            for (auto &value : values) {
+                for (size_t shift = 0;; shift += 7) {
+                    value |= static_cast<size_t>(*patch & 0x7F) << shift;
+                    if (*patch++ < 0x80) { break; }
+                }
+            }
+            if (!values[1]) { break; }
+            patch += values[1];
+        }
+        stored += static_cast<size_t>(patch - fw->data);
+    }
+
+    printf("    %zu patched blobs, %zu bytes stored for %zu\n", blobs.size(), stored, total);
+    measure("copyTo, baseline and patch", 10, [&] {
+        for (auto *fw : blobs) { fw->copyTo(dest.data()); }
+        keep(dest[0]);
+    });
+    measure("copyTo, baseline only", 10, [&] {
+        for (auto *fw : blobs) { fw->base->copyTo(dest.data()); }
+        keep(dest[0]);
+    });
+}
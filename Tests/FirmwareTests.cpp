@@ -0,0 +1,140 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "Firmware.hpp"
+#include "Test.hpp"
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Relative to Tests, where make runs the tests.
+static const char *const FirmwareDir = "../NootRX/Firmware/";
+
+// The lookup the perfect hash replaced.
+static const FWMetadata *findLinearly(const char *name) {
+    for (size_t i = 0; i < firmwareCount; i++) {
+        if (!strcmp(firmware[i].name, name)) { return &firmware[i].metadata; }
+    }
+    return nullptr;
+}
+
+TEST(findsEveryBlobInItsOwnSlot) {
+    REQUIRE(firmwareCount > 0 && firmwareSeedCount > 0);
+    for (size_t i = 0; i < firmwareCount; i++) {
+        CHECK(getFWSlot(getFWNameHash(firmware[i].name)) == i);
+        CHECK(&getFWByName(firmware[i].name) == findLinearly(firmware[i].name));
+    }
+}
+
+TEST(hashesLiteralNamesAtCompileTime) {
+    static constexpr FWName name {"psp_sos_navi21.bin"};
+    static_assert(name.hash == getFWNameHash("psp_sos_navi21.bin"), "Not hashed at compile time");
+    CHECK(&FW_BY_NAME("psp_sos_navi21.bin") == findLinearly("psp_sos_navi21.bin"));
+    CHECK(&getFWByName(name) == findLinearly("psp_sos_navi21.bin"));
+}
+
+TEST(panicsOnUnknownNames) {
+    CHECK(panics([] { getFWByName("psp_sos_navi24.bin"); }));
+    CHECK(panics([] { getFWByName(""); }));
+}
+
+// Text blobs are handed out with a NUL byte after the file's contents.
+static std::vector<UInt8> readBlob(const char *name) {
+    std::ifstream file {std::string(FirmwareDir) + name, std::ios::binary};
+    std::vector<UInt8> data {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    auto length = strlen(name);
+    if (length < 4 || (strcmp(name + length - 4, ".bin") && strcmp(name + length - 4, ".dat"))) { data.push_back(0); }
+    return data;
+}
+
+TEST(copiesEveryBlobExactly) {
+    static constexpr size_t Guard = 64;
+    size_t compressed = 0;
+    for (size_t i = 0; i < firmwareCount; i++) {
+        auto &fw = firmware[i];
+        auto expected = readBlob(fw.name);
+        REQUIRE(expected.size() == fw.metadata.length);
+        std::vector<UInt8> out(fw.metadata.length + Guard, 0xCC);
+        fw.metadata.copyTo(out.data());
+        CHECK(!memcmp(out.data(), expected.data(), expected.size()));
+        // Nothing is written past the blob, inflating included.
+        for (size_t j = 0; j < Guard; j++) { CHECK(out[fw.metadata.length + j] == 0xCC); }
+        if (fw.metadata.compressedLength) {
+            CHECK(fw.metadata.compressedLength < fw.metadata.length);
+            compressed += 1;
+        }
+    }
+    CHECK(compressed > 0);
+}
+
+TEST(panicsOnCorruptedStreams) {
+    for (size_t i = 0; i < firmwareCount; i++) {
+        auto &fw = firmware[i].metadata;
+        if (!fw.compressedLength) { continue; }
+        // A stream that inflates to fewer bytes than the blob's length.
+        FWMetadata short_ {fw.data, fw.length + 1, fw.compressedLength};
+        std::vector<UInt8> out(fw.length + 1);
+        CHECK(panics([&] { short_.copyTo(out.data()); }));
+        // A stream that ends early.
+        FWMetadata truncated {fw.data, fw.length, fw.compressedLength / 2};
+        CHECK(panics([&] { truncated.copyTo(out.data()); }));
+        CHECK(panics([&] {
+            FWBlob blob {};
+            blob.load(truncated);
+        }));
+        return;
+    }
+}
+
+TEST(loadsEveryBlobExactly) {
+    for (size_t i = 0; i < firmwareCount; i++) {
+        auto &fw = firmware[i].metadata;
+        FWBlob blob {};
+        blob.load(fw);
+        REQUIRE(blob.length == fw.length);
+        std::vector<UInt8> expected(fw.length), out(fw.length);
+        fw.copyTo(expected.data());
+        blob.copyTo(out.data());
+        CHECK(!memcmp(out.data(), expected.data(), fw.length));
+        // Only blobs that need unpacking take memory of their own.
+        CHECK((blob.data == fw.data) == (!fw.compressedLength && !fw.base));
+        if (blob.data != fw.data) { IOFree(const_cast<UInt8 *>(blob.data), blob.length); }
+    }
+}
+
+TEST(patchesSiblingsAgainstABaseline) {
+    size_t patched = 0;
+    for (size_t i = 0; i < firmwareCount; i++) {
+        auto &fw = firmware[i];
+        if (!fw.metadata.base) { continue; }
+        // One level deep, so a variant never costs more than its baseline's copy plus one pass of XORs.
+        CHECK(fw.metadata.base->base == nullptr);
+        CHECK(fw.metadata.base->length == fw.metadata.length);
+        CHECK(fw.metadata.compressedLength == 0);
+        CHECK(strstr(fw.name, "navi22") || strstr(fw.name, "navi23") || strstr(fw.name, "_2_") ||
+              strstr(fw.name, "_4_"));
+        patched += 1;
+    }
+    CHECK(patched > 0);
+}
+
+TEST(panicsOnDeltaRunsPastTheBlob) {
+    static const UInt8 base[4] {};
+    static const UInt8 patch[] = {0x2, 0x3, 0xFF, 0xFF, 0xFF, 0x0, 0x0};
+    FWMetadata baseline {base, sizeof(base)};
+    FWMetadata variant {patch, sizeof(base), 0, &baseline};
+    UInt8 out[sizeof(base)];
+    CHECK(panics([&] { variant.copyTo(out); }));
+}
+
+TEST(alignsAndPadsEveryPayload) {
+    for (size_t i = 0; i < firmwareCount; i++) {
+        auto &fw = firmware[i].metadata;
+        CHECK(reinterpret_cast<uintptr_t>(fw.data) % FWAlignment == 0);
+        if (fw.base) { continue; }
+        // Zeroes up to the next boundary, so no other payload shares the last cache line.
+        size_t stored = fw.compressedLength ? fw.compressedLength : fw.length;
+        for (size_t j = stored; j % FWAlignment; j++) { CHECK(fw.data[j] == 0); }
+    }
+}
@@ -0,0 +1,75 @@
+#!/bin/sh
+
+# Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+# See LICENSE for details.
+
+# Runs Scripts/FWGen.sh the way the kext build does on a copy of the project, and checks that a rebuild with nothing
+# changed leaves every output alone, while missing or damaged payloads and a moved checkout are regenerated.
+
+set -e
+repo="$(cd "$(dirname "$0")/.." && pwd)"
+work="$(mktemp -d)"
+trap 'rm -rf "${work}"' EXIT
+
+fail() {
+    echo "$1" >&2
+    exit 1
+}
+
+# Copies the inputs the generator needs into `$1`, laid out like the project.
+make_project() {
+    mkdir -p "$1/NootRX"
+    cp -R "${repo}/Scripts" "$1/Scripts"
+    cp -R "${repo}/NootRX/Firmware" "$1/NootRX/Firmware"
+}
+
+generate() {
+    PROJECT_DIR="$1" sh "$1/Scripts/FWGen.sh" -P "$1/NootRX/Firmware/" -C -D -I >/dev/null
+}
+
+# Backdates every output, so anything the next run writes is newer than the stamp.
+backdate() {
+    find "$1/NootRX" -path "$1/NootRX/Firmware" -prune -o -type f -exec touch -t 200001010000 {} +
+    touch -t 200101010000 "${work}/stamp"
+}
+
+written() {
+    find "$1/NootRX" -path "$1/NootRX/Firmware" -prune -o -type f -newer "${work}/stamp" -print | sort
+}
+
+project="${work}/project"
+make_project "${project}"
+generate "${project}"
+[ -s "${project}/NootRX/Firmware.cpp" ] && [ -s "${project}/NootRX/Firmware.S" ] || fail "Nothing generated"
+grep -q "${work}" "${project}/NootRX/Firmware.manifest" && fail "The manifest has absolute paths"
+payload="$(ls "${project}/NootRX/FirmwareBlobs" | head -n 1)"
+[ -n "${payload}" ] || fail "No payloads stored"
+
+echo "noOpRebuildWritesNothing"
+backdate "${project}"
+generate "${project}"
+[ -z "$(written "${project}")" ] || fail "A no-op rebuild wrote $(written "${project}")"
+touch "${project}/NootRX/Firmware/psp_asd.bin"
+generate "${project}"
+[ -z "$(written "${project}")" ] || fail "Touching a blob wrote $(written "${project}")"
+
+echo "regeneratesDeletedPayloads"
+rm "${project}/NootRX/FirmwareBlobs/${payload}"
+generate "${project}"
+[ -f "${project}/NootRX/FirmwareBlobs/${payload}" ] || fail "${payload} was not regenerated"
+rm -rf "${project}/NootRX/FirmwareBlobs"
+generate "${project}"
+[ -f "${project}/NootRX/FirmwareBlobs/${payload}" ] || fail "FirmwareBlobs was not regenerated"
+
+echo "regeneratesDamagedPayloads"
+cp "${project}/NootRX/FirmwareBlobs/${payload}" "${work}/payload"
+printf 'x' >"${project}/NootRX/FirmwareBlobs/${payload}"
+generate "${project}"
+cmp -s "${work}/payload" "${project}/NootRX/FirmwareBlobs/${payload}" || fail "${payload} was not repaired"
+
+echo "regeneratesAMovedCheckout"
+cp "${project}/NootRX/Firmware.manifest" "${work}/manifest"
+mv "${project}" "${work}/moved"
+generate "${work}/moved"
+grep -q "${project}/" "${work}/moved/NootRX/Firmware.S" && fail "Firmware.S still includes the old checkout"
+cmp -s "${work}/manifest" "${work}/moved/NootRX/Firmware.manifest" || fail "The manifest changed with the checkout"
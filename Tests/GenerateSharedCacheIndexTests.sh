@@ -0,0 +1,64 @@
+#!/bin/sh
+
+# Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+# See LICENSE for details.
+
+# Runs Scripts/GenerateSharedCacheIndex.py over synthetic shared cache files and checks which pages and files end up
+# in the table, and that the table compiles.
+
+set -e
+repo="$(cd "$(dirname "$0")/.." && pwd)"
+tests="$(cd "$(dirname "$0")" && pwd)"
+work="$(mktemp -d)"
+trap 'rm -rf "${work}"' EXIT
+
+fail() {
+    echo "$1" >&2
+    exit 1
+}
+
+mkdir -p "${work}/NootRX" "${work}/caches"
+cp "${repo}/NootRX/DYLDPatches.hpp" "${repo}/NootRX/SharedCacheIndex.hpp" "${work}/NootRX"
+
+# 16 page files with the DRM model string at the given offsets.
+python3 - "${work}/caches" <<'PYTHON'
+import os, sys
+
+model = b"MacPro5,1\0MacPro6,1\0IOService\0"
+
+
+def write(name, uuid, offsets, magic=b"dyld_v1  x86_64\0"):
+    data = bytearray(16 * 0x1000)
+    data[: len(magic)] = magic
+    data[0x58:0x68] = bytes([uuid] * 16)
+    for offset in offsets:
+        data[offset : offset + len(model)] = model
+    with open(os.path.join(sys.argv[1], name), "wb") as file:
+        file.write(data)
+
+
+# Pages 3 and 9 hold a match, one more crosses from page 5 into page 6.
+write("dyld_shared_cache_x86_64", 0xA1, [3 * 0x1000 + 0x100, 9 * 0x1000 + 0x200, 6 * 0x1000 - 10, 9 * 0x1000 + 0x800])
+write("dyld_shared_cache_x86_64.01", 0xB2, [])
+write("dyld_shared_cache_x86_64h", 0xA1, [2 * 0x1000])
+write("dyld_shared_cache_x86_64.map", 0xC3, [4 * 0x1000], b"mapping")
+PYTHON
+
+python3 "${repo}/Scripts/GenerateSharedCacheIndex.py" "${work}/NootRX/SharedCacheIndex.cpp" "${work}/caches" \
+    >/dev/null
+index="${work}/NootRX/SharedCacheIndex.cpp"
+
+echo "listsThePagesWithAMatch"
+[ "$(sed -n '/^static const UInt32 cache0\[\] = {$/,/^};$/p' "${index}" | tr -d ' \n')" = \
+    "staticconstUInt32cache0[]={0x3,0x9,};" ] || fail "Wrong pages for dyld_shared_cache_x86_64"
+
+echo "listsMatchFreeFilesWithoutPages"
+grep -q "nullptr, 0},    // dyld_shared_cache_x86_64.01" "${index}" || fail "The match-free sub-cache is missing"
+
+echo "skipsDuplicateUUIDsAndOtherFiles"
+grep -q "x86_64h\|\.map" "${index}" && fail "A duplicate UUID or a file that isn't a cache was indexed"
+grep -q "^const size_t sharedCacheIndexCount = 2;$" "${index}" || fail "Wrong number of files"
+
+echo "compiles"
+"${CXX:-c++}" -std=c++17 -fsyntax-only -I"${tests}/Include" -I"${work}/NootRX" "${index}" ||
+    fail "The table doesn't compile"
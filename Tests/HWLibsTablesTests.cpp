@@ -0,0 +1,217 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "HWLibsTables.hpp"
+#include "Test.hpp"
+#include <string>
+
+KernelPatcher::KextInfo kextRadeonX6810HWLibs {};
+KernelPatcher::KextInfo kextRadeonX6800HWLibs {};
+
+struct ExpectedPatches {
+    const KernelPatcher::KextInfo *kexts[16];
+    const UInt8 *finds[16];
+    size_t count;
+
+    void add(const KernelPatcher::KextInfo &kext, const UInt8 *find) {
+        this->kexts[this->count] = &kext;
+        this->finds[this->count++] = find;
+    }
+
+    template<size_t N, bool S>
+    void add(const KernelPatcher::KextInfo &kext, const BytePattern<N, S> &find) {
+        this->add(kext, find.pattern);
+    }
+};
+
+// The lookup patches `HWLibs::processKext` staged before the manifest, branch for branch.
+static ExpectedPatches getBranchPatches(NootRXAttributes attributes) {
+    ExpectedPatches ret {};
+    if (attributes.isNavi21()) {
+        if (attributes.isBigSur()) {
+            ret.add(kextRadeonX6800HWLibs, kSmu1107CheckFwVersionNavi21Original);
+        } else {
+            ret.add(kextRadeonX6800HWLibs, kSmu1107CheckFwVersionNavi21Original_12);
+        }
+    } else {
+        ret.add(kextRadeonX6810HWLibs, kSmu1107CheckFwVersionOriginal);
+    }
+
+    if (attributes.isNavi22()) {
+        ret.add(kextRadeonX6810HWLibs, kGcSwInitOriginal);
+        if (attributes.isSonoma1404AndLater()) {
+            ret.add(kextRadeonX6810HWLibs, kGcSetFwEntryInfoOriginal14_4);
+            ret.add(kextRadeonX6810HWLibs, kPspSwInit1Original14_4);
+            ret.add(kextRadeonX6810HWLibs, kPspSwInit2Original14_4);
+            ret.add(kextRadeonX6810HWLibs, kPspSwInit3Original14_4);
+            ret.add(kextRadeonX6810HWLibs, kSdmaInitFunctionPointerOriginal14_4);
+        } else {
+            ret.add(kextRadeonX6810HWLibs, kGcSetFwEntryInfoOriginal);
+            ret.add(kextRadeonX6810HWLibs, kPspSwInit1Original);
+            ret.add(kextRadeonX6810HWLibs, kPspSwInit2Original);
+            ret.add(kextRadeonX6810HWLibs, kPspSwInit3Original);
+            if (attributes.isVenturaAndLater()) {
+                ret.add(kextRadeonX6810HWLibs, kSdmaInitFunctionPointerOriginal);
+            }
+        }
+    }
+    return ret;
+}
+
+TEST(plansMatchTheBranchesForEveryAttributeCombination) {
+    // What `NootRXMain::init` can set: Big Sur, Monterey, Ventura to 14.3 and 14.4 on.
+    static const UInt8 families[] = {
+        NootRXAttributes::BigSur,
+        0,
+        NootRXAttributes::VenturaAndLater,
+        NootRXAttributes::VenturaAndLater | NootRXAttributes::Sonoma1404AndLater,
+    };
+    static const UInt8 navis[] = {NootRXAttributes::Navi21, NootRXAttributes::Navi22, NootRXAttributes::Navi23};
+
+    size_t checked = 0;
+    for (auto family : families) {
+        for (auto navi : navis) {
+            if (family == NootRXAttributes::BigSur && navi != NootRXAttributes::Navi21) { continue; }
+            NootRXAttributes attributes {};
+            if (family & NootRXAttributes::BigSur) { attributes.setBigSur(); }
+            if (family & NootRXAttributes::VenturaAndLater) { attributes.setVenturaAndLater(); }
+            if (family & NootRXAttributes::Sonoma1404AndLater) { attributes.setSonoma1404AndLater(); }
+            if (navi == NootRXAttributes::Navi21) { attributes.setNavi21(); }
+            if (navi == NootRXAttributes::Navi22) { attributes.setNavi22(); }
+            if (navi == NootRXAttributes::Navi23) { attributes.setNavi23(); }
+
+            auto *plan = hwLibsPatchPlans.find(attributes.getValue());
+            REQUIRE(plan != nullptr);
+            auto expected = getBranchPatches(attributes);
+            CHECK(plan->count == expected.count);
+            for (size_t i = 0; i < plan->count && i < expected.count; i++) {
+                auto &patch = hwLibsPatches[plan->entries[i]].patch;
+                CHECK(patch.kext == expected.kexts[i] && patch.find == expected.finds[i]);
+            }
+            checked += 1;
+        }
+    }
+    CHECK(checked == arrsize(hwLibsPlanKeys));
+}
+
+// A chain only works when its predecessor is staged in the same batch, before it.
+TEST(chainsFollowAPredecessorInEveryPlan) {
+    size_t chains = 0;
+    for (auto &plan : hwLibsPatchPlans.plans) {
+        for (size_t i = 0; i < plan.count; i++) {
+            auto &patch = hwLibsPatches[plan.entries[i]].patch;
+            if (!patch.maxDistance) { continue; }
+            CHECK(patch.skip == 0);
+            bool staged = false;
+            for (size_t j = 0; j < i && j < MultiPatternScanner::MaxPatterns; j++) {
+                staged |= plan.entries[j] == patch.predecessor;
+            }
+            CHECK(staged && i < MultiPatternScanner::MaxPatterns);
+            chains += 1;
+        }
+    }
+    // psp_sw_init 2 and 3 before and after macOS 14.4, for Navi 22 on each OS family from Monterey.
+    CHECK(chains == 2 * 3);
+}
+
+// The blob `HWLibs::wrapPspCmdKmSubmit` formatted the name of for each ucode ID before the table, case for case.
+// Names that aren't in the firmware table panicked when the GPU asked for them, it never does.
+static std::string getSwitchFirmware(NootRXAttributes attributes, UInt32 uCodeID) {
+    std::string prefix = attributes.isNavi21() ? "gc_10_3_" : attributes.isNavi22() ? "gc_10_3_2_" : "gc_10_3_4_";
+    switch (uCodeID) {
+        case kUCodeSMU:
+            return attributes.isNavi21() ? "navi21_smc_firmware.bin" :
+                   attributes.isNavi22() ? "navi22_smc_firmware.bin" :
+                                           "navi23_smc_firmware.bin";
+        case kUCodeCE:
+            return prefix + "ce_ucode.bin";
+        case kUCodePFP:
+            return prefix + "pfp_ucode.bin";
+        case kUCodeME:
+            return prefix + "me_ucode.bin";
+        case kUCodeMEC1:
+        case kUCodeMEC2:
+            return prefix + "mec_ucode.bin";
+        case kUCodeMEC1JT:
+        case kUCodeMEC2JT:
+            return prefix + "mec_jt_ucode.bin";
+        case kUCodeRLC:
+            return prefix + "rlc_ucode.bin";
+        case kUCodeSDMA0:
+            return attributes.isNavi21() ? "sdma_5_2_ucode.bin" :
+                   attributes.isNavi22() ? "sdma_5_2_2_ucode.bin" :
+                                           "sdma_5_2_4_ucode.bin";
+        case kUCodeVCN0:
+        case kUCodeVCN1:
+            return "ativvaxy_vcn3.dat";
+        case kUCodeRLCP:
+            return prefix + "rlcp_ucode.bin";
+        case kUCodeRLCSRListGPM:
+            return prefix + "rlc_srlist_gpm_mem.bin";
+        case kUCodeRLCSRListSRM:
+            return prefix + "rlc_srlist_srm_mem.bin";
+        case kUCodeRLCSRListCntl:
+            return prefix + "rlc_srlist_cntl.bin";
+        case kUCodeRLCLX6Iram:
+            return prefix + "rlc_lx6_iram_ucode.bin";
+        case kUCodeRLCLX6Dram:
+            return prefix + "rlc_lx6_dram_ucode.bin";
+        case kUCodeGlobalTapDelays:
+            return prefix + "global_tap_delays.bin";
+        case kUCodeSE0TapDelays:
+            return prefix + "se0_tap_delays.bin";
+        case kUCodeSE1TapDelays:
+            return prefix + "se1_tap_delays.bin";
+        case kUCodeSE2TapDelays:
+            return prefix + "se2_tap_delays.bin";
+        case kUCodeSE3TapDelays:
+            return prefix + "se3_tap_delays.bin";
+        case kUCodeDMCUB:
+            return attributes.isNavi23() ? "atidmcub_instruction_dcn302.bin" : "atidmcub_instruction_dcn30.bin";
+        default:
+            return "";
+    }
+}
+
+static bool findLinearly(const char *name) {
+    for (size_t i = 0; i < firmwareCount; i++) {
+        if (!strcmp(firmware[i].name, name)) { return true; }
+    }
+    return false;
+}
+
+TEST(ipFirmwareMatchesTheSwitchForEveryNavi) {
+    static const UInt8 navis[] = {NootRXAttributes::Navi21, NootRXAttributes::Navi22, NootRXAttributes::Navi23};
+
+    size_t loaded = 0;
+    for (auto navi : navis) {
+        NootRXAttributes attributes {};
+        if (navi == NootRXAttributes::Navi21) { attributes.setNavi21(); }
+        if (navi == NootRXAttributes::Navi22) { attributes.setNavi22(); }
+        if (navi == NootRXAttributes::Navi23) { attributes.setNavi23(); }
+
+        const FWMetadata *ipFirmware[kUCodeVCN1 + 1] {};
+        resolveIPFirmware(attributes, ipFirmware);
+        for (UInt32 id = 0; id < arrsize(ipFirmware); id++) {
+            auto expected = getSwitchFirmware(attributes, id);
+            if (expected.empty() || !findLinearly(expected.c_str())) {
+                CHECK(ipFirmware[id] == nullptr);
+                continue;
+            }
+            // The slot has to be the generated table's entry for that name, not just a blob of the same contents.
+            REQUIRE(ipFirmware[id] != nullptr);
+            const auto &entry = firmware[getFWSlot(getFWNameHash(expected.c_str()))];
+            CHECK(entry.name == expected);
+            CHECK(ipFirmware[id] == &entry.metadata);
+            loaded += 1;
+        }
+    }
+    CHECK(loaded == 3 * arrsize(ipFirmwareNames) - 4);
+}
+
+TEST(pspApplicationsHaveFirmware) {
+    for (const auto &entry : pspApplicationFirmware) {
+        const auto &fw = firmware[getFWSlot(entry.firmware.hash)];
+        CHECK(!strcmp(fw.name, entry.firmware.name));
+    }
+}
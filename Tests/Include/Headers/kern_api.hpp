@@ -0,0 +1,49 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+// Host stand-in for the parts of Lilu's kern_api.hpp, and the kernel vnode calls it brings in, that the tested sources
+// use.
+
+#pragma once
+#include <Headers/kern_util.hpp>
+#include <cerrno>
+
+class LiluAPI {
+    public:
+    enum RunningMode : UInt32 {
+        RunningNormal = 1,
+        RunningInstallerRecovery = 2,
+        RunningSafeMode = 4,
+    };
+
+    UInt32 getRunMode() const { return this->runMode; }
+
+    UInt32 runMode {RunningNormal};
+};
+
+inline LiluAPI lilu {};
+
+class UserPatcher {
+    public:
+    // The shared cache in use, every file under it matches. Lilu picks it from the running macOS version.
+    static inline const char *sharedCachePath {"/System/Library/dyld/dyld_shared_cache_x86_64"};
+
+    static bool matchSharedCachePath(const char *path) {
+        return !strncmp(path, sharedCachePath, strlen(sharedCachePath));
+    }
+};
+
+// A file as the tests see it, a path that is null for a vnode that has none.
+struct vnode {
+    const char *path;
+    UInt32 vid;
+};
+
+inline UInt32 vnode_vid(vnode_t vp) { return vp->vid; }
+
+inline int vn_getpath(vnode_t vp, char *path, int *len) {
+    if (!vp->path || strlen(vp->path) >= static_cast<size_t>(*len)) { return ENOSPC; }
+    *len = static_cast<int>(strlen(vp->path) + 1);
+    memcpy(path, vp->path, *len);
+    return 0;
+}
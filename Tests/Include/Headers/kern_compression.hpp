@@ -0,0 +1,22 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+// Host stand-in for Lilu's Compression, backed by the system zlib.
+
+#pragma once
+#include <Headers/kern_util.hpp>
+#include <zlib.h>
+
+namespace Compression {
+    enum : UInt32 {
+        ModeLZSS = 0x6C7A7373,
+        ModeLZVN = 0x6C7A766E,
+        ModeZLIB = 0x7A6C6962,
+    };
+
+    inline UInt8 *decompress(UInt32, UInt32 dstlen, const UInt8 *src, UInt32 srclen, UInt8 *buffer) {
+        uLongf size = dstlen;
+        if (uncompress(buffer, &size, src, srclen) != Z_OK || size != dstlen) { return nullptr; }
+        return buffer;
+    }
+}    // namespace Compression
@@ -0,0 +1,17 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+// Host stand-in for Lilu's BaseDeviceInfo.
+
+#pragma once
+#include <Headers/kern_util.hpp>
+
+class BaseDeviceInfo {
+    public:
+    char modelIdentifier[48] {"iMacPro1,1"};
+
+    static const BaseDeviceInfo &get() {
+        static BaseDeviceInfo info {};
+        return info;
+    }
+};
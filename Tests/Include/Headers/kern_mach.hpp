@@ -0,0 +1,18 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+// Host stand-in for Lilu's MachInfo, kernel writing can be made to fail.
+
+#pragma once
+#include <Headers/kern_util.hpp>
+#include <mach-o/loader.h>
+
+struct MachInfo {
+    static inline kern_return_t writingResult {KERN_SUCCESS};
+    static inline size_t writingEnables {0};
+
+    static kern_return_t setKernelWriting(bool enable, IOSimpleLock *) {
+        if (enable && writingResult == KERN_SUCCESS) { writingEnables += 1; }
+        return writingResult;
+    }
+};
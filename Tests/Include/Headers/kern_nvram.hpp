@@ -0,0 +1,28 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+// Host stand-in for Lilu's NVStorage, which is never available on the host.
+
+#pragma once
+#include <Headers/kern_util.hpp>
+
+#define LILU_VENDOR_GUID         "E09B9297-7928-4440-9AAB-D1F8536FBF0A"
+#define NVRAM_SEP                ":"
+#define NVRAM_PREFIX(vendor, name) vendor NVRAM_SEP name
+
+class NVStorage {
+    public:
+    enum Options : UInt8 {
+        OptAuthenticate = 1,
+        OptEncrypted = 2,
+        OptCompressed = 4,
+        OptChecksum = 8,
+        OptRaw = 16,
+        OptSensitive = 32,
+    };
+
+    bool init() { return false; }
+    void deinit() {}
+    UInt8 *read(const char *, UInt32 &, UInt8 = 0, const UInt8 * = nullptr) { return nullptr; }
+    bool write(const char *, const UInt8 *, UInt32, UInt8 = 0, const UInt8 * = nullptr) { return false; }
+};
@@ -0,0 +1,159 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+// Host stand-in for Lilu's KernelPatcher, with the pattern search semantics of the real one and routing that can be
+// made to fail or observed.
+
+#pragma once
+#include <Headers/kern_mach.hpp>
+#include <Headers/kern_util.hpp>
+
+class KernelPatcher {
+    public:
+    enum class Error {
+        NoError,
+        SymbolNotFound,
+        MemoryProtection,
+    };
+
+    static constexpr size_t KernelID = 0;
+    static inline IOSimpleLock *kernelWriteLock {nullptr};
+
+    struct KextInfo {
+        static constexpr size_t Unloaded = ~static_cast<size_t>(0);
+        const char *id;
+        const char **paths;
+        size_t pathNum;
+        bool sys[2];
+        bool user[2];
+        size_t loadIndex;
+    };
+
+    struct SolveRequest {
+        const char *symbol {nullptr};
+        mach_vm_address_t *address {nullptr};
+
+        template<typename T>
+        SolveRequest(const char *s, T &addr) : symbol {s}, address {reinterpret_cast<mach_vm_address_t *>(&addr)} {}
+    };
+
+    struct RouteRequest {
+        const char *symbol {nullptr};
+        mach_vm_address_t to {0};
+        mach_vm_address_t *org {nullptr};
+
+        template<typename T>
+        RouteRequest(const char *s, T t, mach_vm_address_t &o)
+            : symbol {s}, to {reinterpret_cast<mach_vm_address_t>(t)}, org {&o} {}
+
+        template<typename T, typename O>
+        RouteRequest(const char *s, T t, O &o)
+            : symbol {s}, to {reinterpret_cast<mach_vm_address_t>(t)},
+              org {reinterpret_cast<mach_vm_address_t *>(&o)} {}
+
+        template<typename T>
+        RouteRequest(const char *s, T t) : symbol {s}, to {reinterpret_cast<mach_vm_address_t>(t)} {}
+    };
+
+    struct LookupPatch {
+        KextInfo *kext;
+        const UInt8 *find;
+        const UInt8 *replace;
+        size_t size;
+        size_t count;
+    };
+
+    // Returns the trampoline for a route, or 0 to fail it. Routes succeed with `from` as the trampoline when unset.
+    using RouteHook = mach_vm_address_t (*)(void *context, mach_vm_address_t from, mach_vm_address_t to);
+
+    RouteHook routeHook {nullptr};
+    void *routeContext {nullptr};
+
+    // Returns the address of a symbol, or 0 if it isn't found. Every symbol is missing when unset.
+    using SolveHook = mach_vm_address_t (*)(void *context, const char *symbol);
+
+    SolveHook solveHook {nullptr};
+    void *solveContext {nullptr};
+
+    Error getError() const { return this->error; }
+    void clearError() { this->error = Error::NoError; }
+
+    mach_vm_address_t solveSymbol(size_t, const char *symbol) {
+        auto ret = this->solveHook ? this->solveHook(this->solveContext, symbol) : 0;
+        if (!ret) { this->error = Error::SymbolNotFound; }
+        return ret;
+    }
+
+    mach_vm_address_t routeFunction(mach_vm_address_t from, mach_vm_address_t to, bool = false, bool = true,
+        bool = false) {
+        auto ret = this->routeHook ? this->routeHook(this->routeContext, from, to) : from;
+        if (!ret) { this->error = Error::MemoryProtection; }
+        return ret;
+    }
+
+    // Symbols aren't solved, so the hook sees every route from 0 and its result becomes the original.
+    bool routeMultipleLong(size_t, RouteRequest *requests, size_t num, mach_vm_address_t = 0, size_t = 0,
+        bool = true, bool = false) {
+        if (!this->routeHook) { return true; }
+        for (size_t i = 0; i < num; i++) {
+            auto org = this->routeHook(this->routeContext, 0, requests[i].to);
+            if (!org) {
+                this->error = Error::MemoryProtection;
+                return false;
+            }
+            if (requests[i].org) { *requests[i].org = org; }
+        }
+        return true;
+    }
+
+    static bool findPattern(const void *pattern, const void *patternMask, size_t patternSize, const void *data,
+        size_t dataSize, size_t *dataOffset) {
+        if (patternSize == 0 || dataSize < patternSize) { return false; }
+        auto *bytes = static_cast<const UInt8 *>(data);
+        auto *find = static_cast<const UInt8 *>(pattern);
+        auto *mask = static_cast<const UInt8 *>(patternMask);
+        for (auto start = *dataOffset; start <= dataSize - patternSize; start++) {
+            size_t i = 0;
+            for (; i < patternSize; i++) {
+                UInt8 byteMask = mask ? mask[i] : 0xFF;
+                if ((bytes[start + i] & byteMask) != (find[i] & byteMask)) { break; }
+            }
+            if (i == patternSize) {
+                *dataOffset = start;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool findAndReplaceWithMask(void *data, size_t dataSize, const void *find, size_t findSize,
+        const void *findMask, size_t, const void *replace, size_t replaceSize, const void *replaceMask, size_t,
+        size_t count = 0, size_t skip = 0) {
+        auto *bytes = static_cast<UInt8 *>(data);
+        auto *with = static_cast<const UInt8 *>(replace);
+        auto *withMask = static_cast<const UInt8 *>(replaceMask);
+        size_t replaced = 0, offset = 0;
+        while (findPattern(find, findMask, findSize, data, dataSize, &offset)) {
+            if (skip) {
+                skip -= 1;
+                offset += findSize;
+                continue;
+            }
+            for (size_t i = 0; i < replaceSize; i++) {
+                bytes[offset + i] = withMask ? (bytes[offset + i] & ~withMask[i]) | (with[i] & withMask[i]) : with[i];
+            }
+            replaced += 1;
+            offset += replaceSize;
+            if (count && replaced == count) { break; }
+        }
+        return replaced != 0;
+    }
+
+    static bool findAndReplace(void *data, size_t dataSize, const void *find, size_t findSize, const void *replace,
+        size_t replaceSize) {
+        return findAndReplaceWithMask(data, dataSize, find, findSize, nullptr, 0, replace, replaceSize, nullptr, 0);
+    }
+
+    private:
+    Error error {Error::NoError};
+};
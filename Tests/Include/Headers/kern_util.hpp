@@ -0,0 +1,102 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+// Host stand-in for the parts of Lilu's kern_util.hpp the tested sources use.
+
+#pragma once
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+typedef uint8_t UInt8;
+typedef uint16_t UInt16;
+typedef uint32_t UInt32;
+typedef unsigned long long UInt64;
+typedef int8_t SInt8;
+typedef int16_t SInt16;
+typedef int32_t SInt32;
+typedef int64_t SInt64;
+typedef unsigned long long mach_vm_address_t;
+typedef uint64_t vm_address_t;
+typedef int kern_return_t;
+typedef int IOReturn;
+typedef uint64_t memory_object_offset_t;
+typedef void *memory_object_t;
+struct vnode;
+typedef vnode *vnode_t;
+struct IOSimpleLock;
+
+#define KERN_SUCCESS 0
+#define KERN_FAILURE 5
+#ifndef PAGE_SIZE
+    #define PAGE_SIZE 4096
+#endif
+#ifndef PATH_MAX
+    #define PATH_MAX 1024
+#endif
+#define PACKED       __attribute__((packed))
+#define LIKELY(x)    __builtin_expect(!!(x), 1)
+#define UNLIKELY(x)  __builtin_expect(!!(x), 0)
+#define EXPORT
+#define ADDPR(x) x
+
+extern bool debugEnabled;
+
+// Logs are only printed with `NOOTRX_TEST_VERBOSE` set, but always type checked.
+#define DBGLOG(mod, fmt, ...)                                                        \
+    do {                                                                             \
+        if (debugEnabled) { fprintf(stderr, "[%s] " fmt "\n", mod, ##__VA_ARGS__); } \
+    } while (0)
+#define SYSLOG(mod, fmt, ...) DBGLOG(mod, fmt, ##__VA_ARGS__)
+#define DBGLOG_COND(c, mod, fmt, ...)               \
+    do {                                            \
+        if (c) { DBGLOG(mod, fmt, ##__VA_ARGS__); } \
+    } while (0)
+#define SYSLOG_COND(c, mod, fmt, ...) DBGLOG_COND(c, mod, fmt, ##__VA_ARGS__)
+#define PANIC(mod, fmt, ...)                                         \
+    do {                                                             \
+        fprintf(stderr, "PANIC [%s] " fmt "\n", mod, ##__VA_ARGS__); \
+        abort();                                                     \
+    } while (0)
+#define PANIC_COND(c, mod, fmt, ...)               \
+    do {                                           \
+        if (c) { PANIC(mod, fmt, ##__VA_ARGS__); } \
+    } while (0)
+
+template<typename T, size_t N>
+constexpr size_t arrsize(const T (&)[N]) {
+    return N;
+}
+
+inline const char *safeString(const char *str) { return str ? str : "(null)"; }
+
+template<typename T>
+T &getMember(void *that, size_t offset) {
+    return *reinterpret_cast<T *>(static_cast<UInt8 *>(that) + offset);
+}
+
+template<typename T, typename P>
+T FunctionCast(T, P ptr) {
+    return reinterpret_cast<T>(ptr);
+}
+
+inline void lilu_os_memcpy(void *dst, const void *src, size_t size) { memcpy(dst, src, size); }
+
+inline void *lilu_os_memmem(const void *big, size_t bigSize, const void *little, size_t littleSize) {
+    return memmem(big, bigSize, little, littleSize);
+}
+
+namespace Buffer {
+    template<typename T>
+    T *create(size_t size) {
+        return static_cast<T *>(malloc(sizeof(T) * size));
+    }
+
+    template<typename T>
+    void deleter(T *ptr) {
+        free(ptr);
+    }
+}    // namespace Buffer
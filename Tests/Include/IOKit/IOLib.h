@@ -0,0 +1,18 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+// Host stand-in for IOKit/IOLib.h.
+
+#pragma once
+#include <Headers/kern_util.hpp>
+
+// Allocations fail once this many more have been made, for out of memory paths. Negative never fails.
+inline long ioMallocFailAfter = -1;
+
+inline void *IOMalloc(size_t size) {
+    if (ioMallocFailAfter == 0) { return nullptr; }
+    if (ioMallocFailAfter > 0) { ioMallocFailAfter -= 1; }
+    return malloc(size);
+}
+
+inline void IOFree(void *ptr, size_t) { free(ptr); }
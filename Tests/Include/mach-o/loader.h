@@ -0,0 +1,58 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+// The Mach-O structures KextImage reads, laid out as in the SDK.
+
+#pragma once
+#include <cstdint>
+
+typedef int cpu_type_t;
+typedef int cpu_subtype_t;
+typedef int vm_prot_t;
+
+#define MH_MAGIC_64        0xFEEDFACF
+#define MH_KEXT_BUNDLE     0xB
+#define MH_FILESET         0xC
+#define LC_SYMTAB          0x2
+#define LC_SEGMENT_64      0x19
+#define LC_UUID            0x1B
+#define LC_FUNCTION_STARTS 0x26
+
+struct mach_header_64 {
+    uint32_t magic;
+    cpu_type_t cputype;
+    cpu_subtype_t cpusubtype;
+    uint32_t filetype, ncmds, sizeofcmds, flags, reserved;
+};
+
+struct load_command {
+    uint32_t cmd, cmdsize;
+};
+
+struct segment_command_64 {
+    uint32_t cmd, cmdsize;
+    char segname[16];
+    uint64_t vmaddr, vmsize, fileoff, filesize;
+    vm_prot_t maxprot, initprot;
+    uint32_t nsects, flags;
+};
+
+struct section_64 {
+    char sectname[16];
+    char segname[16];
+    uint64_t addr, size;
+    uint32_t offset, align, reloff, nreloc, flags, reserved1, reserved2, reserved3;
+};
+
+struct uuid_command {
+    uint32_t cmd, cmdsize;
+    uint8_t uuid[16];
+};
+
+struct linkedit_data_command {
+    uint32_t cmd, cmdsize, dataoff, datasize;
+};
+
+struct symtab_command {
+    uint32_t cmd, cmdsize, symoff, nsyms, stroff, strsize;
+};
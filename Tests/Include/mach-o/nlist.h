@@ -0,0 +1,20 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#pragma once
+#include <cstdint>
+
+#define N_STAB 0xE0
+#define N_UNDF 0x0
+#define N_TYPE 0x0E
+#define N_SECT 0xE
+#define N_EXT  0x01
+
+struct nlist_64 {
+    union {
+        uint32_t n_strx;
+    } n_un;
+    uint8_t n_type, n_sect;
+    uint16_t n_desc;
+    uint64_t n_value;
+};
@@ -0,0 +1,53 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "KextImage.hpp"
+#include "MachOFixture.hpp"
+#include "Test.hpp"
+#include <string>
+
+static constexpr size_t ImageSize = 8 * 1024 * 1024;
+static constexpr size_t SymbolCount = 40000;
+static constexpr size_t SolvedCount = 16;
+
+// A symbol table the size of HWLibs' with names that share prefixes the way its C and C++ symbols do.
+static MachOFixture *makeKext(std::vector<std::string> &names) {
+    static const char *const stems[] = {"_gc_", "_psp_", "_smu_", "_dcn_", "__ZN16AmdRadeonHWLibs", "__ZN11AMDRadeonX"};
+    auto *fixture = new MachOFixture {ImageSize, 0, 0x1000};
+    fixture->addSegment("__TEXT", 0, ImageSize / 2, {{"__TEXT", "__text", 0x1000, ImageSize / 2 - 0x1000}});
+    fixture->addSegment("__LINKEDIT", ImageSize / 2, ImageSize / 2);
+    TestRandom random {12};
+    std::vector<MachOFixture::Symbol> symbols;
+    for (size_t i = 0; i < SymbolCount; i++) {
+        names.push_back(std::string(stems[random.below(arrsize(stems))]) + "function_" + std::to_string(i));
+    }
+    for (size_t i = 0; i < SymbolCount; i++) { symbols.push_back({names[i].c_str(), 0x1000 + i * 0x40}); }
+    fixture->addSymbols(symbols);
+    return fixture;
+}
+
+// What solving the names one by one costs: a walk over the symbol table per name.
+static size_t solveEach(const KextImage &image, const char *const *names, size_t count, size_t *offsets) {
+    size_t found = 0;
+    for (size_t i = 0; i < count; i++) { found += image.solveSymbols(names + i, 1, offsets + i); }
+    return found;
+}
+
+BENCH(batchedSymbolSolving) {
+    std::vector<std::string> names;
+    auto *fixture = makeKext(names);
+    KextImage image {};
+    image.parse(fixture->getAddress(), ImageSize);
+
+    // Spread over the table, like the symbols the HWLibs patches need.
+    const char *solved[SolvedCount];
+    for (size_t i = 0; i < SolvedCount; i++) {
+        solved[i] = names[SymbolCount / 2 + i * (SymbolCount / 2 / SolvedCount)].c_str();
+    }
+    size_t offsets[SolvedCount];
+
+    printf("    %zu symbols, %zu names solved\n", SymbolCount, SolvedCount);
+    measure("one walk per name", 20, [&] { keep(solveEach(image, solved, SolvedCount, offsets)); });
+    measure("solveSymbols", 20, [&] { keep(image.solveSymbols(solved, SolvedCount, offsets)); });
+    delete fixture;
+}
@@ -0,0 +1,219 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "KextImage.hpp"
+#include "MachOFixture.hpp"
+#include "Test.hpp"
+
+static constexpr UInt64 CollectionBase = 0xFFFFFF8000100000;
+
+static const char *const solvedNames[] = {"_gc_10_3_init", "__ZN4Kext5startEv", "_missing"};
+
+// The layout of an x86_64 kext in a boot kernel collection as of Ventura and Sonoma: the kext's segments are
+// contiguous and carry the file offsets they have in the collection, while __LINKEDIT is the collection's, shared by
+// every kext in it and outside of this one. `linkeditOffset` is relative to the kext header.
+static void buildCollectionKext(MachOFixture &fixture, SInt64 linkeditOffset) {
+    fixture.map();
+    KextImage::setMappedCheck(MachOFixture::isMapped);
+    fixture.addSegment("__TEXT", 0, 0x2000,
+        {{"__TEXT", "__const", 0x1000, 0x400}, {"__TEXT", "__cstring", 0x1400, 0x200}});
+    fixture.addSegment("__TEXT_EXEC", 0x2000, 0x3000, {{"__TEXT_EXEC", "__text", 0x2000, 0x3000}});
+    fixture.addSegment("__DATA", 0x5000, 0x1000);
+    fixture.addSegment("__DATA_CONST", 0x6000, 0x2000);
+    fixture.addSegment("__LINKEDIT", linkeditOffset, 0x1000);
+    fixture.addUUID(0x40);
+    fixture.addFunctionStarts({0x2000, 0x2100, 0x2A40});
+    fixture.addSymbols({{"_gc_10_3_init", 0x2100}, {"__ZN4Kext5startEv", 0x2A40}, {"_data", 0x5010}});
+}
+
+static void checkCollectionKext(MachOFixture &fixture) {
+    KextImage image {};
+    REQUIRE(image.parse(fixture.getAddress(), 0x8000));
+    CHECK(image.isInCollection());
+
+    ScanRange ranges[KextImage::MaxRanges];
+    CHECK(image.getRanges(PatternSection::Code, ranges) == 1);
+    CHECK(ranges[0].offset == 0x2000 && ranges[0].size == 0x3000);
+    CHECK(image.getRanges(PatternSection::CString, ranges) == 1);
+    CHECK(ranges[0].offset == 0x1400 && ranges[0].size == 0x200);
+    REQUIRE(image.getRanges(PatternSection::Data, ranges) == 3);
+    CHECK(ranges[0].offset == 0x1000 && ranges[1].offset == 0x5000 && ranges[2].offset == 0x6000);
+
+    REQUIRE(image.getUUID());
+    CHECK(image.getUUID()[0] == 0x40 && image.getUUID()[15] == 0x4F);
+
+    REQUIRE(image.getFunctionStartCount() == 3);
+    CHECK(image.getFunctionStarts()[0] == 0x2000);
+    CHECK(image.getFunctionStarts()[1] == 0x2100);
+    CHECK(image.getFunctionStarts()[2] == 0x2A40);
+
+    REQUIRE(image.hasSymbols());
+    size_t offsets[arrsize(solvedNames)];
+    CHECK(image.solveSymbols(solvedNames, arrsize(solvedNames), offsets) == 2);
+    CHECK(offsets[0] == 0x2100 && offsets[1] == 0x2A40 && offsets[2] == 0);
+}
+
+TEST(parsesCollectionKextWithLinkeditAfterIt) {
+    MachOFixture fixture {0x40000, 0x10000, CollectionBase};
+    buildCollectionKext(fixture, 0x20000);
+    checkCollectionKext(fixture);
+}
+
+TEST(parsesCollectionKextWithLinkeditBeforeIt) {
+    MachOFixture fixture {0x40000, 0x30000, CollectionBase};
+    buildCollectionKext(fixture, -0x28000);
+    checkCollectionKext(fixture);
+}
+
+// The collection's __LINKEDIT may be gone, it is never read without knowing that it is mapped.
+TEST(ignoresCollectionLinkeditThatIsNotMapped) {
+    MachOFixture fixture {0x40000, 0x10000, CollectionBase};
+    buildCollectionKext(fixture, 0x20000);
+    size_t offsets[arrsize(solvedNames)];
+    for (size_t i = 0; i < 2; i++) {
+        if (i) {
+            fixture.jettisonLinkedit();
+        } else {
+            KextImage::setMappedCheck(nullptr);
+        }
+        KextImage image {};
+        REQUIRE(image.parse(fixture.getAddress(), 0x8000));
+        CHECK(image.getUUID());
+        CHECK(image.getFunctionStartCount() == 0);
+        CHECK(!image.hasSymbols());
+        CHECK(image.solveSymbols(solvedNames, arrsize(solvedNames), offsets) == 0);
+        KextImage::setMappedCheck(MachOFixture::isMapped);
+    }
+}
+
+TEST(stopsSolvingOnceLinkeditIsJettisoned) {
+    MachOFixture fixture {0x40000, 0x10000, CollectionBase};
+    buildCollectionKext(fixture, 0x20000);
+    KextImage image {};
+    REQUIRE(image.parse(fixture.getAddress(), 0x8000));
+    REQUIRE(image.hasSymbols());
+    fixture.jettisonLinkedit();
+    CHECK(!image.hasSymbols());
+    size_t offsets[arrsize(solvedNames)];
+    CHECK(image.solveSymbols(solvedNames, arrsize(solvedNames), offsets) == 0);
+    // What was copied out while it was mapped stays.
+    CHECK(image.getFunctionStartCount() == 3);
+}
+
+TEST(parsesStandaloneKext) {
+    MachOFixture fixture {0x10000, 0, 0x1000};
+    fixture.addSegment("__TEXT", 0, 0x8000,
+        {{"__TEXT", "__text", 0x1000, 0x3000}, {"__TEXT", "__cstring", 0x5000, 0x1000}});
+    fixture.addSegment("__DATA", 0x8000, 0x100000);
+    fixture.addSegment("__LINKEDIT", 0xF000, 0x1000);
+    fixture.addFunctionStarts({0x1000, 0x1800});
+    fixture.addSymbols({{"_gc_10_3_init", 0x1800}});
+
+    KextImage image {};
+    REQUIRE(image.parse(fixture.getAddress(), 0x10000));
+    CHECK(!image.isInCollection());
+
+    ScanRange ranges[KextImage::MaxRanges];
+    CHECK(image.getRanges(PatternSection::Code, ranges) == 1);
+    CHECK(ranges[0].offset == 0x1000 && ranges[0].size == 0x3000);
+    // Clamped to the image.
+    CHECK(image.getRanges(PatternSection::Data, ranges) == 1);
+    CHECK(ranges[0].offset == 0x8000 && ranges[0].size == 0x8000);
+    CHECK(image.getRanges(PatternSection::Any, ranges) == 1);
+    CHECK(ranges[0].offset == 0 && ranges[0].size == 0x10000);
+
+    CHECK(image.getFunctionStartCount() == 2);
+    size_t offsets[arrsize(solvedNames)];
+    CHECK(image.solveSymbols(solvedNames, arrsize(solvedNames), offsets) == 1);
+    CHECK(offsets[0] == 0x1800);
+}
+
+TEST(ignoresStandaloneLinkeditOutsideTheImage) {
+    MachOFixture fixture {0x20000, 0, 0};
+    fixture.addSegment("__TEXT", 0, 0x8000, {{"__TEXT", "__text", 0x1000, 0x3000}});
+    fixture.addSegment("__LINKEDIT", 0x10000, 0x1000);
+    fixture.addFunctionStarts({0x1000});
+    fixture.addSymbols({{"_gc_10_3_init", 0x1800}});
+
+    // Only the first 0x10000 bytes are the loaded image.
+    KextImage image {};
+    REQUIRE(image.parse(fixture.getAddress(), 0x10000));
+    CHECK(!image.hasSymbols());
+    CHECK(image.getFunctionStartCount() == 0);
+    ScanRange ranges[KextImage::MaxRanges];
+    CHECK(image.getRanges(PatternSection::Code, ranges) == 1);
+}
+
+TEST(ignoresLinkeditDataPastTheSegment) {
+    MachOFixture fixture {0x40000, 0x10000, CollectionBase};
+    fixture.addSegment("__TEXT", 0, 0x2000);
+    // The symbol table is written past the 0x10 bytes the segment covers.
+    fixture.addSegment("__LINKEDIT", 0x20000, 0x10);
+    fixture.addSymbols({{"_gc_10_3_init", 0x1800}, {"_other", 0x1900}});
+
+    KextImage image {};
+    REQUIRE(image.parse(fixture.getAddress(), 0x8000));
+    CHECK(!image.hasSymbols());
+}
+
+TEST(fallsBackToTheSegmentAtFileOffsetZero) {
+    MachOFixture fixture {0x10000, 0, 0x4000};
+    fixture.addSegment("__KLD", 0, 0x8000, {{"__TEXT", "__text", 0x1000, 0x1000}});
+
+    KextImage image {};
+    REQUIRE(image.parse(fixture.getAddress(), 0x10000));
+    ScanRange ranges[KextImage::MaxRanges];
+    CHECK(image.getRanges(PatternSection::Code, ranges) == 1);
+    CHECK(ranges[0].offset == 0x1000);
+}
+
+TEST(rejectsBrokenHeaders) {
+    MachOFixture fixture {0x10000, 0, 0};
+    fixture.addSegment("__TEXT", 0, 0x8000);
+    fixture.getFile()[0] = 0;
+
+    KextImage image {};
+    CHECK(!image.parse(fixture.getAddress(), 0x10000));
+    ScanRange ranges[KextImage::MaxRanges];
+    CHECK(image.getRanges(PatternSection::Code, ranges) == 1);
+    CHECK(ranges[0].offset == 0 && ranges[0].size == 0x10000);
+}
+
+TEST(solvesSymbolsSharingAPrefix) {
+    MachOFixture fixture {0x10000, 0, 0x1000};
+    fixture.addSegment("__TEXT", 0, 0x8000, {{"__TEXT", "__text", 0x1000, 0x6000}});
+    fixture.addSegment("__LINKEDIT", 0xF000, 0x1000);
+    fixture.addSymbols({
+        {"_psp_cmd_km_submit_internal", 0x1100},
+        {"_psp_cmd_km_submit", 0x1200},
+        {"_psp_cmd_km_submit", 0x1300},
+        {"_psp_cmd", 0x1400, N_UNDF | N_EXT},
+        {"_psp_cmd", 0x1500, N_SECT | N_STAB},
+        {"_psp", 0x1600},
+        {"_psp_cmd", 0x1700},
+        {"_header", 0},
+    });
+
+    KextImage image {};
+    REQUIRE(image.parse(fixture.getAddress(), 0x10000));
+    static const char *const names[] = {"_psp_cmd_km_submit", "_psp_cmd", "_psp", "_psp_c", "_header", "_psp"};
+    size_t offsets[arrsize(names)];
+    CHECK(image.solveSymbols(names, arrsize(names), offsets) == 4);
+    // The first definition wins, undefined and debug symbols and the header are skipped.
+    CHECK(offsets[0] == 0x1200);
+    CHECK(offsets[1] == 0x1700);
+    CHECK(offsets[2] == 0x1600 && offsets[5] == 0x1600);
+    CHECK(offsets[3] == 0 && offsets[4] == 0);
+}
+
+TEST(solvesNothingWithoutASymbolTable) {
+    MachOFixture fixture {0x10000, 0, 0x1000};
+    fixture.addSegment("__TEXT", 0, 0x8000, {{"__TEXT", "__text", 0x1000, 0x6000}});
+
+    KextImage image {};
+    REQUIRE(image.parse(fixture.getAddress(), 0x10000));
+    CHECK(!image.hasSymbols());
+    size_t offsets[arrsize(solvedNames)];
+    CHECK(image.solveSymbols(solvedNames, arrsize(solvedNames), offsets) == 0);
+    CHECK(offsets[0] == 0 && offsets[1] == 0 && offsets[2] == 0);
+}
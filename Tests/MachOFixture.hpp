@@ -0,0 +1,170 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#pragma once
+#include <Headers/kern_util.hpp>
+#include <initializer_list>
+#include <mach-o/loader.h>
+#include <mach-o/nlist.h>
+#include <string>
+#include <vector>
+
+// Builds the load commands and __LINKEDIT contents of a synthetic kext in a zero-filled file.
+// Everything is placed by file offset and mapped at `vmBase + file offset`, which is how both a standalone kext
+// (header at offset 0) and a kext in a kernel collection (header further in, __LINKEDIT shared) are laid out.
+class MachOFixture {
+    public:
+    struct Section {
+        const char *segment, *name;
+        size_t offset, size;    // Relative to the header
+    };
+
+    struct Symbol {
+        const char *name;
+        size_t offset;    // Relative to the header
+        UInt8 type {N_SECT | N_EXT};
+    };
+
+    MachOFixture(size_t fileSize, size_t headerOffset, UInt64 vmBase)
+        : file(fileSize, 0x90), headerOffset {headerOffset}, vmBase {vmBase} {
+        auto *header = this->getHeader();
+        memset(header, 0, sizeof(*header));
+        header->magic = MH_MAGIC_64;
+        header->filetype = MH_KEXT_BUNDLE;
+    }
+
+    ~MachOFixture() {
+        if (mappedFixture == this) { mappedFixture = nullptr; }
+    }
+
+    // Stands in for the kernel's page tables: the file of the fixture that last called `map` is mapped, apart from a
+    // __LINKEDIT removed by `jettisonLinkedit`.
+    static bool isMapped(mach_vm_address_t address, size_t size) {
+        auto *fixture = mappedFixture;
+        if (!fixture) { return false; }
+        auto offset = address - reinterpret_cast<mach_vm_address_t>(fixture->file.data());
+        if (offset > fixture->file.size() || size > fixture->file.size() - offset) { return false; }
+        return !fixture->linkeditJettisoned || offset + size <= fixture->linkeditStart ||
+               offset >= fixture->linkeditEnd;
+    }
+
+    void map() {
+        mappedFixture = this;
+        this->linkeditJettisoned = false;
+    }
+    void jettisonLinkedit() { this->linkeditJettisoned = true; }
+
+    UInt8 *getFile() { return this->file.data(); }
+    mach_vm_address_t getAddress() {
+        return reinterpret_cast<mach_vm_address_t>(this->file.data() + this->headerOffset);
+    }
+    UInt64 getVMAddress(size_t offset) const { return this->vmBase + this->headerOffset + offset; }
+
+    // `offset` and `size` are relative to the header, the segment may lie before it.
+    void addSegment(const char *name, SInt64 offset, size_t size, std::initializer_list<Section> sections = {}) {
+        auto *segment = this->addCommand<segment_command_64>(LC_SEGMENT_64,
+            sizeof(segment_command_64) + sections.size() * sizeof(section_64));
+        strncpy(segment->segname, name, sizeof(segment->segname));
+        segment->vmaddr = this->vmBase + this->headerOffset + offset;
+        segment->vmsize = size;
+        segment->fileoff = this->headerOffset + offset;
+        segment->filesize = size;
+        segment->nsects = static_cast<UInt32>(sections.size());
+        auto *out = reinterpret_cast<section_64 *>(segment + 1);
+        for (auto &section : sections) {
+            strncpy(out->segname, section.segment, sizeof(out->segname));
+            strncpy(out->sectname, section.name, sizeof(out->sectname));
+            out->addr = this->getVMAddress(section.offset);
+            out->size = section.size;
+            out->offset = static_cast<UInt32>(this->headerOffset + section.offset);
+            out++;
+        }
+        if (!strcmp(name, "__LINKEDIT")) {
+            this->linkeditCursor = this->linkeditStart = static_cast<size_t>(segment->fileoff);
+            this->linkeditEnd = this->linkeditStart + size;
+        }
+    }
+
+    void addUUID(UInt8 seed) {
+        auto *command = this->addCommand<uuid_command>(LC_UUID, sizeof(uuid_command));
+        for (size_t i = 0; i < sizeof(command->uuid); i++) { command->uuid[i] = static_cast<UInt8>(seed + i); }
+    }
+
+    // Writes ULEB128 deltas into __LINKEDIT, which has to be added first.
+    void addFunctionStarts(std::initializer_list<size_t> starts, size_t textOffset = 0) {
+        std::vector<UInt8> data;
+        size_t previous = textOffset;
+        for (auto start : starts) {
+            for (auto delta = start - previous;;) {
+                UInt8 byte = delta & 0x7F;
+                delta >>= 7;
+                data.push_back(delta ? byte | 0x80 : byte);
+                if (!delta) { break; }
+            }
+            previous = start;
+        }
+        data.push_back(0);
+        auto offset = this->allocateLinkedit(data.size());
+        memcpy(this->file.data() + offset, data.data(), data.size());
+        auto *command = this->addCommand<linkedit_data_command>(LC_FUNCTION_STARTS, sizeof(linkedit_data_command));
+        command->dataoff = static_cast<UInt32>(offset);
+        command->datasize = static_cast<UInt32>(data.size());
+    }
+
+    // Writes the symbol table into __LINKEDIT, which has to be added first.
+    void addSymbols(std::initializer_list<Symbol> symbols) { this->addSymbols(std::vector<Symbol>(symbols)); }
+
+    void addSymbols(const std::vector<Symbol> &symbols) {
+        std::string strings(1, '\0');
+        std::vector<nlist_64> table;
+        for (auto &symbol : symbols) {
+            nlist_64 entry {};
+            entry.n_un.n_strx = static_cast<UInt32>(strings.size());
+            entry.n_type = symbol.type;
+            entry.n_sect = 1;
+            entry.n_value = this->getVMAddress(symbol.offset);
+            table.push_back(entry);
+            strings += symbol.name;
+            strings += '\0';
+        }
+        auto symbolOffset = this->allocateLinkedit(table.size() * sizeof(nlist_64));
+        memcpy(this->file.data() + symbolOffset, table.data(), table.size() * sizeof(nlist_64));
+        auto stringOffset = this->allocateLinkedit(strings.size());
+        memcpy(this->file.data() + stringOffset, strings.data(), strings.size());
+        auto *command = this->addCommand<symtab_command>(LC_SYMTAB, sizeof(symtab_command));
+        command->symoff = static_cast<UInt32>(symbolOffset);
+        command->nsyms = static_cast<UInt32>(table.size());
+        command->stroff = static_cast<UInt32>(stringOffset);
+        command->strsize = static_cast<UInt32>(strings.size());
+    }
+
+    private:
+    mach_header_64 *getHeader() { return reinterpret_cast<mach_header_64 *>(this->file.data() + this->headerOffset); }
+
+    template<typename T>
+    T *addCommand(UInt32 cmd, size_t size) {
+        auto *header = this->getHeader();
+        auto *command = reinterpret_cast<T *>(reinterpret_cast<UInt8 *>(header + 1) + header->sizeofcmds);
+        memset(command, 0, size);
+        command->cmd = cmd;
+        command->cmdsize = static_cast<UInt32>(size);
+        header->ncmds += 1;
+        header->sizeofcmds += static_cast<UInt32>(size);
+        return command;
+    }
+
+    size_t allocateLinkedit(size_t size) {
+        auto offset = (this->linkeditCursor + 7) & ~static_cast<size_t>(7);
+        this->linkeditCursor = offset + size;
+        return offset;
+    }
+
+    std::vector<UInt8> file;
+    size_t headerOffset;
+    UInt64 vmBase;
+    size_t linkeditCursor {0};
+    size_t linkeditStart {0}, linkeditEnd {0};
+    bool linkeditJettisoned {false};
+
+    static inline MachOFixture *mappedFixture {nullptr};
+};
@@ -0,0 +1,42 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "Test.hpp"
+#include <chrono>
+
+bool debugEnabled = getenv("NOOTRX_TEST_VERBOSE") != nullptr;
+
+static TestCase *firstCase {nullptr}, **lastCase {&firstCase};
+static size_t failures {0};
+
+TestCase::TestCase(const char *name, void (*run)()) : name {name}, run {run} {
+    *lastCase = this;
+    lastCase = &this->next;
+}
+
+void reportFailure(const char *file, int line, const char *condition) {
+    fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, condition);
+    failures += 1;
+}
+
+void measure(const char *label, size_t iterations, void (*body)(void *context), void *context) {
+    body(context);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) { body(context); }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    printf("    %-48s %12.2f us\n", label, elapsed.count() / static_cast<double>(iterations));
+}
+
+int main() {
+    size_t failed = 0;
+    for (auto *test = firstCase; test; test = test->next) {
+        auto before = failures;
+        printf("%s\n", test->name);
+        test->run();
+        if (failures != before) {
+            printf("%s FAILED\n", test->name);
+            failed += 1;
+        }
+    }
+    return failed ? 1 : 0;
+}
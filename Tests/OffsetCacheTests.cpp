@@ -0,0 +1,280 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "FileOffsetCacheStorage.hpp"
+#include "MachOFixture.hpp"
+#include "OffsetCache.hpp"
+#include "Test.hpp"
+#include <Headers/kern_patcher.hpp>
+#include <dirent.h>
+#include <unistd.h>
+
+static constexpr size_t ImageSize = 0x8000;
+
+static const UInt8 first[] = {0x12, 0x34, 0x56, 0x78, 0x9A};
+static const UInt8 second[] = {0x48, 0x8B, 0x00, 0x00, 0xE8};
+static const UInt8 secondMask[] = {0xFF, 0xFF, 0x00, 0x00, 0xFF};
+static const UInt8 third[] = {0xC7, 0x06, 0x11, 0x22};
+
+// A fresh directory for one test's records.
+class RecordDirectory {
+    public:
+    RecordDirectory() {
+        char path[] = "/tmp/nootrx-offsetcache-XXXXXX";
+        this->path = mkdtemp(path);
+    }
+
+    ~RecordDirectory() {
+        if (auto *dir = opendir(this->path.c_str())) {
+            while (auto *entry = readdir(dir)) {
+                if (entry->d_name[0] != '.') { unlink((this->path + "/" + entry->d_name).c_str()); }
+            }
+            closedir(dir);
+        }
+        rmdir(this->path.c_str());
+    }
+
+    // The only record in the directory.
+    std::string getRecord() const {
+        std::string ret;
+        if (auto *dir = opendir(this->path.c_str())) {
+            while (auto *entry = readdir(dir)) {
+                if (entry->d_name[0] != '.') { ret = this->path + "/" + entry->d_name; }
+            }
+            closedir(dir);
+        }
+        return ret;
+    }
+
+    size_t getRecordCount() const {
+        size_t ret = 0;
+        if (auto *dir = opendir(this->path.c_str())) {
+            while (auto *entry = readdir(dir)) {
+                if (entry->d_name[0] != '.') { ret += 1; }
+            }
+            closedir(dir);
+        }
+        return ret;
+    }
+
+    std::string path;
+};
+
+struct TestKext {
+    MachOFixture fixture;
+    KextImage image;
+
+    explicit TestKext(UInt8 uuidSeed) : fixture {ImageSize, 0, 0} {
+        fixture.addSegment("__TEXT", 0, ImageSize, {{"__TEXT", "__text", 0x1000, 0x6000}});
+        fixture.addUUID(uuidSeed);
+        auto *data = reinterpret_cast<UInt8 *>(fixture.getAddress());
+        memcpy(data + 0x3000, first, sizeof(first));
+        memcpy(data + 0x4000, second, sizeof(second));
+        memcpy(data + 0x5000, third, sizeof(third));
+        image.parse(fixture.getAddress(), ImageSize);
+    }
+
+    UInt8 *getData() { return reinterpret_cast<UInt8 *>(this->fixture.getAddress()); }
+};
+
+// What PatcherPlus does for one pattern: look it up, and record where a scan found it on a miss.
+static bool resolve(OffsetCache &cache, TestKext &kext, const UInt8 *pattern, const UInt8 *mask, size_t size,
+    size_t *offset) {
+    auto hash = OffsetCache::hashPattern(pattern, mask, size);
+    if (cache.lookup(kext.image, hash, pattern, mask, size, offset)) { return true; }
+    if (!KernelPatcher::findPattern(pattern, mask, size, kext.getData(), ImageSize, offset)) { return false; }
+    cache.record(kext.image, hash, *offset);
+    return false;
+}
+
+TEST(hashesOnlyTheMaskedBits) {
+    static const UInt8 other[] = {0x48, 0x8B, 0xAA, 0xBB, 0xE8};
+    CHECK(OffsetCache::hashPattern(second, secondMask, sizeof(second)) ==
+          OffsetCache::hashPattern(other, secondMask, sizeof(other)));
+    CHECK(OffsetCache::hashPattern(second, nullptr, sizeof(second)) !=
+          OffsetCache::hashPattern(other, nullptr, sizeof(other)));
+    CHECK(OffsetCache::hashPattern(second, secondMask, sizeof(second)) !=
+          OffsetCache::hashPattern(second, nullptr, sizeof(second)));
+}
+
+TEST(roundTripsThroughAFile) {
+    RecordDirectory directory {};
+    FileOffsetCacheStorage storage {directory.path.c_str()};
+    TestKext kext {0x10};
+
+    size_t offset = 0;
+    OffsetCache learning {};
+    learning.setStorage(&storage);
+    learning.setKext("Test");
+    CHECK(!resolve(learning, kext, first, nullptr, sizeof(first), &offset));
+    CHECK(!resolve(learning, kext, second, secondMask, sizeof(second), &offset));
+    learning.flush();
+    CHECK(storage.writes == 1);
+    REQUIRE(!directory.getRecord().empty());
+
+    // The next boot.
+    OffsetCache cache {};
+    cache.setStorage(&storage);
+    cache.setKext("Test");
+    CHECK(resolve(cache, kext, first, nullptr, sizeof(first), &offset) && offset == 0x3000);
+    CHECK(resolve(cache, kext, second, secondMask, sizeof(second), &offset) && offset == 0x4000);
+    cache.flush();
+    CHECK(storage.writes == 1);
+}
+
+TEST(rescansStaleOffsets) {
+    RecordDirectory directory {};
+    FileOffsetCacheStorage storage {directory.path.c_str()};
+    TestKext kext {0x20};
+
+    size_t offset = 0;
+    OffsetCache learning {};
+    learning.setStorage(&storage);
+    learning.setKext("Test");
+    resolve(learning, kext, first, nullptr, sizeof(first), &offset);
+    learning.flush();
+
+    kext.getData()[0x3000] = 0;
+    memcpy(kext.getData() + 0x3800, first, sizeof(first));
+    OffsetCache cache {};
+    cache.setStorage(&storage);
+    cache.setKext("Test");
+    CHECK(!resolve(cache, kext, first, nullptr, sizeof(first), &offset));
+    CHECK(offset == 0x3800);
+}
+
+TEST(discardsCorruptedRecords) {
+    RecordDirectory directory {};
+    FileOffsetCacheStorage storage {directory.path.c_str()};
+    TestKext kext {0x30};
+
+    size_t offset = 0;
+    OffsetCache learning {};
+    learning.setStorage(&storage);
+    learning.setKext("Test");
+    resolve(learning, kext, first, nullptr, sizeof(first), &offset);
+    learning.flush();
+
+    // Point the entry somewhere else, where the pattern still doesn't match, without fixing the hash.
+    auto path = directory.getRecord();
+    auto *file = fopen(path.c_str(), "r+b");
+    REQUIRE(file);
+    fseek(file, -1, SEEK_END);
+    fputc(0x7F, file);
+    fclose(file);
+
+    OffsetCache cache {};
+    cache.setStorage(&storage);
+    cache.setKext("Test");
+    size_t hash = OffsetCache::hashPattern(first, nullptr, sizeof(first));
+    CHECK(!cache.lookup(kext.image, hash, first, nullptr, sizeof(first), &offset));
+}
+
+TEST(rewritesOnceWhenThePatternSetChanges) {
+    RecordDirectory directory {};
+    FileOffsetCacheStorage storage {directory.path.c_str()};
+    TestKext kext {0x40};
+
+    size_t offset = 0;
+    OffsetCache learning {};
+    learning.setStorage(&storage);
+    learning.setKext("Test");
+    resolve(learning, kext, first, nullptr, sizeof(first), &offset);
+    resolve(learning, kext, second, secondMask, sizeof(second), &offset);
+    learning.flush();
+    CHECK(storage.writes == 1);
+
+    // A newer NootRX that no longer looks for `second`, nothing is new but the record gets rewritten without it.
+    OffsetCache updated {};
+    updated.setStorage(&storage);
+    updated.setKext("Test");
+    CHECK(resolve(updated, kext, first, nullptr, sizeof(first), &offset));
+    updated.flush();
+    CHECK(storage.writes == 2);
+
+    OffsetCache cache {};
+    cache.setStorage(&storage);
+    cache.setKext("Test");
+    CHECK(resolve(cache, kext, first, nullptr, sizeof(first), &offset));
+    CHECK(!resolve(cache, kext, second, secondMask, sizeof(second), &offset));
+    cache.flush();
+    CHECK(storage.writes == 3);
+}
+
+TEST(writesEachBuildAtMostOncePerBoot) {
+    RecordDirectory directory {};
+    FileOffsetCacheStorage storage {directory.path.c_str()};
+    TestKext kextA {0x50}, kextB {0x60};
+
+    size_t offset = 0;
+    OffsetCache cache {};
+    cache.setStorage(&storage);
+    cache.setKext("A");
+    resolve(cache, kextA, first, nullptr, sizeof(first), &offset);
+    // Switching kexts writes the previous record.
+    cache.setKext("B");
+    CHECK(storage.writes == 1);
+    resolve(cache, kextB, first, nullptr, sizeof(first), &offset);
+    cache.flush();
+    CHECK(storage.writes == 2);
+
+    // New offsets for a build that was already written wait for the next boot.
+    cache.setKext("A");
+    resolve(cache, kextA, third, nullptr, sizeof(third), &offset);
+    cache.flush();
+    CHECK(storage.writes == 2);
+    CHECK(cache.getWriteCount() == 2);
+}
+
+TEST(overwritesTheRecordOfAnUpdatedKext) {
+    RecordDirectory directory {};
+    FileOffsetCacheStorage storage {directory.path.c_str()};
+    TestKext oldKext {0x80}, newKext {0x81};
+
+    size_t offset = 0;
+    OffsetCache learning {};
+    learning.setStorage(&storage);
+    learning.setKext("Test");
+    resolve(learning, oldKext, first, nullptr, sizeof(first), &offset);
+    learning.flush();
+
+    // The boot after a macOS update.
+    OffsetCache updated {};
+    updated.setStorage(&storage);
+    updated.setKext("Test");
+    CHECK(!resolve(updated, newKext, first, nullptr, sizeof(first), &offset));
+    updated.flush();
+    CHECK(storage.writes == 2);
+    CHECK(directory.getRecordCount() == 1);
+
+    OffsetCache cache {};
+    cache.setStorage(&storage);
+    cache.setKext("Test");
+    CHECK(resolve(cache, newKext, first, nullptr, sizeof(first), &offset) && offset == 0x3000);
+    cache.flush();
+    CHECK(storage.writes == 2);
+}
+
+TEST(storesNothingForAnUnnamedKext) {
+    RecordDirectory directory {};
+    FileOffsetCacheStorage storage {directory.path.c_str()};
+    TestKext kext {0x90};
+
+    size_t offset = 0;
+    OffsetCache cache {};
+    cache.setStorage(&storage);
+    CHECK(!resolve(cache, kext, first, nullptr, sizeof(first), &offset));
+    cache.flush();
+    CHECK(storage.writes == 0);
+    CHECK(directory.getRecordCount() == 0);
+}
+
+TEST(learnsNothingWithoutStorage) {
+    TestKext kext {0x70};
+    size_t offset = 0;
+    OffsetCache cache {};
+    CHECK(!resolve(cache, kext, first, nullptr, sizeof(first), &offset));
+    CHECK(!resolve(cache, kext, first, nullptr, sizeof(first), &offset));
+    cache.flush();
+    CHECK(cache.getWriteCount() == 0);
+}
@@ -0,0 +1,71 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "MachOFixture.hpp"
+#include "PatcherPlus.hpp"
+#include "Test.hpp"
+
+static constexpr size_t ImageSize = 16 * 1024 * 1024;
+
+static const UInt8 pspSwInit1[] = {0x55, 0x48, 0x89, 0xE5, 0x41, 0x57, 0x41, 0x56, 0x53, 0x50, 0x49, 0x89, 0xFE,
+    0x8B, 0x87, 0x10, 0x01, 0x00, 0x00};
+static const UInt8 pspSwInit2[] = {0xC7, 0x87, 0x20, 0x01, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x48, 0x8B};
+static const UInt8 pspSwInit3[] = {0x41, 0xC7, 0x86, 0x30, 0x01, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0xEB};
+
+// A kext with 16 MiB of code-like bytes and three patches in one function near the end of __text, like the
+// psp_sw_init ones in HWLibs.
+static MachOFixture *makeKext() {
+    static const UInt8 common[] = {0x48, 0x89, 0x8B, 0x00, 0x41, 0xE8, 0x0F, 0xFF, 0x4C, 0x24, 0x83, 0x45};
+    auto *fixture = new MachOFixture {ImageSize, 0, 0x1000};
+    fixture->addSegment("__TEXT", 0, ImageSize, {{"__TEXT", "__text", 0x1000, ImageSize - 0x1000}});
+    auto *data = fixture->getFile();
+    TestRandom random {8};
+    for (size_t i = 0x1000; i < ImageSize; i++) {
+        data[i] = random.below(5) ? common[random.below(arrsize(common))] : static_cast<UInt8>(random.next());
+    }
+    auto function = ImageSize - 0x10000;
+    memcpy(data + function, pspSwInit1, sizeof(pspSwInit1));
+    memcpy(data + function + 0x180, pspSwInit2, sizeof(pspSwInit2));
+    memcpy(data + function + 0x2C0, pspSwInit3, sizeof(pspSwInit3));
+    return fixture;
+}
+
+static void report() {
+    auto &metrics = PatternSearchMetrics::getLast();
+    printf("        last request: %zu in section, %zu chained, %zu moved earlier, searched 0x%zX bytes, saved 0x%zX\n",
+        metrics.sections, metrics.chained, metrics.earlier, metrics.bytesSearched, metrics.bytesSaved);
+}
+
+BENCH(lookupPatchesInOneFunction) {
+    auto *fixture = makeKext();
+    auto address = fixture->getAddress();
+    const LookupPatchPlus patches[] = {
+        {nullptr, pspSwInit1, pspSwInit1, 1},
+        {nullptr, pspSwInit2, pspSwInit2, 1},
+        {nullptr, pspSwInit3, pspSwInit3, 1},
+    };
+
+    printf("    %zu MiB image, three patches 0x10000 bytes before its end\n", ImageSize >> 20);
+    measure("stage per patch", 10, [&] {
+        PatchSession session {};
+        for (auto &patch : patches) { keep(patch.stage(session, address, ImageSize)); }
+    });
+    report();
+    measure("stageAll", 10, [&] {
+        PatchSession session {};
+        keep(LookupPatchPlus::stageAll(session, patches, address, ImageSize));
+    });
+    report();
+
+    const LookupPatchPlus chained[] = {
+        patches[0],
+        LookupPatchPlus {patches[1]}.near(0, 0x1000),
+        LookupPatchPlus {patches[2]}.near(1, 0x1000),
+    };
+    measure("stageAll chained", 10, [&] {
+        PatchSession session {};
+        keep(LookupPatchPlus::stageAll(session, chained, address, ImageSize));
+    });
+    report();
+    delete fixture;
+}
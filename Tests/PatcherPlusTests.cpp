@@ -0,0 +1,455 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "MachOFixture.hpp"
+#include "PatcherPlus.hpp"
+#include "Test.hpp"
+
+static constexpr UInt64 CollectionBase = 0xFFFFFF8000100000;
+static constexpr size_t KextSize = 0x8000;
+
+// `KextImage::get` keeps the last image by address, which a new fixture may well reuse.
+static void forgetImage() { KextImage::get(0, 0); }
+
+static void routeTarget() {}
+
+struct RouteLog {
+    mach_vm_address_t routed[8];
+    size_t count;
+};
+
+static mach_vm_address_t logRoute(void *context, mach_vm_address_t from, mach_vm_address_t) {
+    auto &log = *static_cast<RouteLog *>(context);
+    if (log.count < arrsize(log.routed)) { log.routed[log.count] = from; }
+    log.count += 1;
+    return from;
+}
+
+// A kext in a boot kernel collection, see KextImageTests.cpp, with code in __TEXT_EXEC at 0x2000.
+static void buildCollectionKext(MachOFixture &fixture) {
+    fixture.map();
+    KextImage::setMappedCheck(MachOFixture::isMapped);
+    fixture.addSegment("__TEXT", 0, 0x2000,
+        {{"__TEXT", "__const", 0x1000, 0x400}, {"__TEXT", "__cstring", 0x1400, 0x200}});
+    fixture.addSegment("__TEXT_EXEC", 0x2000, 0x3000, {{"__TEXT_EXEC", "__text", 0x2000, 0x3000}});
+    fixture.addSegment("__DATA", 0x5000, 0x1000);
+    fixture.addSegment("__DATA_CONST", 0x6000, 0x2000);
+    fixture.addSegment("__LINKEDIT", 0x20000, 0x1000);
+    fixture.addUUID(0x60);
+    fixture.addFunctionStarts({0x2000, 0x2800, 0x3400});
+}
+
+static const UInt8 tablePattern[] = {0x12, 0x34, 0x56, 0x78, 0x9A};
+static const UInt8 stringPattern[] = {'g', 'f', 'x', '1', '0', '3', '0'};
+
+TEST(solvesThroughSectionHintsInCollectionKext) {
+    forgetImage();
+    MachOFixture fixture {0x40000, 0x10000, CollectionBase};
+    buildCollectionKext(fixture);
+    auto *kext = reinterpret_cast<UInt8 *>(fixture.getAddress());
+    // The same bytes show up in code first, the hinted sections must still win.
+    memcpy(kext + 0x2200, tablePattern, sizeof(tablePattern));
+    memcpy(kext + 0x6100, tablePattern, sizeof(tablePattern));
+    memcpy(kext + 0x2300, stringPattern, sizeof(stringPattern));
+    memcpy(kext + 0x1480, stringPattern, sizeof(stringPattern));
+
+    mach_vm_address_t table = 0, anywhere = 0, string = 0;
+    SolveRequestPlus requests[] = {
+        {"_table", table, tablePattern, PatternSection::Data},
+        {"_anywhere", anywhere, tablePattern},
+        {"_string", string, stringPattern, PatternSection::CString},
+    };
+    KernelPatcher patcher {};
+    REQUIRE(SolveRequestPlus::solveAll(patcher, 0, requests, fixture.getAddress(), KextSize));
+    CHECK(table == fixture.getAddress() + 0x6100);
+    CHECK(anywhere == fixture.getAddress() + 0x2200);
+    CHECK(string == fixture.getAddress() + 0x1480);
+
+    // A pattern that isn't in its section is still found elsewhere.
+    mach_vm_address_t misplaced = 0;
+    SolveRequestPlus request {"_misplaced", misplaced, stringPattern, PatternSection::Data};
+    CHECK(request.solve(patcher, 0, fixture.getAddress(), KextSize));
+    CHECK(misplaced == fixture.getAddress() + 0x1480);
+}
+
+TEST(routesProloguesAtFunctionStartsInCollectionKext) {
+    forgetImage();
+    MachOFixture fixture {0x40000, 0x10000, CollectionBase};
+    buildCollectionKext(fixture);
+    auto *kext = reinterpret_cast<UInt8 *>(fixture.getAddress());
+    static const UInt8 prologue[] = {0x55, 0x48, 0x89, 0xE5, 0x41, 0x57};
+    // Inside a function first, then at the start of one.
+    memcpy(kext + 0x2400, prologue, sizeof(prologue));
+    memcpy(kext + 0x3400, prologue, sizeof(prologue));
+
+    RouteLog log {};
+    KernelPatcher patcher {};
+    patcher.routeHook = logRoute;
+    patcher.routeContext = &log;
+
+    RouteRequestPlus probed {"_probed", routeTarget, prologue};
+    REQUIRE(probed.route(patcher, 0, fixture.getAddress(), KextSize));
+    CHECK(log.count == 1 && log.routed[0] == fixture.getAddress() + 0x3400);
+
+    RouteRequestPlus scanned {"_scanned", routeTarget, prologue};
+    scanned.probeFunctionStarts = false;
+    REQUIRE(scanned.route(patcher, 0, fixture.getAddress(), KextSize));
+    CHECK(log.count == 2 && log.routed[1] == fixture.getAddress() + 0x2400);
+}
+
+struct SolveLog {
+    const char *asked[4];
+    size_t count;
+};
+
+static mach_vm_address_t logSolve(void *context, const char *symbol) {
+    auto *log = static_cast<SolveLog *>(context);
+    if (log->count < arrsize(log->asked)) { log->asked[log->count] = symbol; }
+    log->count += 1;
+    return 0xFFFFFF8000001000;
+}
+
+// Symbols come from the collection's __LINKEDIT while it is mapped, and from Lilu once it's gone.
+TEST(solvesThroughLiluOnceLinkeditIsJettisoned) {
+    forgetImage();
+    MachOFixture fixture {0x40000, 0x10000, CollectionBase};
+    buildCollectionKext(fixture);
+    fixture.addSymbols({{"_gc_10_3_init", 0x2800}});
+
+    SolveLog log {};
+    KernelPatcher patcher {};
+    patcher.solveHook = logSolve;
+    patcher.solveContext = &log;
+    mach_vm_address_t address = 0;
+    SolveRequestPlus request {"_gc_10_3_init", address};
+    REQUIRE(request.solve(patcher, 0, fixture.getAddress(), KextSize));
+    CHECK(address == fixture.getAddress() + 0x2800 && log.count == 0);
+
+    fixture.jettisonLinkedit();
+    REQUIRE(request.solve(patcher, 0, fixture.getAddress(), KextSize));
+    CHECK(address == 0xFFFFFF8000001000 && log.count == 1 && !strcmp(log.asked[0], "_gc_10_3_init"));
+    forgetImage();
+    SolveRequestPlus requests[] = {{"_gc_10_3_init", address}};
+    REQUIRE(SolveRequestPlus::solveAll(patcher, 0, requests, fixture.getAddress(), KextSize));
+    CHECK(address == 0xFFFFFF8000001000 && log.count == 2);
+}
+
+TEST(fallsBackToFullScansForUnparsableImages) {
+    forgetImage();
+    UInt8 image[0x1000];
+    memset(image, 0x90, sizeof(image));
+    memcpy(image + 0x800, tablePattern, sizeof(tablePattern));
+
+    mach_vm_address_t table = 0;
+    SolveRequestPlus request {"_table", table, tablePattern, PatternSection::Data};
+    KernelPatcher patcher {};
+    CHECK(request.solve(patcher, 0, reinterpret_cast<mach_vm_address_t>(image), sizeof(image)));
+    CHECK(table == reinterpret_cast<mach_vm_address_t>(image) + 0x800);
+}
+
+static const UInt8 firstPattern[] = {0xC7, 0x45, 0xA0, 0x01, 0x00, 0x00, 0x00};
+static const UInt8 secondPattern[] = {0x48, 0x8B, 0x7D, 0xB8, 0xE8};
+static const UInt8 secondPatched[] = {0x48, 0x8B, 0x7D, 0xB8, 0x90};
+
+// A standalone kext with code at 0x1000 and data at 0x6000.
+static void buildKext(MachOFixture &fixture) {
+    fixture.addSegment("__TEXT", 0, 0x6000, {{"__TEXT", "__text", 0x1000, 0x5000}});
+    fixture.addSegment("__DATA", 0x6000, 0x2000, {{"__DATA", "__data", 0x6000, 0x2000}});
+    fixture.addUUID(0x70);
+}
+
+static kern_return_t allowWriting(bool) { return KERN_SUCCESS; }
+
+TEST(patchesTheFirstMatchInTheImageForSectionHits) {
+    forgetImage();
+    MachOFixture fixture {KextSize, 0, 0x1000};
+    buildKext(fixture);
+    auto *kext = reinterpret_cast<UInt8 *>(fixture.getAddress());
+    // Three matches, skipping one has to skip the one in code even though the patch hints at data.
+    memcpy(kext + 0x3000, secondPattern, sizeof(secondPattern));
+    memcpy(kext + 0x6100, secondPattern, sizeof(secondPattern));
+    memcpy(kext + 0x6200, secondPattern, sizeof(secondPattern));
+
+    const LookupPatchPlus patch {nullptr, secondPattern, nullptr, secondPatched, 5, 1, 1, PatternSection::Data};
+    KernelPatcher patcher {};
+    PatchSession session {allowWriting};
+    REQUIRE(patch.stage(session, fixture.getAddress(), KextSize));
+    REQUIRE(session.commit(patcher));
+    CHECK(kext[0x3004] == 0xE8);
+    CHECK(kext[0x6104] == 0x90);
+    CHECK(kext[0x6204] == 0xE8);
+
+    auto &metrics = PatternSearchMetrics::getLast();
+    CHECK(metrics.patterns == 1 && metrics.sections == 1 && metrics.earlier == 1);
+}
+
+TEST(patchesTheFirstMatchInTheImageForBatches) {
+    forgetImage();
+    MachOFixture fixture {KextSize, 0, 0x1000};
+    buildKext(fixture);
+    auto *kext = reinterpret_cast<UInt8 *>(fixture.getAddress());
+    // Before __text, where the section scan doesn't look.
+    memcpy(kext + 0xF00, secondPattern, sizeof(secondPattern));
+    memcpy(kext + 0x2000, secondPattern, sizeof(secondPattern));
+    memcpy(kext + 0x4000, firstPattern, sizeof(firstPattern));
+
+    const LookupPatchPlus patches[] = {
+        {nullptr, firstPattern, firstPattern, 1},
+        {nullptr, secondPattern, secondPatched, 1},
+    };
+    KernelPatcher patcher {};
+    PatchSession session {allowWriting};
+    REQUIRE(LookupPatchPlus::stageAll(session, patches, fixture.getAddress(), KextSize));
+    REQUIRE(session.commit(patcher));
+    CHECK(kext[0xF04] == 0x90);
+    CHECK(kext[0x2004] == 0xE8);
+
+    auto &metrics = PatternSearchMetrics::getLast();
+    CHECK(metrics.patterns == 2 && metrics.sections == 2 && metrics.earlier == 1 && metrics.missing == 0);
+}
+
+TEST(searchesOnlyUpToTheLastHit) {
+    forgetImage();
+    MachOFixture fixture {KextSize, 0, 0x1000};
+    buildKext(fixture);
+    auto *kext = reinterpret_cast<UInt8 *>(fixture.getAddress());
+    memcpy(kext + 0x1100, firstPattern, sizeof(firstPattern));
+    memcpy(kext + 0x1140, secondPattern, sizeof(secondPattern));
+
+    const LookupPatchPlus patches[] = {
+        {nullptr, firstPattern, firstPattern, 1},
+        {nullptr, secondPattern, secondPatched, 1},
+    };
+    PatchSession session {allowWriting};
+    REQUIRE(LookupPatchPlus::stageAll(session, patches, fixture.getAddress(), KextSize));
+
+    // One walk of __text up to the second hit, then one of what comes before __text.
+    auto &metrics = PatternSearchMetrics::getLast();
+    CHECK(metrics.sections == 2 && metrics.earlier == 0);
+    CHECK(metrics.bytesSearched == 0x145 + 0x1006);
+}
+
+TEST(patchesChainedPatchesRightAfterTheirPredecessor) {
+    forgetImage();
+    MachOFixture fixture {KextSize, 0, 0x1000};
+    buildKext(fixture);
+    auto *kext = reinterpret_cast<UInt8 *>(fixture.getAddress());
+    memcpy(kext + 0x2000, secondPattern, sizeof(secondPattern));
+    memcpy(kext + 0x4000, firstPattern, sizeof(firstPattern));
+    memcpy(kext + 0x4100, secondPattern, sizeof(secondPattern));
+
+    const LookupPatchPlus patches[] = {
+        {nullptr, firstPattern, firstPattern, 1},
+        LookupPatchPlus {nullptr, secondPattern, secondPatched, 1}.near(0, 0x1000),
+    };
+    KernelPatcher patcher {};
+    PatchSession session {allowWriting};
+    REQUIRE(LookupPatchPlus::stageAll(session, patches, fixture.getAddress(), KextSize));
+    REQUIRE(session.commit(patcher));
+    CHECK(kext[0x2004] == 0xE8);
+    CHECK(kext[0x4104] == 0x90);
+
+    // __text up to the second hit would have been 0x3105 bytes, the window up to it was 0x105.
+    auto &metrics = PatternSearchMetrics::getLast();
+    CHECK(metrics.chained == 1 && metrics.earlier == 0 && metrics.missing == 0);
+    CHECK(metrics.bytesSaved == 0x3000);
+}
+
+TEST(chainsFallBackToTheFirstMatchInTheImage) {
+    forgetImage();
+    MachOFixture fixture {KextSize, 0, 0x1000};
+    buildKext(fixture);
+    auto *kext = reinterpret_cast<UInt8 *>(fixture.getAddress());
+    memcpy(kext + 0x2000, secondPattern, sizeof(secondPattern));
+    memcpy(kext + 0x4000, firstPattern, sizeof(firstPattern));
+    memcpy(kext + 0x5800, secondPattern, sizeof(secondPattern));
+
+    const LookupPatchPlus patches[] = {
+        {nullptr, firstPattern, firstPattern, 1},
+        LookupPatchPlus {nullptr, secondPattern, secondPatched, 1}.near(0, 0x1000),
+    };
+    KernelPatcher patcher {};
+    PatchSession session {allowWriting};
+    REQUIRE(LookupPatchPlus::stageAll(session, patches, fixture.getAddress(), KextSize));
+    REQUIRE(session.commit(patcher));
+    CHECK(kext[0x2004] == 0x90);
+    CHECK(kext[0x5804] == 0xE8);
+    CHECK(PatternSearchMetrics::getLast().chained == 0);
+}
+
+TEST(neverChainsPatchesWithASkipCount) {
+    forgetImage();
+    MachOFixture fixture {KextSize, 0, 0x1000};
+    buildKext(fixture);
+    auto *kext = reinterpret_cast<UInt8 *>(fixture.getAddress());
+    memcpy(kext + 0x2000, secondPattern, sizeof(secondPattern));
+    memcpy(kext + 0x4000, firstPattern, sizeof(firstPattern));
+    memcpy(kext + 0x4100, secondPattern, sizeof(secondPattern));
+    memcpy(kext + 0x4200, secondPattern, sizeof(secondPattern));
+
+    // The skip count is relative to the first match in the image, so the patch lands on the second one.
+    const LookupPatchPlus patches[] = {
+        {nullptr, firstPattern, firstPattern, 1},
+        LookupPatchPlus {nullptr, secondPattern, nullptr, secondPatched, 5, 1, 1}.near(0, 0x1000),
+    };
+    KernelPatcher patcher {};
+    PatchSession session {allowWriting};
+    REQUIRE(LookupPatchPlus::stageAll(session, patches, fixture.getAddress(), KextSize));
+    REQUIRE(session.commit(patcher));
+    CHECK(kext[0x2004] == 0xE8);
+    CHECK(kext[0x4104] == 0x90);
+    CHECK(kext[0x4204] == 0xE8);
+    CHECK(PatternSearchMetrics::getLast().chained == 0);
+}
+
+static constexpr auto kMemcpyCall = BYTE_PATTERN("48 8D 35 ?? ?? ?? ?? BA ?? ?? ?? ?? 4C 89 ?? E8 ?? ?? ?? ??");
+static constexpr auto kMemcpyCallPatched = BYTE_PATTERN("48 BE 00 00 00 00 00 00 00 00 90 66 ?? ?? ?? FF D6 90 66 90");
+static constexpr auto kMemcpyCall2 = BYTE_PATTERN("48 8D 35 ?? ?? ?? ?? BA ?? ?? ?? ?? E8 ?? ?? ?? ?? 4?");
+static constexpr auto kMemcpyCallPatched2 = BYTE_PATTERN("48 BE 00 00 00 00 00 00 00 00 FF D6 90 66 90 90 66 ??");
+
+static void fakecpy1(void *) {}
+static void fakecpy2(void *) {}
+static void fakecpy3(void *) {}
+
+// `lea rsi, [rel blob]; mov edx, size; mov rdi, r12; call _memcpy` and the same without the `mov`.
+static const UInt8 memcpyCall[] = {0x48, 0x8D, 0x35, 0x01, 0x02, 0x03, 0x04, 0xBA, 0x10, 0x13, 0x00, 0x00, 0x4C, 0x89,
+    0xE7, 0xE8, 0x09, 0x09, 0x09, 0x09};
+static const UInt8 memcpyCall2[] = {0x48, 0x8D, 0x35, 0x01, 0x02, 0x03, 0x04, 0xBA, 0x70, 0x07, 0x01, 0x00, 0xE8, 0x09,
+    0x09, 0x09, 0x09, 0x48};
+
+// What `movabs rsi, handler; call rsi` with the shape's padding looks like.
+static void expectRedirect(UInt8 *site, const UInt8 *original, const CallSiteShape &shape, void (*handler)(void *)) {
+    UInt8 expected[CallSiteRedirect::MaxShapeSize];
+    for (size_t i = 0; i < shape.size; i++) {
+        expected[i] = (original[i] & ~shape.replaceMask[i]) | (shape.replace[i] & shape.replaceMask[i]);
+    }
+    auto address = reinterpret_cast<UInt64>(handler);
+    memcpy(expected + 2, &address, sizeof(address));
+    CHECK(!memcmp(site, expected, shape.size));
+}
+
+TEST(redirectsEveryCallSiteInOnePass) {
+    forgetImage();
+    static UInt8 image[0x100000];
+    memset(image, 0xCC, sizeof(image));
+    memcpy(image + 0x1000, memcpyCall, sizeof(memcpyCall));
+    memcpy(image + 0x80000, memcpyCall2, sizeof(memcpyCall2));
+    memcpy(image + 0x90000, memcpyCall, sizeof(memcpyCall));
+    image[0x90008] = 0xA0;
+    image[0x90009] = 0x03;
+    // The second shape needs a REX prefix after the call.
+    memcpy(image + 0x10000, memcpyCall2, sizeof(memcpyCall2));
+    image[0x10011] = 0x90;
+
+    const CallSiteShape shapes[] = {
+        {kMemcpyCall, kMemcpyCallPatched, 8, 2},
+        {kMemcpyCall2, kMemcpyCallPatched2, 8, 2},
+    };
+    // The second size only has to match outside of bits 12-17.
+    const CallSiteRedirect redirects[] = {
+        {0x00001310, 0xFFFFFFFF, fakecpy1},
+        {0x00010770, 0xFFFC0FFF, fakecpy2},
+        {0x000003A0, 0xFFFFFFFF, fakecpy3},
+    };
+    UInt8 original[3][sizeof(memcpyCall)];
+    memcpy(original[0], image + 0x1000, sizeof(memcpyCall));
+    memcpy(original[1], image + 0x80000, sizeof(memcpyCall2));
+    memcpy(original[2], image + 0x90000, sizeof(memcpyCall));
+    UInt8 untouched[sizeof(memcpyCall2)];
+    memcpy(untouched, image + 0x10000, sizeof(untouched));
+
+    KernelPatcher patcher {};
+    MachInfo::writingEnables = 0;
+    REQUIRE(CallSiteRedirect::applyAll(patcher, shapes, redirects, reinterpret_cast<mach_vm_address_t>(image),
+        sizeof(image)));
+    expectRedirect(image + 0x1000, original[0], shapes[0], fakecpy1);
+    expectRedirect(image + 0x80000, original[1], shapes[1], fakecpy2);
+    expectRedirect(image + 0x90000, original[2], shapes[0], fakecpy3);
+    CHECK(!memcmp(image + 0x10000, untouched, sizeof(untouched)));
+    CHECK(MachInfo::writingEnables == 1);
+    CHECK(PatternSearchMetrics::getLast().patterns == 6);
+}
+
+TEST(redirectsNothingUnlessEveryCallSiteIsFound) {
+    forgetImage();
+    static UInt8 image[0x10000];
+    memset(image, 0xCC, sizeof(image));
+    memcpy(image + 0x1000, memcpyCall, sizeof(memcpyCall));
+    UInt8 before[sizeof(image)];
+    memcpy(before, image, sizeof(image));
+
+    const CallSiteShape shapes[] = {{kMemcpyCall, kMemcpyCallPatched, 8, 2}};
+    const CallSiteRedirect redirects[] = {
+        {0x00001310, 0xFFFFFFFF, fakecpy1},
+        {0x00001234, 0xFFFFFFFF, fakecpy2},
+    };
+    KernelPatcher patcher {};
+    CHECK(!CallSiteRedirect::applyAll(patcher, shapes, redirects, reinterpret_cast<mach_vm_address_t>(image),
+        sizeof(image)));
+    CHECK(!memcmp(image, before, sizeof(image)));
+}
+
+struct FailingRoutes {
+    size_t calls, failAt;
+};
+
+static mach_vm_address_t failRoute(void *context, mach_vm_address_t from, mach_vm_address_t) {
+    auto &routes = *static_cast<FailingRoutes *>(context);
+    return routes.calls++ == routes.failAt ? 0 : from;
+}
+
+TEST(rollsBackEditsWhenTheFirstRouteFails) {
+    UInt8 code[0x40];
+    memset(code, 0xCC, sizeof(code));
+    FailingRoutes routes {0, 0};
+    KernelPatcher patcher {};
+    patcher.routeHook = failRoute;
+    patcher.routeContext = &routes;
+
+    mach_vm_address_t org = 0;
+    PatchSession session {allowWriting};
+    REQUIRE(session.fill(code, 0x90, 0x10));
+    REQUIRE(session.route(reinterpret_cast<mach_vm_address_t>(code + 0x20), 1, &org));
+    REQUIRE(session.route(reinterpret_cast<mach_vm_address_t>(code + 0x30), 2, nullptr));
+    CHECK(!session.commit(patcher));
+    CHECK(code[0] == 0xCC && code[0xF] == 0xCC);
+    CHECK(routes.calls == 1);
+    CHECK(patcher.getError() == KernelPatcher::Error::NoError);
+}
+
+TEST(panicsWhenALaterRouteFails) {
+    UInt8 code[0x40];
+    memset(code, 0xCC, sizeof(code));
+    KernelPatcher patcher {};
+    patcher.routeHook = failRoute;
+
+    auto commit = [&](size_t failAt) {
+        FailingRoutes routes {0, failAt};
+        patcher.routeContext = &routes;
+        PatchSession session {allowWriting};
+        session.fill(code, 0x90, 0x10);
+        session.route(reinterpret_cast<mach_vm_address_t>(code + 0x20), 1, nullptr);
+        session.route(reinterpret_cast<mach_vm_address_t>(code + 0x30), 2, nullptr);
+        return session.commit(patcher);
+    };
+    CHECK(panics([&] { commit(1); }));
+    CHECK(!panics([&] { commit(2); }));
+    CHECK(commit(2));
+    CHECK(code[0] == 0x90);
+}
+
+TEST(panicsWhenStagingPastTheLimits) {
+    static UInt8 code[PatchSession::MaxEdits + 1];
+    auto stageEdits = [](size_t count) {
+        PatchSession session {allowWriting};
+        for (size_t i = 0; i < count; i++) { session.fill(code + i, 0x90, 1); }
+    };
+    auto stageRoutes = [](size_t count) {
+        PatchSession session {allowWriting};
+        for (size_t i = 0; i < count; i++) { session.route(reinterpret_cast<mach_vm_address_t>(code + i), 1, nullptr); }
+    };
+    CHECK(!panics([&] { stageEdits(PatchSession::MaxEdits); }));
+    CHECK(panics([&] { stageEdits(PatchSession::MaxEdits + 1); }));
+    CHECK(!panics([&] { stageRoutes(PatchSession::MaxRoutes); }));
+    CHECK(panics([&] { stageRoutes(PatchSession::MaxRoutes + 1); }));
+}
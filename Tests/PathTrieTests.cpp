@@ -0,0 +1,98 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "PathTrie.hpp"
+#include "Test.hpp"
+#include <string>
+
+static constexpr PathTrieEntry<int> kTestPaths[] = {
+    {"/System/Library/dyld/dyld_shared_cache_x86_64", 1, true},
+    {"/System/Library/Frameworks/Metal.framework/Metal", 2, false},
+    {"/System/Library/Frameworks/MetalKit.framework/MetalKit", 3, false},
+    {"/usr/lib/", 4, true},
+    {"/usr/lib/libSystem.B.dylib", 5, false},
+};
+
+// Only fits if the capacity covers every byte of every path, none of these share a prefix past the first byte.
+static constexpr PathTrieEntry<int> kDisjointPaths[] = {
+    {"/a", 1, false},
+    {"bb", 2, false},
+    {"ccc", 3, true},
+};
+static_assert(getPathTrieCapacity(kDisjointPaths) == 8);
+
+static constexpr PathTrie<int, getPathTrieCapacity(kTestPaths)> kTestTrie {kTestPaths};
+static constexpr PathTrie<int, getPathTrieCapacity(kDisjointPaths)> kDisjointTrie {kDisjointPaths};
+
+TEST(matchesExactPathsOnly) {
+    CHECK(kTestTrie.lookup("/System/Library/Frameworks/Metal.framework/Metal", 0) == 2);
+    CHECK(kTestTrie.lookup("/System/Library/Frameworks/MetalKit.framework/MetalKit", 0) == 3);
+    CHECK(kTestTrie.lookup("/System/Library/Frameworks/Metal.framework/Meta", 0) == 0);
+    CHECK(kTestTrie.lookup("/System/Library/Frameworks/Metal.framework/MetalX", 0) == 0);
+    CHECK(kTestTrie.lookup("/System/Library/Frameworks/Metal.framework/Metal/", 0) == 0);
+    CHECK(kTestTrie.lookup("/System/Library/Frameworks/", 0) == 0);
+    CHECK(kTestTrie.lookup("", 0) == 0);
+}
+
+TEST(matchesEverythingPastAPrefix) {
+    CHECK(kTestTrie.lookup("/System/Library/dyld/dyld_shared_cache_x86_64", 0) == 1);
+    CHECK(kTestTrie.lookup("/System/Library/dyld/dyld_shared_cache_x86_64h", 0) == 1);
+    CHECK(kTestTrie.lookup("/System/Library/dyld/dyld_shared_cache_x86_64.01", 0) == 1);
+    CHECK(kTestTrie.lookup("/System/Library/dyld/dyld_shared_cache_x86_6", 0) == 0);
+    CHECK(kTestTrie.lookup("/System/Library/dyld/dyld_shared_cache_arm64e", 0) == 0);
+}
+
+// The walk ends at the first path that matches, so a prefix hides the longer paths under it.
+TEST(returnsTheShortestMatch) {
+    CHECK(kTestTrie.lookup("/usr/lib/libSystem.B.dylib", 0) == 4);
+    CHECK(kTestTrie.lookup("/usr/lib/libc++.1.dylib", 0) == 4);
+    CHECK(kTestTrie.lookup("/usr/lib", 0) == 0);
+}
+
+TEST(returnsTheFallback) {
+    CHECK(kTestTrie.lookup("/Applications/Safari.app/Contents/MacOS/Safari", -1) == -1);
+    CHECK(kDisjointTrie.lookup("/a", 0) == 1);
+    CHECK(kDisjointTrie.lookup("bb", 0) == 2);
+    CHECK(kDisjointTrie.lookup("cccc", 0) == 3);
+    CHECK(kDisjointTrie.lookup("b", 7) == 7);
+    CHECK(kDisjointTrie.lookup("d", 7) == 7);
+}
+
+// Every path of up to 6 bytes over a 3 byte alphabet against random sets, compared with strncmp over the entries.
+TEST(matchesAStrncmpReference) {
+    static constexpr size_t EntryCount = 6;
+    static constexpr char alphabet[] = "ab/";
+    static constexpr size_t Alphabet = arrsize(alphabet) - 1;
+    TestRandom random {24};
+    for (size_t iteration = 0; iteration < 500; iteration++) {
+        std::string paths[EntryCount];
+        PathTrieEntry<int> entries[EntryCount] {};
+        for (size_t i = 0; i < EntryCount; i++) {
+            auto length = random.below(5) + 1;
+            for (size_t j = 0; j < length; j++) { paths[i] += alphabet[random.below(Alphabet)]; }
+            entries[i] = {paths[i].c_str(), static_cast<int>(i + 1), random.below(2) != 0};
+        }
+        PathTrie<int, 64> trie {entries};
+
+        for (size_t length = 0; length <= 6; length++) {
+            size_t combinations = 1;
+            for (size_t i = 0; i < length; i++) { combinations *= Alphabet; }
+            for (size_t combination = 0; combination < combinations; combination++) {
+                std::string path {};
+                for (size_t i = 0, rest = combination; i < length; i++, rest /= Alphabet) {
+                    path += alphabet[rest % Alphabet];
+                }
+                int expected = 0;
+                for (size_t n = 1; n <= length && !expected; n++) {
+                    // A path listed twice keeps its last entry.
+                    const PathTrieEntry<int> *match = nullptr;
+                    for (const auto &entry : entries) {
+                        if (strlen(entry.path) == n && !strncmp(entry.path, path.c_str(), n)) { match = &entry; }
+                    }
+                    if (match && (match->prefix || n == length)) { expected = match->value; }
+                }
+                CHECK(trie.lookup(path.c_str(), 0) == expected);
+            }
+        }
+    }
+}
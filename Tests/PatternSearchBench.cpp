@@ -0,0 +1,69 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "PatternSearch.hpp"
+#include "Test.hpp"
+#include <Headers/kern_patcher.hpp>
+
+static constexpr size_t ImageSize = 8 * 1024 * 1024;
+
+// Bytes in roughly the proportions they have in x86-64 code, so that anchors get the hit rates they would in a kext.
+static UInt8 *makeImage() {
+    static const UInt8 common[] = {0x48, 0x89, 0x8B, 0x00, 0x41, 0xE8, 0x0F, 0xFF, 0x4C, 0x24, 0x83, 0x45};
+    auto *image = static_cast<UInt8 *>(malloc(ImageSize));
+    TestRandom random {7};
+    for (size_t i = 0; i < ImageSize; i++) {
+        image[i] = random.below(5) ? common[random.below(arrsize(common))] : static_cast<UInt8>(random.next());
+    }
+    return image;
+}
+
+// Sixteen function prologues of the kind PatcherPlus looks for, all near the end so that every search is a full scan.
+struct BenchPatterns {
+    UInt8 patterns[MultiPatternScanner::MaxPatterns][24];
+    UInt8 masks[MultiPatternScanner::MaxPatterns][24];
+};
+
+static void makePatterns(UInt8 *image, BenchPatterns &bench) {
+    static const UInt8 prologue[] = {0x55, 0x48, 0x89, 0xE5, 0x41, 0x57, 0x41, 0x56, 0x41, 0x55, 0x41, 0x54, 0x53,
+        0x50, 0x49, 0x89, 0xFE, 0xE8, 0x00, 0x00, 0x00, 0x00, 0x48, 0x8B};
+    for (size_t i = 0; i < MultiPatternScanner::MaxPatterns; i++) {
+        memcpy(bench.patterns[i], prologue, sizeof(prologue));
+        bench.patterns[i][16] = static_cast<UInt8>(0xC0 + i);
+        memset(bench.masks[i], 0xFF, sizeof(bench.masks[i]));
+        memset(bench.masks[i] + 18, 0x00, 4);
+        memcpy(image + ImageSize - 0x1000 + i * 0x80, bench.patterns[i], sizeof(prologue));
+    }
+}
+
+BENCH(multiPatternScanAgainstPerPatternSearch) {
+    auto *image = makeImage();
+    static BenchPatterns bench;
+    makePatterns(image, bench);
+
+    printf("    %zu MiB image, %zu patterns\n", ImageSize >> 20, MultiPatternScanner::MaxPatterns);
+    measure("KernelPatcher::findPattern per pattern", 3, [&] {
+        for (size_t i = 0; i < MultiPatternScanner::MaxPatterns; i++) {
+            size_t offset = 0;
+            KernelPatcher::findPattern(bench.patterns[i], bench.masks[i], sizeof(bench.patterns[i]), image,
+                ImageSize, &offset);
+            keep(offset);
+        }
+    });
+    measure("MaskedPatternSearch per pattern", 3, [&] {
+        for (size_t i = 0; i < MultiPatternScanner::MaxPatterns; i++) {
+            MaskedPatternSearch search {bench.patterns[i], bench.masks[i], sizeof(bench.patterns[i])};
+            size_t offset = 0;
+            search.find(image, ImageSize, &offset);
+            keep(offset);
+        }
+    });
+    measure("MultiPatternScanner, one walk", 3, [&] {
+        MultiPatternScanner scanner {};
+        for (size_t i = 0; i < MultiPatternScanner::MaxPatterns; i++) {
+            scanner.add(bench.patterns[i], bench.masks[i], sizeof(bench.patterns[i]));
+        }
+        keep(scanner.scan(image, ImageSize));
+    });
+    free(image);
+}
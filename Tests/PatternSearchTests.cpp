@@ -0,0 +1,200 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "PatternSearch.hpp"
+#include "Test.hpp"
+#include <Headers/kern_patcher.hpp>
+
+static constexpr size_t MaxTestPattern = 8;
+
+struct TestPattern {
+    UInt8 pattern[MaxTestPattern];
+    UInt8 mask[MaxTestPattern];
+    size_t size;
+    bool masked;
+};
+
+// Small alphabets and short patterns, so that partial matches and overlapping hits are common.
+static void makePattern(TestRandom &random, TestPattern &pattern, UInt8 alphabet) {
+    pattern.size = random.below(MaxTestPattern - 2) + 1;
+    pattern.masked = random.below(2);
+    for (size_t i = 0; i < pattern.size; i++) {
+        pattern.pattern[i] = static_cast<UInt8>(random.below(alphabet));
+        static const UInt8 masks[] = {0x00, 0x01, 0xFF, 0xFF};
+        pattern.mask[i] = masks[random.below(arrsize(masks))];
+    }
+}
+
+TEST(multiPatternScanMatchesFindPattern) {
+    TestRandom random {1};
+    UInt8 data[300];
+    for (size_t iteration = 0; iteration < 20000; iteration++) {
+        auto alphabet = static_cast<UInt8>(random.below(3) + 2);
+        auto size = random.below(sizeof(data)) + 1;
+        for (size_t i = 0; i < size; i++) { data[i] = static_cast<UInt8>(random.below(alphabet)); }
+
+        TestPattern patterns[MultiPatternScanner::MaxPatterns];
+        MultiPatternScanner scanner {};
+        auto count = random.below(MultiPatternScanner::MaxPatterns) + 1;
+        for (size_t i = 0; i < count; i++) {
+            makePattern(random, patterns[i], alphabet);
+            REQUIRE(scanner.add(patterns[i].pattern, patterns[i].masked ? patterns[i].mask : nullptr,
+                patterns[i].size));
+        }
+
+        size_t expectedFound = 0;
+        auto found = scanner.scan(data, size);
+        for (size_t i = 0; i < count; i++) {
+            auto &pattern = patterns[i];
+            size_t expected = 0, offset = 0;
+            bool hit = KernelPatcher::findPattern(pattern.pattern, pattern.masked ? pattern.mask : nullptr,
+                pattern.size, data, size, &expected);
+            CHECK(scanner.getOffset(i, &offset) == hit);
+            if (hit) {
+                CHECK(offset == expected);
+                expectedFound += 1;
+            }
+        }
+        CHECK(found == expectedFound);
+    }
+}
+
+TEST(multiPatternScanFindsMatchesAtTheEdges) {
+    static const UInt8 data[] = {0xAA, 0x01, 0x02, 0x03, 0x04, 0x05, 0xBB};
+    static const UInt8 head[] = {0xAA, 0x01};
+    static const UInt8 tail[] = {0x05, 0xBB};
+    static const UInt8 whole[] = {0xAA, 0x01, 0x02, 0x03, 0x04, 0x05, 0xBB};
+    static const UInt8 tooLong[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0xBB, 0x00};
+    MultiPatternScanner scanner {};
+    scanner.add(head, nullptr, sizeof(head));
+    scanner.add(tail, nullptr, sizeof(tail));
+    scanner.add(whole, nullptr, sizeof(whole));
+    scanner.add(tooLong, nullptr, sizeof(tooLong));
+    CHECK(scanner.scan(data, sizeof(data)) == 3);
+
+    size_t offset = 0;
+    CHECK(scanner.getOffset(0, &offset) && offset == 0);
+    CHECK(scanner.getOffset(1, &offset) && offset == 5);
+    CHECK(scanner.getOffset(2, &offset) && offset == 0);
+    CHECK(!scanner.getOffset(3, &offset));
+}
+
+TEST(multiPatternScanHandlesUnanchoredPatterns) {
+    // Nothing is fully masked, so the pattern can't be keyed by an anchor byte.
+    static const UInt8 data[] = {0x10, 0x21, 0x32, 0x43};
+    static const UInt8 pattern[] = {0x30, 0x40};
+    static const UInt8 mask[] = {0xF0, 0xF0};
+    static const UInt8 anchored[] = {0x21};
+    MultiPatternScanner scanner {};
+    scanner.add(pattern, mask, sizeof(pattern));
+    scanner.add(anchored, nullptr, sizeof(anchored));
+    CHECK(scanner.scan(data, sizeof(data)) == 2);
+
+    size_t offset = 0;
+    CHECK(scanner.getOffset(0, &offset) && offset == 2);
+    CHECK(scanner.getOffset(1, &offset) && offset == 1);
+}
+
+TEST(multiPatternScanResetsBetweenScans) {
+    static const UInt8 first[] = {0x01, 0x02, 0x03};
+    static const UInt8 second[] = {0x04, 0x05, 0x06};
+    static const UInt8 pattern[] = {0x02, 0x03};
+    MultiPatternScanner scanner {};
+    scanner.add(pattern, nullptr, sizeof(pattern));
+
+    size_t offset = 0;
+    CHECK(scanner.scan(first, sizeof(first)) == 1);
+    CHECK(scanner.getOffset(0, &offset) && offset == 1);
+    CHECK(scanner.scan(second, sizeof(second)) == 0);
+    CHECK(!scanner.getOffset(0, &offset));
+}
+
+TEST(multiPatternScanRejectsInvalidPatterns) {
+    static const UInt8 pattern[] = {0x01};
+    MultiPatternScanner scanner {};
+    CHECK(!scanner.add(nullptr, nullptr, 1));
+    CHECK(!scanner.add(pattern, nullptr, 0));
+    for (size_t i = 0; i < MultiPatternScanner::MaxPatterns; i++) { CHECK(scanner.add(pattern, nullptr, 1)); }
+    CHECK(!scanner.add(pattern, nullptr, 1));
+    CHECK(scanner.getCount() == MultiPatternScanner::MaxPatterns);
+
+    size_t offset = 0;
+    CHECK(!scanner.getOffset(MultiPatternScanner::MaxPatterns, &offset));
+}
+
+// Bytes around the carries and borrows of the word-at-a-time compares.
+static const UInt8 edgeBytes[] = {0x00, 0x01, 0x7F, 0x80, 0x81, 0xFE, 0xFF, 0x55};
+
+static void fillEdgeBytes(TestRandom &random, UInt8 *data, size_t size, size_t alphabet) {
+    for (size_t i = 0; i < size; i++) { data[i] = edgeBytes[random.below(alphabet)]; }
+}
+
+TEST(patternMatchesAtMatchesByteCompare) {
+    TestRandom random {2};
+    UInt8 data[40], pattern[40], mask[40];
+    for (size_t iteration = 0; iteration < 100000; iteration++) {
+        auto size = random.below(sizeof(data)) + 1;
+        fillEdgeBytes(random, data, size, 3);
+        fillEdgeBytes(random, pattern, size, 3);
+        fillEdgeBytes(random, mask, size, arrsize(edgeBytes));
+        bool masked = random.below(2);
+        bool expected = true;
+        for (size_t i = 0; i < size; i++) {
+            UInt8 byteMask = masked ? mask[i] : 0xFF;
+            if ((data[i] & byteMask) != (pattern[i] & byteMask)) { expected = false; }
+        }
+        CHECK(patternMatchesAt(data, pattern, masked ? mask : nullptr, size) == expected);
+    }
+}
+
+TEST(maskedPatternSearchMatchesFindPattern) {
+    TestRandom random {7};
+    UInt8 data[200], pattern[40], mask[40];
+    for (size_t iteration = 0; iteration < 200000; iteration++) {
+        auto alphabet = random.below(4) + 2;
+        auto size = random.below(sizeof(data)) + 1;
+        fillEdgeBytes(random, data, size, alphabet);
+        auto patternSize = random.below(sizeof(pattern)) + 1;
+        fillEdgeBytes(random, pattern, patternSize, alphabet);
+        static const UInt8 masks[] = {0x00, 0x01, 0xFF, 0xFF};
+        for (size_t i = 0; i < patternSize; i++) { mask[i] = masks[random.below(arrsize(masks))]; }
+        bool masked = random.below(2);
+        if (!random.below(3) && size >= patternSize) {
+            memcpy(data + random.below(size - patternSize + 1), pattern, patternSize);
+        }
+
+        auto start = random.below(size + 2);
+        size_t expected = start, offset = start;
+        bool hit = KernelPatcher::findPattern(pattern, masked ? mask : nullptr, patternSize, data, size, &expected);
+        MaskedPatternSearch search {pattern, masked ? mask : nullptr, patternSize};
+        CHECK(search.find(data, size, &offset) == hit);
+        if (hit) { CHECK(offset == expected); }
+    }
+}
+
+TEST(multiPatternScanMatchesFindPatternWithManyAnchors) {
+    TestRandom random {3};
+    UInt8 data[300];
+    UInt8 patterns[MultiPatternScanner::MaxPatterns][2];
+    size_t sizes[MultiPatternScanner::MaxPatterns];
+    for (size_t iteration = 0; iteration < 20000; iteration++) {
+        auto size = random.below(sizeof(data)) + 1;
+        fillEdgeBytes(random, data, size, arrsize(edgeBytes));
+        // Up to as many distinct anchor bytes as there are edge bytes, on both sides of the table fallback.
+        MultiPatternScanner scanner {};
+        auto count = random.below(MultiPatternScanner::MaxPatterns) + 1;
+        for (size_t i = 0; i < count; i++) {
+            fillEdgeBytes(random, patterns[i], sizeof(patterns[i]), arrsize(edgeBytes));
+            sizes[i] = random.below(sizeof(patterns[i])) + 1;
+            REQUIRE(scanner.add(patterns[i], nullptr, sizes[i]));
+        }
+
+        scanner.scan(data, size);
+        for (size_t i = 0; i < count; i++) {
+            size_t expected = 0, offset = 0;
+            bool hit = KernelPatcher::findPattern(patterns[i], nullptr, sizes[i], data, size, &expected);
+            CHECK(scanner.getOffset(i, &offset) == hit);
+            if (hit) { CHECK(offset == expected); }
+        }
+    }
+}
@@ -0,0 +1,87 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#pragma once
+#include <Headers/kern_util.hpp>
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// A test or benchmark, registered by `TEST` and `BENCH` and run by `Main.cpp` in the order they're defined.
+struct TestCase {
+    const char *name;
+    void (*run)();
+    TestCase *next {nullptr};
+
+    TestCase(const char *name, void (*run)());
+};
+
+void reportFailure(const char *file, int line, const char *condition);
+
+#define TEST(name)                            \
+    static void name();                       \
+    static TestCase name##Case {#name, name}; \
+    static void name()
+
+#define BENCH(name) TEST(name)
+
+#define CHECK(condition)                                                     \
+    do {                                                                     \
+        if (!(condition)) { reportFailure(__FILE__, __LINE__, #condition); } \
+    } while (0)
+
+// Like `CHECK`, but ends the test on failure.
+#define REQUIRE(condition)                                 \
+    do {                                                   \
+        if (!(condition)) {                                \
+            reportFailure(__FILE__, __LINE__, #condition); \
+            return;                                        \
+        }                                                  \
+    } while (0)
+
+// Small deterministic generator, so that failures reproduce everywhere.
+class TestRandom {
+    public:
+    explicit TestRandom(UInt64 seed) : state {seed ? seed : 1} {}
+
+    UInt64 next() {
+        this->state ^= this->state << 13;
+        this->state ^= this->state >> 7;
+        this->state ^= this->state << 17;
+        return this->state;
+    }
+
+    size_t below(size_t bound) { return static_cast<size_t>(this->next() % bound); }
+
+    private:
+    UInt64 state;
+};
+
+// Prints the mean time of `body` over `iterations` runs, after one untimed run.
+void measure(const char *label, size_t iterations, void (*body)(void *context), void *context);
+
+template<typename F>
+void measure(const char *label, size_t iterations, F body) {
+    measure(label, iterations, [](void *context) { (*static_cast<F *>(context))(); }, &body);
+}
+
+// Keeps the compiler from dropping a benchmark result.
+template<typename T>
+inline void keep(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Runs `body` in a child process and reports whether it panicked.
+template<typename F>
+inline bool panics(F body) {
+    fflush(nullptr);
+    auto pid = fork();
+    if (pid == 0) {
+        freopen("/dev/null", "w", stderr);
+        body();
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
@@ -0,0 +1,76 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "VnodeCache.hpp"
+#include "Test.hpp"
+
+static constexpr size_t Lookups = 1000000;
+
+static const void *getVnode(size_t index) { return reinterpret_cast<const void *>(0xFFFFFF8012340000 + index * 0xF8); }
+
+// Hit rate of a cache of `SlotCount` slots over a working set of files, each page-in looking its file up and
+// inserting it on a miss, like `wrapCsValidatePage` does.
+template<size_t SlotCount>
+static void measureImageCache(size_t files) {
+    static VnodeCache<UInt8, SlotCount> cache {};
+    cache.allocate();
+    size_t hits = 0;
+    char label[64];
+    snprintf(label, sizeof(label), "%zu slots, %zu files", SlotCount, files);
+    TestRandom random {files};
+    measure(label, 1, [&] {
+        hits = 0;
+        for (size_t i = 0; i < Lookups; i++) {
+            auto vnode = getVnode(random.below(files));
+            UInt8 value = 0;
+            if (cache.lookup(vnode, 1, 0, &value)) {
+                hits += 1;
+            } else {
+                cache.insert(vnode, 1, 0, 1);
+            }
+        }
+    });
+    printf("        %.2f%% hits\n", 100.0 * static_cast<double>(hits) / Lookups);
+}
+
+BENCH(imageCacheHitRate) {
+    printf("    %zu page-ins spread evenly over the files\n", Lookups);
+    measureImageCache<256>(256);
+    measureImageCache<512>(256);
+    measureImageCache<1024>(256);
+    measureImageCache<1024>(512);
+    measureImageCache<2048>(512);
+}
+
+// The page memo over a shared cache, with page-ins skewed towards a hot set the way evicted pages come back.
+template<size_t SlotCount>
+static void measurePageMemo(size_t pages) {
+    static VnodeCache<UInt16, SlotCount> cache {};
+    cache.allocate();
+    size_t hits = 0;
+    char label[64];
+    snprintf(label, sizeof(label), "%zu slots, %zu pages", SlotCount, pages);
+    TestRandom random {pages};
+    measure(label, 1, [&] {
+        hits = 0;
+        for (size_t i = 0; i < Lookups; i++) {
+            // Three quarters of the page-ins go to an eighth of the pages.
+            auto page = random.below(4) ? random.below(pages / 8) : random.below(pages);
+            UInt16 value = 0;
+            if (cache.lookup(getVnode(0), 1, page * PAGE_SIZE, &value)) {
+                hits += 1;
+            } else {
+                cache.insert(getVnode(0), 1, page * PAGE_SIZE, 0xFFFF);
+            }
+        }
+    });
+    printf("        %.2f%% hits\n", 100.0 * static_cast<double>(hits) / Lookups);
+}
+
+BENCH(pageMemoHitRate) {
+    printf("    %zu page-ins, 3/4 of them to 1/8 of the pages\n", Lookups);
+    measurePageMemo<1024>(8192);
+    measurePageMemo<2048>(8192);
+    measurePageMemo<4096>(8192);
+    measurePageMemo<2048>(32768);
+}
@@ -0,0 +1,105 @@
+// Copyright © 2024 ChefKiss. Licensed under the Thou Shalt Not Profit License version 1.5.
+// See LICENSE for details.
+
+#include "VnodeCache.hpp"
+#include "Test.hpp"
+#include <thread>
+#include <vector>
+
+static const void *getVnode(size_t index) { return reinterpret_cast<const void *>(0xFFFFFF8012340000 + index * 0xF8); }
+
+TEST(missesUntilAllocated) {
+    VnodeCache<UInt8, 16> cache {};
+    UInt8 value = 0;
+    cache.insert(getVnode(0), 1, 0, 7);
+    CHECK(!cache.lookup(getVnode(0), 1, 0, &value));
+    REQUIRE(cache.allocate());
+    CHECK(cache.allocate());
+    cache.insert(getVnode(0), 1, 0, 7);
+    CHECK(cache.lookup(getVnode(0), 1, 0, &value) && value == 7);
+}
+
+TEST(missesWithoutMemory) {
+    VnodeCache<UInt8, 16> cache {};
+    ioMallocFailAfter = 0;
+    CHECK(!cache.allocate());
+    ioMallocFailAfter = -1;
+    UInt8 value = 0;
+    cache.insert(getVnode(0), 1, 0, 7);
+    CHECK(!cache.lookup(getVnode(0), 1, 0, &value));
+}
+
+TEST(keysOnVnodeVidAndPage) {
+    VnodeCache<UInt16, 64> cache {};
+    REQUIRE(cache.allocate());
+    cache.insert(getVnode(0), 1, 0, 10);
+    cache.insert(getVnode(0), 1, PAGE_SIZE, 11);
+    cache.insert(getVnode(1), 1, 0, 12);
+    UInt16 value = 0;
+    CHECK(cache.lookup(getVnode(0), 1, 0, &value) && value == 10);
+    CHECK(cache.lookup(getVnode(0), 1, PAGE_SIZE, &value) && value == 11);
+    CHECK(cache.lookup(getVnode(1), 1, 0, &value) && value == 12);
+    // A recycled vnode has a new vid.
+    CHECK(!cache.lookup(getVnode(0), 2, 0, &value));
+    CHECK(!cache.lookup(getVnode(0), 1, 2 * PAGE_SIZE, &value));
+    // Offsets past 4 GiB are kept apart too.
+    cache.insert(getVnode(0), 1, 0x100000000, 13);
+    CHECK(cache.lookup(getVnode(0), 1, 0x100000000, &value) && value == 13);
+    CHECK(cache.lookup(getVnode(0), 1, 0, &value) && value == 10);
+    cache.insert(getVnode(0), 1, 0, 14);
+    CHECK(cache.lookup(getVnode(0), 1, 0, &value) && value == 14);
+}
+
+TEST(keepsTheLatestEntries) {
+    static constexpr size_t SlotCount = 256;
+    VnodeCache<UInt16, SlotCount> cache {};
+    REQUIRE(cache.allocate());
+    for (size_t i = 0; i < 4 * SlotCount; i++) { cache.insert(getVnode(i), 1, 0, static_cast<UInt16>(i)); }
+    // The last insert always lands, older entries may have been evicted but never read back wrong.
+    UInt16 value = 0;
+    CHECK(cache.lookup(getVnode(4 * SlotCount - 1), 1, 0, &value) && value == 4 * SlotCount - 1);
+    size_t found = 0;
+    for (size_t i = 0; i < 4 * SlotCount; i++) {
+        if (!cache.lookup(getVnode(i), 1, 0, &value)) { continue; }
+        CHECK(value == i);
+        found += 1;
+    }
+    CHECK(found > SlotCount / 2 && found <= SlotCount);
+}
+
+// Every value is derived from its key, so a torn or mismatched read shows up as a wrong value.
+TEST(neverReadsAnotherKeysValueUnderContention) {
+    static constexpr size_t ThreadCount = 4;
+    static constexpr size_t Operations = 200000;
+    static VnodeCache<UInt16, 256> cache {};
+    REQUIRE(cache.allocate());
+    auto getValue = [](size_t vnode, UInt32 vid, size_t page) {
+        return static_cast<UInt16>(vnode * 31 + vid * 7 + page * 3);
+    };
+
+    size_t hits[ThreadCount] {}, wrong[ThreadCount] {};
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < ThreadCount; t++) {
+        threads.emplace_back([&, t] {
+            TestRandom random {t + 1};
+            for (size_t i = 0; i < Operations; i++) {
+                // 2048 vnodes over 4 generations and 4 pages, far more keys than slots.
+                auto vnode = random.below(2048);
+                auto vid = static_cast<UInt32>(random.below(4));
+                auto page = random.below(4);
+                UInt16 value = 0;
+                if (cache.lookup(getVnode(vnode), vid, page * PAGE_SIZE, &value)) {
+                    hits[t] += 1;
+                    wrong[t] += value != getValue(vnode, vid, page);
+                } else {
+                    cache.insert(getVnode(vnode), vid, page * PAGE_SIZE, getValue(vnode, vid, page));
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) { thread.join(); }
+    for (size_t t = 0; t < ThreadCount; t++) {
+        CHECK(hits[t] > 0);
+        CHECK(wrong[t] == 0);
+    }
+}